@@ -0,0 +1,463 @@
+/*
+ * FreeRTOS Kernel V10.0.1
+ * Copyright (C) 2017 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://www.FreeRTOS.org
+ * http://aws.amazon.com/freertos
+ *
+ * 1 tab == 4 spaces!
+ */
+
+/*-----------------------------------------------------------
+ * Implementation of functions defined in portable.h for the Linux host.
+ *
+ * The whole kernel runs on one Linux thread.  Each task gets a ucontext with
+ * a stack allocated from the host, the SysTick is replaced by SIGALRM from an
+ * interval timer, and BASEPRI is replaced by ulInterruptMask.  A tick that
+ * fires while the mask is set is held pending, in the same way the NVIC holds
+ * SysTick, and is serviced as soon as the mask is cleared.
+ *
+ * Library calls that are not async signal safe (printf, malloc, ...) must not
+ * be preempted by a context switch, so tasks should only make them with the
+ * scheduler suspended or from inside a critical section.
+ *----------------------------------------------------------*/
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <ucontext.h>
+
+/* Scheduler includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Host stack given to every task.  The stack passed in by the kernel is far
+too small for libc and for the signal frames the tick pushes onto it. */
+#ifndef configHOST_TASK_STACK_SIZE
+	#define configHOST_TASK_STACK_SIZE	( 64 * 1024 )
+#endif
+
+/* The signal used as the tick interrupt. */
+#define portTICK_SIGNAL				SIGALRM
+
+/* Host side state of one task, found through the word pxTopOfStack points
+to. */
+typedef struct xHOST_THREAD
+{
+	ucontext_t xContext;
+	TaskFunction_t pxCode;
+	void *pvParameters;
+	void *pvStack;
+} HostThread_t;
+
+/*
+ * Setup the timer to generate the tick interrupts.
+ */
+void vPortSetupTimerInterrupt( void );
+
+/*
+ * Tick handler, the equivalent of the Cortex-M SysTick handler.  It is only
+ * ever entered with the interrupt mask clear.
+ */
+void xPortSysTickHandler( void );
+
+/*
+ * The SIGALRM handler, pends the tick if the mask is set.
+ */
+static void prvTickSignalHandler( int iSignal );
+
+/*
+ * Take any tick and yield that were held back by the interrupt mask.  This is
+ * the host equivalent of tail chaining into PendSV.
+ */
+static void prvServicePendingInterrupts( void );
+
+/*
+ * Save the running task and switch to the task selected by
+ * vTaskSwitchContext().
+ */
+static void prvSwitchContext( void );
+
+/*
+ * Entry point of every task, calls the task function.
+ */
+static void prvTaskStart( void );
+
+/*
+ * Used to catch tasks that attempt to return from their implementing function.
+ */
+static void prvTaskExitError( void );
+
+/*-----------------------------------------------------------*/
+
+/* Each task maintains its own interrupt status in the critical nesting
+variable. */
+static UBaseType_t uxCriticalNesting = 0xaaaaaaaa;
+
+/* Emulated BASEPRI, interrupts are masked while it is non zero.  The scheduler
+is started with interrupts disabled. */
+static volatile uint32_t ulInterruptMask = pdTRUE;
+
+/* A tick and a yield that were requested while masked. */
+static volatile BaseType_t xPendingTick = pdFALSE;
+static volatile BaseType_t xPendingYield = pdFALSE;
+
+/* Set while the tick handler runs, the equivalent of a non-zero IPSR. */
+static volatile BaseType_t xInsideInterrupt = pdFALSE;
+
+/* Context of the caller of xPortStartScheduler(), returned to by
+vPortEndScheduler(). */
+static ucontext_t xSchedulerContext;
+
+/* The running task. */
+extern void * volatile pxCurrentTCB;
+
+/*-----------------------------------------------------------*/
+
+static HostThread_t *prvCurrentThread( void )
+{
+StackType_t *pxTopOfStack;
+
+	/* pxTopOfStack is the first member of the TCB. */
+	pxTopOfStack = *( StackType_t ** ) pxCurrentTCB;
+	return ( HostThread_t * ) *pxTopOfStack;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * See header file for description.
+ */
+StackType_t *pxPortInitialiseStack( StackType_t *pxTopOfStack, TaskFunction_t pxCode, void *pvParameters )
+{
+HostThread_t *pxThread;
+uint32_t ulMask;
+
+	/* Tasks can be created at any time so keep the tick away from the host
+	allocator. */
+	ulMask = ulPortSetInterruptMask();
+	pxThread = malloc( sizeof( HostThread_t ) );
+	configASSERT( pxThread );
+	pxThread->pvStack = malloc( configHOST_TASK_STACK_SIZE );
+	configASSERT( pxThread->pvStack );
+	vPortClearInterruptMask( ulMask );
+
+	pxThread->pxCode = pxCode;
+	pxThread->pvParameters = pvParameters;
+
+	getcontext( &( pxThread->xContext ) );
+	pxThread->xContext.uc_stack.ss_sp = pxThread->pvStack;
+	pxThread->xContext.uc_stack.ss_size = configHOST_TASK_STACK_SIZE;
+	pxThread->xContext.uc_link = NULL;
+	sigemptyset( &( pxThread->xContext.uc_sigmask ) );
+	makecontext( &( pxThread->xContext ), prvTaskStart, 0 );
+
+	/* The kernel stack only holds the pointer to the host context. */
+	pxTopOfStack--;
+	*pxTopOfStack = ( StackType_t ) pxThread;
+
+	return pxTopOfStack;
+}
+/*-----------------------------------------------------------*/
+
+void vPortReleaseTaskContext( volatile StackType_t *pxTopOfStack )
+{
+HostThread_t *pxThread = ( HostThread_t * ) *pxTopOfStack;
+uint32_t ulMask;
+
+	/* Only called by the idle task once the deleted task can no longer run,
+	so its stack is not in use. */
+	ulMask = ulPortSetInterruptMask();
+	free( pxThread->pvStack );
+	free( pxThread );
+	vPortClearInterruptMask( ulMask );
+}
+/*-----------------------------------------------------------*/
+
+static void prvTaskExitError( void )
+{
+	/* A function that implements a task must not exit or attempt to return to
+	its caller as there is nothing to return to.  If a task wants to exit it
+	should instead call vTaskDelete( NULL ).
+
+	Artificially force an assert() to be triggered if configASSERT() is
+	defined, then stop here so application writers can catch the error. */
+	configASSERT( uxCriticalNesting == ~0UL );
+	portDISABLE_INTERRUPTS();
+	for( ;; );
+}
+/*-----------------------------------------------------------*/
+
+static void prvTaskStart( void )
+{
+HostThread_t *pxThread = prvCurrentThread();
+
+	/* A new task starts with interrupts enabled, take anything that became
+	pending while the previous task switched out. */
+	portENABLE_INTERRUPTS();
+
+	pxThread->pxCode( pxThread->pvParameters );
+	prvTaskExitError();
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * See header file for description.
+ */
+BaseType_t xPortStartScheduler( void )
+{
+struct sigaction xAction;
+
+	memset( &xAction, 0, sizeof( xAction ) );
+	xAction.sa_handler = prvTickSignalHandler;
+	xAction.sa_flags = SA_RESTART;
+	sigemptyset( &xAction.sa_mask );
+	sigaction( portTICK_SIGNAL, &xAction, NULL );
+
+	/* Start the timer that generates the tick ISR.  Interrupts are disabled
+	here already. */
+	vPortSetupTimerInterrupt();
+
+	/* Initialise the critical nesting count ready for the first task. */
+	uxCriticalNesting = 0;
+
+	/* Start the first task.  Control comes back here only when a task calls
+	vTaskEndScheduler(). */
+	swapcontext( &xSchedulerContext, &( prvCurrentThread()->xContext ) );
+
+	return 0;
+}
+/*-----------------------------------------------------------*/
+
+void vPortEndScheduler( void )
+{
+struct itimerval xTimer;
+HostThread_t *pxThread = prvCurrentThread();
+
+	memset( &xTimer, 0, sizeof( xTimer ) );
+	setitimer( ITIMER_REAL, &xTimer, NULL );
+	signal( portTICK_SIGNAL, SIG_IGN );
+
+	ulInterruptMask = pdTRUE;
+	xPendingTick = pdFALSE;
+	xPendingYield = pdFALSE;
+
+	swapcontext( &( pxThread->xContext ), &xSchedulerContext );
+}
+/*-----------------------------------------------------------*/
+
+void vPortEnterCritical( void )
+{
+	portDISABLE_INTERRUPTS();
+	uxCriticalNesting++;
+
+	/* This is not the interrupt safe version of the enter critical function so
+	assert() if it is being called from an interrupt context.  Only API
+	functions that end in "FromISR" can be used in an interrupt.  Only assert if
+	the critical nesting count is 1 to protect against recursive calls if the
+	assert function also uses a critical section. */
+	if( uxCriticalNesting == 1 )
+	{
+		configASSERT( xInsideInterrupt == pdFALSE );
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vPortExitCritical( void )
+{
+	configASSERT( uxCriticalNesting );
+	uxCriticalNesting--;
+	if( uxCriticalNesting == 0 )
+	{
+		portENABLE_INTERRUPTS();
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vPortDisableInterrupts( void )
+{
+	ulInterruptMask = pdTRUE;
+	portMEMORY_BARRIER();
+}
+/*-----------------------------------------------------------*/
+
+void vPortEnableInterrupts( void )
+{
+	portMEMORY_BARRIER();
+	ulInterruptMask = pdFALSE;
+
+	if( xInsideInterrupt == pdFALSE )
+	{
+		prvServicePendingInterrupts();
+	}
+}
+/*-----------------------------------------------------------*/
+
+uint32_t ulPortSetInterruptMask( void )
+{
+uint32_t ulOriginalMask = ulInterruptMask;
+
+	ulInterruptMask = pdTRUE;
+	portMEMORY_BARRIER();
+	return ulOriginalMask;
+}
+/*-----------------------------------------------------------*/
+
+void vPortClearInterruptMask( uint32_t ulNewMaskValue )
+{
+	if( ulNewMaskValue == pdFALSE )
+	{
+		portENABLE_INTERRUPTS();
+	}
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xPortIsInsideInterrupt( void )
+{
+	return xInsideInterrupt;
+}
+/*-----------------------------------------------------------*/
+
+void vPortYield( void )
+{
+	xPendingYield = pdTRUE;
+
+	/* Inside a critical section the switch happens when it is exited. */
+	if( ( ulInterruptMask == pdFALSE ) && ( xInsideInterrupt == pdFALSE ) )
+	{
+		prvServicePendingInterrupts();
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vPortYieldFromISR( void )
+{
+	/* Taken when the handler returns. */
+	xPendingYield = pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
+static void prvSwitchContext( void )
+{
+HostThread_t *pxOldThread, *pxNewThread;
+
+	pxOldThread = prvCurrentThread();
+	vTaskSwitchContext();
+	pxNewThread = prvCurrentThread();
+
+	if( pxOldThread != pxNewThread )
+	{
+		swapcontext( &( pxOldThread->xContext ), &( pxNewThread->xContext ) );
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvServicePendingInterrupts( void )
+{
+	while( ( xPendingTick != pdFALSE ) || ( xPendingYield != pdFALSE ) )
+	{
+		ulInterruptMask = pdTRUE;
+		portMEMORY_BARRIER();
+
+		if( xPendingTick != pdFALSE )
+		{
+			xPendingTick = pdFALSE;
+			if( xTaskIncrementTick() != pdFALSE )
+			{
+				xPendingYield = pdTRUE;
+			}
+		}
+
+		if( xPendingYield != pdFALSE )
+		{
+			xPendingYield = pdFALSE;
+			prvSwitchContext();
+		}
+
+		/* Every task resumes here, or in prvTaskStart(), with interrupts
+		enabled. */
+		portMEMORY_BARRIER();
+		ulInterruptMask = pdFALSE;
+	}
+}
+/*-----------------------------------------------------------*/
+
+void xPortSysTickHandler( void )
+{
+	/* The SysTick runs at the lowest interrupt priority, so when this interrupt
+	executes all interrupts must be unmasked.  There is therefore no need to
+	save and then restore the interrupt mask value as its value is already
+	known. */
+	portDISABLE_INTERRUPTS();
+	{
+		/* Increment the RTOS tick. */
+		if( xTaskIncrementTick() != pdFALSE )
+		{
+			/* A context switch is required.  Context switching is performed in
+			the PendSV interrupt.  Pend the PendSV interrupt. */
+			xPendingYield = pdTRUE;
+		}
+	}
+	ulInterruptMask = pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+static void prvTickSignalHandler( int iSignal )
+{
+int iSavedErrno = errno;
+
+	( void ) iSignal;
+
+	if( ulInterruptMask != pdFALSE )
+	{
+		/* Masked, the tick is taken when the mask is cleared. */
+		xPendingTick = pdTRUE;
+	}
+	else
+	{
+		xInsideInterrupt = pdTRUE;
+		xPortSysTickHandler();
+		xInsideInterrupt = pdFALSE;
+
+		/* Exception return.  If a switch is pending the interrupted task is
+		resumed here, still inside this handler, when it is next selected. */
+		prvServicePendingInterrupts();
+	}
+
+	errno = iSavedErrno;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Setup the interval timer to generate the tick interrupts at the required
+ * frequency.
+ */
+__attribute__(( weak )) void vPortSetupTimerInterrupt( void )
+{
+struct itimerval xTimer;
+
+	xTimer.it_interval.tv_sec = 0;
+	xTimer.it_interval.tv_usec = 1000000UL / configTICK_RATE_HZ;
+	xTimer.it_value = xTimer.it_interval;
+	setitimer( ITIMER_REAL, &xTimer, NULL );
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,85 @@
+/*
+ * FreeRTOS Kernel V10.0.1
+ * Copyright (C) 2017 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://www.FreeRTOS.org
+ * http://aws.amazon.com/freertos
+ *
+ * 1 tab == 4 spaces!
+ */
+
+
+#ifndef FREERTOS_CONFIG_H
+#define FREERTOS_CONFIG_H
+
+/*-----------------------------------------------------------
+ * Application specific definitions for the Linux host build.
+ *
+ * Kernel settings follow ../FreeRTOSConfig.h so the host numbers are
+ * representative of the target build.  Only the tick rate, the heap and the
+ * Cortex-M interrupt priorities differ.
+ *
+ * See http://www.freertos.org/a00110.html.
+ *----------------------------------------------------------*/
+
+#include <stdint.h>
+
+#define configCPU_CLOCK_HZ                    (1000000000UL)
+#define configTICK_RATE_HZ                    ((TickType_t)1000)
+#define configMINIMAL_STACK_SIZE              ((unsigned short)130)
+#define configCHECK_FOR_STACK_OVERFLOW        0
+#define configMAX_PRIORITIES                  (5)
+#define configUSE_PREEMPTION                  1
+#define configIDLE_SHOULD_YIELD               1
+#define configMAX_TASK_NAME_LEN               (10)
+
+/* Software timer definitions. */
+#define configUSE_TIMERS                      1
+#define configTIMER_TASK_PRIORITY             (2)
+#define configTIMER_QUEUE_LENGTH              5
+#define configTIMER_TASK_STACK_DEPTH          (configMINIMAL_STACK_SIZE * 2)
+
+#define configUSE_MUTEXES                     1
+#define configUSE_RECURSIVE_MUTEXES           1
+#define configUSE_COUNTING_SEMAPHORES         1
+#define configUSE_QUEUE_SETS                  1
+#define configUSE_IDLE_HOOK                   0
+#define configUSE_TICK_HOOK                   0
+#define configUSE_MALLOC_FAILED_HOOK          0
+#define configUSE_16_BIT_TICKS                0
+
+/* Set the following definitions to 1 to include the API function, or zero
+to exclude the API function. */
+#define INCLUDE_vTaskPrioritySet              1
+#define INCLUDE_uxTaskPriorityGet             1
+#define INCLUDE_vTaskDelete                   1
+#define INCLUDE_vTaskSuspend                  1
+#define INCLUDE_vTaskDelayUntil               1
+#define INCLUDE_vTaskDelay                    1
+#define INCLUDE_eTaskGetState                 1
+
+/* Host stack given to each task, see FreeRTOS/Linux/port.c. */
+#define configHOST_TASK_STACK_SIZE            (64 * 1024)
+
+/* A failed assert aborts the process instead of hanging the build server. */
+void vAssertCalled( const char *pcFile, unsigned long ulLine );
+#define configASSERT( x ) if( ( x ) == 0 ) { vAssertCalled( __FILE__, __LINE__ ); }
+
+#endif /* FREERTOS_CONFIG_H */
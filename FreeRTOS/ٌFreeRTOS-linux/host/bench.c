@@ -0,0 +1,223 @@
+/********************************************************************
+*	Filename:    bench.c
+*
+*	Description: Context switch benchmark for the Linux host port, built
+*				 and run by "make host-bench". Two tests are run back to
+*				 back by a control task at the highest priority:
+*				 - yield: two tasks of equal priority call taskYIELD()
+*				   in turn, the latency is measured from the yield call
+*				   until the other task resumes.
+*				 - queue: a producer sends a time stamp through a queue to
+*				   a higher priority consumer blocked in xQueueReceive(),
+*				   the latency is measured from the send call until the
+*				   consumer resumes with the data.
+*				 Results are printed after vTaskEndScheduler() returns
+*				 control to main().
+*
+*	Usage:       bench [switches], default is benchDEFAULT_SWITCHES.
+**********************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#define benchDEFAULT_SWITCHES     (200000UL)
+#define benchCONTROL_PRIORITY     (configMAX_PRIORITIES - 1)
+#define benchCONSUMER_PRIORITY    (3)
+#define benchTASK_PRIORITY        (2)
+
+/* Latency samples of one test. */
+typedef struct
+{
+	const char *pcName;
+	uint32_t *pulSamples;
+	uint32_t ulCount;
+	uint32_t ulSwitches;    /* context switches per sample */
+	uint64_t ullStartNs;
+	uint64_t ullEndNs;
+} BenchResult_t;
+
+static BenchResult_t xYieldResult = { "yield", NULL, 0, 1, 0, 0 };
+static BenchResult_t xQueueResult = { "queue", NULL, 0, 2, 0, 0 };
+static uint32_t ulMaxSamples = benchDEFAULT_SWITCHES;
+
+static TaskHandle_t xControlTask = NULL;
+static QueueHandle_t xStampQueue = NULL;
+static volatile uint64_t ullYieldStamp;
+
+void vAssertCalled( const char *pcFile, unsigned long ulLine )
+{
+	taskDISABLE_INTERRUPTS();
+	fprintf( stderr, "assert failed: %s:%lu\n", pcFile, ulLine );
+	abort();
+}
+
+static uint64_t prvNowNs( void )
+{
+struct timespec xNow;
+
+	clock_gettime( CLOCK_MONOTONIC, &xNow );
+	return ( uint64_t ) xNow.tv_sec * 1000000000ULL + ( uint64_t ) xNow.tv_nsec;
+}
+
+/* Store a sample, notifies the control task once the test has enough. */
+static void prvRecord( BenchResult_t *pxResult, uint64_t ullLatency )
+{
+	if( pxResult->ulCount < ulMaxSamples )
+	{
+		pxResult->pulSamples[ pxResult->ulCount ] = ( uint32_t ) ullLatency;
+		pxResult->ulCount++;
+		if( pxResult->ulCount == ulMaxSamples )
+		{
+			pxResult->ullEndNs = prvNowNs();
+			xTaskNotifyGive( xControlTask );
+		}
+	}
+}
+
+static void prvYieldTask( void *pvParameters )
+{
+uint64_t ullLatency;
+
+	( void ) pvParameters;
+
+	for( ;; )
+	{
+		ullYieldStamp = prvNowNs();
+		taskYIELD();
+
+		/* The stamp is shared, do not let a tick switch in between. */
+		taskENTER_CRITICAL();
+		ullLatency = prvNowNs() - ullYieldStamp;
+		taskEXIT_CRITICAL();
+		prvRecord( &xYieldResult, ullLatency );
+	}
+}
+
+static void prvProducerTask( void *pvParameters )
+{
+uint64_t ullStamp;
+
+	( void ) pvParameters;
+
+	for( ;; )
+	{
+		ullStamp = prvNowNs();
+		xQueueSend( xStampQueue, &ullStamp, portMAX_DELAY );
+	}
+}
+
+static void prvConsumerTask( void *pvParameters )
+{
+uint64_t ullStamp;
+
+	( void ) pvParameters;
+
+	for( ;; )
+	{
+		xQueueReceive( xStampQueue, &ullStamp, portMAX_DELAY );
+		prvRecord( &xQueueResult, prvNowNs() - ullStamp );
+	}
+}
+
+/* Runs one test with two tasks and waits for it to collect its samples. */
+static void prvRunTest( BenchResult_t *pxResult,
+	TaskFunction_t pxFirst, UBaseType_t uxFirstPriority,
+	TaskFunction_t pxSecond, UBaseType_t uxSecondPriority )
+{
+TaskHandle_t xFirst, xSecond;
+
+	pxResult->ullStartNs = prvNowNs();
+	xTaskCreate( pxFirst, "bench1", configMINIMAL_STACK_SIZE, NULL, uxFirstPriority, &xFirst );
+	xTaskCreate( pxSecond, "bench2", configMINIMAL_STACK_SIZE, NULL, uxSecondPriority, &xSecond );
+	ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+	vTaskDelete( xFirst );
+	vTaskDelete( xSecond );
+}
+
+static void prvControlTask( void *pvParameters )
+{
+	( void ) pvParameters;
+
+	prvRunTest( &xYieldResult, prvYieldTask, benchTASK_PRIORITY,
+		prvYieldTask, benchTASK_PRIORITY );
+	prvRunTest( &xQueueResult, prvProducerTask, benchTASK_PRIORITY,
+		prvConsumerTask, benchCONSUMER_PRIORITY );
+
+	vTaskEndScheduler();
+	for( ;; );
+}
+
+static int prvCompare( const void *pvA, const void *pvB )
+{
+uint32_t ulA = *( const uint32_t * ) pvA, ulB = *( const uint32_t * ) pvB;
+
+	return ( ulA > ulB ) - ( ulA < ulB );
+}
+
+static uint32_t prvPercentile( const BenchResult_t *pxResult, double dPercent )
+{
+uint32_t ulIndex = ( uint32_t ) ( ( dPercent / 100.0 ) * ( double ) ( pxResult->ulCount - 1 ) );
+
+	return pxResult->pulSamples[ ulIndex ];
+}
+
+static void prvReport( BenchResult_t *pxResult )
+{
+double dSeconds;
+
+	if( pxResult->ulCount == 0 )
+	{
+		printf( "%-6s no samples\n", pxResult->pcName );
+		return;
+	}
+
+	dSeconds = ( double ) ( pxResult->ullEndNs - pxResult->ullStartNs ) / 1e9;
+	qsort( pxResult->pulSamples, pxResult->ulCount, sizeof( uint32_t ), prvCompare );
+
+	printf( "%-6s %10.0f switches/s  latency ns p50 %u p90 %u p99 %u p99.9 %u max %u\n",
+		pxResult->pcName,
+		( double ) pxResult->ulCount * pxResult->ulSwitches / dSeconds,
+		prvPercentile( pxResult, 50.0 ), prvPercentile( pxResult, 90.0 ),
+		prvPercentile( pxResult, 99.0 ), prvPercentile( pxResult, 99.9 ),
+		pxResult->pulSamples[ pxResult->ulCount - 1 ] );
+}
+
+int main( int argc, char *argv[] )
+{
+	if( argc > 1 )
+	{
+		ulMaxSamples = ( uint32_t ) strtoul( argv[ 1 ], NULL, 0 );
+	}
+	if( ulMaxSamples == 0 )
+	{
+		ulMaxSamples = benchDEFAULT_SWITCHES;
+	}
+
+	xYieldResult.pulSamples = malloc( ulMaxSamples * sizeof( uint32_t ) );
+	xQueueResult.pulSamples = malloc( ulMaxSamples * sizeof( uint32_t ) );
+	xStampQueue = xQueueCreate( 1, sizeof( uint64_t ) );
+	if( ( xYieldResult.pulSamples == NULL ) || ( xQueueResult.pulSamples == NULL ) || ( xStampQueue == NULL ) )
+	{
+		fprintf( stderr, "bench: out of memory\n" );
+		return 1;
+	}
+
+	xTaskCreate( prvControlTask, "control", configMINIMAL_STACK_SIZE, NULL,
+		benchCONTROL_PRIORITY, &xControlTask );
+
+	/* Returns when the control task calls vTaskEndScheduler(). */
+	vTaskStartScheduler();
+
+	printf( "FreeRTOS host port, tick %u Hz, %u samples per test\n",
+		( unsigned ) configTICK_RATE_HZ, ( unsigned ) ulMaxSamples );
+	prvReport( &xYieldResult );
+	prvReport( &xQueueResult );
+	return 0;
+}
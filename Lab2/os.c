@@ -13,6 +13,29 @@
 // function definitions in osasm.s
 void StartOS(void);
 
+#define COUNTFLAG     0x00010000   // STCTRL, SysTick counted down to 0
+#define PENDSTSET     0x04000000   // INTCTRL, pend SysTick
+#define STACK_PAINT   0xA5A5A5A5   // stack words never used
+#define STACK_GUARD   0x5AFE57AC   // lowest word of every stack
+
+/*
+    Free running bus cycle counter for the periodic event delays,
+    the DWT cycle counter on the target.
+*/
+#ifdef HOST_PORT
+#define CYCLE_COUNT()   Host_CycleCount()
+#else
+#define DEMCR         (*((volatile uint32_t *)0xE000EDFC))
+#define DWT_CTRL      (*((volatile uint32_t *)0xE0001000))
+#define DWT_CYCCNT    (*((volatile uint32_t *)0xE0001004))
+#define CPACR         (*((volatile uint32_t *)0xE000ED88))
+#define CYCLE_COUNT()   DWT_CYCCNT
+#endif
+
+#ifndef EVENT_STAGGER
+#define EVENT_STAGGER   1          // 0 runs every periodic event thread at phase 0
+#endif
+
 /* 
     Globals used in os.c.
 */
@@ -20,12 +43,25 @@ tcbType *RunPt;
 tcbType tcbs[NUMTHREADS];               /* private to os.c source file. */
 int32_t Stacks[NUMTHREADS][STACKSIZE];  /* private to os.c source file. */
 
+/* 
+    Idle thread, outside the round robin list of main threads. It runs
+    when every main thread is blocked. LastPt is the main thread that
+    ran last, the round robin goes on from there.
+*/
+static tcbType IdleTcb;
+static int32_t IdleStack[STACKSIZE];
+static tcbType *LastPt;
+static uint32_t SwitchStamp;    // cycle count at the last switch
+static void Idle(void);
+static void SetInitialStack(tcbType* pt, int32_t* stack, void(*thread)(void));
+
 /* 
     Declarations for periodic event threads, to be used in
-    OS_AddPeriodicEventThreads function.
+    OS_AddPeriodicEventThread function. Each one counts down its
+    own time slices.
 */
 static PeriodicTaskType PeriodicEventThreads[PERIODIC_TASKS_NUM];
-static volatile uint8_t TaskCounter;
+static uint8_t PeriodicEventCount;
 
 // ******** OS_Init ************
 // Initialize operating system, disable interrupts
@@ -42,43 +78,93 @@ void OS_Init(void)
     {
         tcbs[tcb].sp = NULL_PTR;
         tcbs[tcb].next = NULL_PTR;
+        tcbs[tcb].blocked = NULL_PTR;
+        tcbs[tcb].cycles = 0;
+        tcbs[tcb].stack = NULL_PTR;
     }
+    IdleTcb.next = NULL_PTR;         // never in the round robin
+    IdleTcb.blocked = NULL_PTR;
+    IdleTcb.cycles = 0;
+    SetInitialStack(&IdleTcb, IdleStack, &Idle);
+    LastPt = NULL_PTR;
 
     for ( uint8_t task = 0; task < PERIODIC_TASKS_NUM; task++ )  // init periodic tasks
     {
+        PeriodicEventThreads[task].PeriodicTaskPtr = NULL_PTR;
         PeriodicEventThreads[task].PeriodicTaskPeriod = 0;
     }
-    TaskCounter = 0;
+    PeriodicEventCount = 0;
+#ifndef HOST_PORT
+    DEMCR |= 0x01000000;     // enable the DWT
+    DWT_CYCCNT = 0;
+    DWT_CTRL |= 0x00000001;  // start the cycle counter
+    CPACR |= 0x00F00000;     // FPU on, saved by the switch, see osasm.s
+#endif
     RunPt = NULL_PTR;   // init RunPt
 }
 
 
  /* Private function: SetInitialStack()
-    @ parameter in:  stack number, must be in the range of NUMTHREADS.
+    @ parameter in:  TCB of the thread.
+                     stack of STACKSIZE words.
+                     thread entry, the initial PC.
     @ parameter out: none
-    @ description:   setting the initial stack pointer and thumb bit for
-                     specific thread.
+    @ description:   setting the initial stack pointer, PC and thumb bit
+                     for specific thread. The rest of the stack is
+                     painted with STACK_PAINT for OS_StackHighWater, the
+                     lowest word is STACK_GUARD. On the host the TCB sp
+                     is a host context instead, see host/osasm.c.
  */
-static void SetInitialStack(int stack)
+static void SetInitialStack(tcbType* pt, int32_t* stack, void(*thread)(void))
 {
-    tcbs[stack].sp = &Stacks[stack][STACKSIZE - 16];   // thread stack pointer.
-    Stacks[stack][STACKSIZE - 1] = R16;   // thumb bit.
-    Stacks[stack][STACKSIZE - 3] = R14;
-    Stacks[stack][STACKSIZE - 4] = R12;
-
-    Stacks[stack][STACKSIZE - 5] = R3;
-    Stacks[stack][STACKSIZE - 6] = R2;
-    Stacks[stack][STACKSIZE - 7] = R1;
-    Stacks[stack][STACKSIZE - 8] = R0;
-
-    Stacks[stack][STACKSIZE - 9]  = R11;
-    Stacks[stack][STACKSIZE - 10] = R10;
-    Stacks[stack][STACKSIZE - 11] = R9;
-    Stacks[stack][STACKSIZE - 12] = R8;
-    Stacks[stack][STACKSIZE - 13] = R7;
-    Stacks[stack][STACKSIZE - 14] = R6;
-    Stacks[stack][STACKSIZE - 15] = R5;
-    Stacks[stack][STACKSIZE - 16] = R4;
+    uint32_t word;
+
+    pt->stack = stack;
+    stack[0] = (int32_t)STACK_GUARD;
+    for ( word = 1; word < STACKSIZE; word++ )
+    {
+        stack[word] = (int32_t)STACK_PAINT;
+    }
+#ifdef HOST_PORT
+    pt->sp = Host_InitialStack(thread);
+#else
+    pt->sp = &stack[STACKSIZE - 18];   // thread stack pointer.
+    stack[STACKSIZE - 2] = (int32_t)(thread);  // PC
+    stack[STACKSIZE - 1] = R16;   // thumb bit.
+    stack[STACKSIZE - 3] = R14;
+    stack[STACKSIZE - 4] = R12;
+
+    stack[STACKSIZE - 5] = R3;
+    stack[STACKSIZE - 6] = R2;
+    stack[STACKSIZE - 7] = R1;
+    stack[STACKSIZE - 8] = R0;
+
+    stack[STACKSIZE - 9]  = R11;
+    stack[STACKSIZE - 10] = R10;
+    stack[STACKSIZE - 11] = R9;
+    stack[STACKSIZE - 12] = R8;
+    stack[STACKSIZE - 13] = R7;
+    stack[STACKSIZE - 14] = R6;
+    stack[STACKSIZE - 15] = R5;
+    stack[STACKSIZE - 16] = R4;
+
+    stack[STACKSIZE - 17] = EXC_RETURN;  // FPU unused so far
+    stack[STACKSIZE - 18] = R0;          // padding to 8 bytes
+#endif
+}
+
+ /* Private function: Idle()
+    @ parameter in:  none
+    @ parameter out: none
+    @ description:   runs when every main thread is blocked, sleeps the
+                     core until the next interrupt.
+ */
+static void Idle(void)
+{
+    while ( 1 )
+    {
+        WaitForInterrupt();
+    }
 }
 
 //******** OS_AddThreads ***************
@@ -101,19 +187,13 @@ int OS_AddThreads(void(*thread0)(void),
     tcbs[3].next = &tcbs[0];
 
     // initialize four stacks, including initial PC
-    for ( uint8_t stack = 0; stack < NUMTHREADS; stack++ )
-    {
-        SetInitialStack(stack);
-    }
-	
-    /* set PC for each thread. */
-    Stacks[0][STACKSIZE - 2] = (int32_t)(thread0);  
-    Stacks[1][STACKSIZE - 2] = (int32_t)(thread1);
-    Stacks[2][STACKSIZE - 2] = (int32_t)(thread2);
-    Stacks[3][STACKSIZE - 2] = (int32_t)(thread3);
+    SetInitialStack(&tcbs[0], Stacks[0], thread0);
+    SetInitialStack(&tcbs[1], Stacks[1], thread1);
+    SetInitialStack(&tcbs[2], Stacks[2], thread2);
+    SetInitialStack(&tcbs[3], Stacks[3], thread3);
 	
 	 // initialize RunPt
-    RunPt = &tcbs[0];
+    RunPt = LastPt = &tcbs[0];
 	
     EndCritical(status);
     return 1;               // successful
@@ -137,12 +217,6 @@ int OS_AddThreads3(void(*task0)(void),
     tcbs[1].next = &tcbs[2];
     tcbs[2].next = &tcbs[0];
 
-    // initialize four stacks, including initial PC
-    for ( uint8_t stack = 0; stack < THREADS_NUM_3; stack++ )
-    {
-        SetInitialStack(stack);
-    }
-
     if ( NULL_PTR == (task0) ||
          NULL_PTR == (task1) ||
          NULL_PTR == (task2))
@@ -151,19 +225,103 @@ int OS_AddThreads3(void(*task0)(void),
         return 0;
     }
 
-    /* set PC for each thread. */
-    Stacks[0][STACKSIZE - 2] = (uint32_t)(task0);
-    Stacks[1][STACKSIZE - 2] = (uint32_t)(task1);
-    Stacks[2][STACKSIZE - 2] = (uint32_t)(task2);
+    // initialize three stacks, including initial PC
+    SetInitialStack(&tcbs[0], Stacks[0], task0);
+    SetInitialStack(&tcbs[1], Stacks[1], task1);
+    SetInitialStack(&tcbs[2], Stacks[2], task2);
 	
 	// initialize RunPt
-    RunPt = &tcbs[0];
+    RunPt = LastPt = &tcbs[0];
 
     EndCritical(status);
     return 1;               // successful
 }
 #endif // LAB_STEP == 3
 
+ /* Private function: Gcd()
+    @ parameter in:  two numbers, not both zero.
+    @ parameter out: greatest common divisor.
+ */
+static uint32_t Gcd(uint32_t a, uint32_t b)
+{
+    uint32_t r;
+    while ( b != 0 )
+    {
+        r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+ /* Private function: EventPhase()
+    @ parameter in:  period of a new periodic event thread.
+    @ parameter out: phase for it, 0 to period-1.
+    @ description:   two events with periods p1, p2 and phases f1, f2 run
+                     in the same time slice somewhere in the hyperperiod
+                     exactly when f1 and f2 are equal modulo gcd(p1, p2).
+                     The phase that meets the fewest events added before
+                     is taken, the lowest one on a tie. With EVENT_STAGGER
+                     0 every phase is 0, as before.
+ */
+static uint32_t EventPhase(uint32_t period)
+{
+    uint32_t phase, best = 0, bestMeets = PERIODIC_TASKS_NUM + 1;
+    uint32_t meets, g;
+    uint8_t e;
+
+    if ( EVENT_STAGGER == 0 )
+    {
+        return 0;
+    }
+    for ( phase = 0; (phase < period) && (bestMeets > 0); phase++ )
+    {
+        meets = 0;
+        for ( e = 0; e < PeriodicEventCount; e++ )
+        {
+            g = Gcd(period, PeriodicEventThreads[e].PeriodicTaskPeriod);
+            if ( (phase % g) == (PeriodicEventThreads[e].PeriodicTaskPhase % g) )
+            {
+                meets++;
+            }
+        }
+        if ( meets < bestMeets )
+        {
+            bestMeets = meets;
+            best = phase;
+        }
+    }
+    return best;
+}
+
+//******** OS_AddPeriodicEventThread ***************
+// Add one background periodic event thread, up to PERIODIC_TASKS_NUM
+// The phase is chosen so the thread shares as few time slices as
+// possible with the ones added before it over the hyperperiod
+// Inputs: pointer to a void/void event thread function
+//         period given in units of OS_Launch (Lab 2 this will be msec)
+// Outputs: 1 if successful, 0 if this thread cannot be added
+// Same rules as OS_AddPeriodicEventThreads
+int OS_AddPeriodicEventThread(void(*thread)(void), uint32_t period)
+{
+    PeriodicTaskType *ev;
+
+    if ( (PeriodicEventCount >= PERIODIC_TASKS_NUM) || (period == 0) || (thread == NULL_PTR) )
+    {
+        return 0;
+    }
+    ev = &PeriodicEventThreads[PeriodicEventCount];
+    ev->PeriodicTaskPtr = thread;
+    ev->PeriodicTaskPeriod = period;
+    ev->PeriodicTaskPhase = EventPhase(period);
+    ev->Counter = ev->PeriodicTaskPhase + period;   // first run one period in
+    ev->Runs = 0;
+    ev->MinDelay = 0xFFFFFFFF;
+    ev->MaxDelay = 0;
+    PeriodicEventCount++;
+    return 1;
+}
+
 //******** OS_AddPeriodicEventThreads ***************
 // Add two background periodic event threads
 // Typically this function receives the highest priority
@@ -177,11 +335,37 @@ int OS_AddThreads3(void(*task0)(void),
 int OS_AddPeriodicEventThreads(void(*thread1)(void), uint32_t period1,
     void(*thread2)(void), uint32_t period2)
 {
-    PeriodicEventThreads[0].PeriodicTaskPtr = thread1;
-    PeriodicEventThreads[0].PeriodicTaskPeriod = period1;
+    if ( PeriodicEventCount + 2 > PERIODIC_TASKS_NUM )
+    {
+        return 0;
+    }
+    return OS_AddPeriodicEventThread(thread1, period1) &&
+           OS_AddPeriodicEventThread(thread2, period2);
+}
+
+//******** OS_PeriodicEventStats ***************
+// Timing of a periodic event thread
+// Inputs:  event 0 to PERIODIC_TASKS_NUM-1 in the order they were added
+//          where to store the phase, in time slices
+//          where to store the number of runs
+//          where to store the longest delay, in bus cycles from the
+//          start of the time slice to the start of a run
+//          where to store the jitter, longest minus shortest delay
+// Outputs: 1 if successful, 0 if there is no such event thread
+int OS_PeriodicEventStats(uint32_t event, uint32_t* phase, uint32_t* runs,
+    uint32_t* delay, uint32_t* jitter)
+{
+    PeriodicTaskType *ev;
 
-    PeriodicEventThreads[1].PeriodicTaskPtr = thread2;
-    PeriodicEventThreads[1].PeriodicTaskPeriod = period2;
+    if ( event >= PeriodicEventCount )
+    {
+        return 0;
+    }
+    ev = &PeriodicEventThreads[event];
+    *phase = ev->PeriodicTaskPhase;
+    *runs = ev->Runs;
+    *delay = ev->MaxDelay;
+    *jitter = (ev->Runs > 0) ? (ev->MaxDelay - ev->MinDelay) : 0;
     return 1;
 }
 
@@ -198,36 +382,184 @@ void OS_Launch(uint32_t TheTimeSlice)
     STCURRENT = 0;               // any write to current clears it
     SYSPRI3 = (SYSPRI3 & 0x00FFFFFF) | 0xE0000000; // priority 7
     STRELOAD = TheTimeSlice - 1; // reload value
+    SwitchStamp = CYCLE_COUNT();
     STCTRL = 0x00000007;         // enable, core clock and interrupt arm
     StartOS();                   // start on the first task
 }
 
+ /* Private function: RunPeriodicEvents()
+    @ parameter in:  none
+    @ parameter out: none
+    @ description:   counts down every periodic event thread once per time
+                     slice and runs the ones that are due, in the order
+                     they were added. Events that share a time slice
+                     delay each other, the delay of each run is kept.
+ */
+static void RunPeriodicEvents(void)
+{
+    PeriodicTaskType *ev;
+    uint32_t start, delay;
+    uint8_t e;
+
+    start = CYCLE_COUNT();
+    for ( e = 0; e < PeriodicEventCount; e++ )
+    {
+        ev = &PeriodicEventThreads[e];
+        ev->Counter--;
+        if ( ev->Counter == 0 )
+        {
+            ev->Counter = ev->PeriodicTaskPeriod;
+            delay = CYCLE_COUNT() - start;
+            if ( delay < ev->MinDelay )
+            {
+                ev->MinDelay = delay;
+            }
+            if ( delay > ev->MaxDelay )
+            {
+                ev->MaxDelay = delay;
+            }
+            ev->Runs++;
+            (ev->PeriodicTaskPtr)();
+        }
+    }
+}
+
+/**************************************  
+@ function name: StackOverflow()
+@ parameter in:  thread that overflowed
+@ parameter out: none, never returns
+@ description:   the guard word at the bottom of the stack of pt was
+                 overwritten, the thread (or an ISR that interrupted
+                 it) ran past its stack. Stops with interrupts
+                 disabled, StackOverflowPt tells the debugger which
+                 thread it was.
+*/
+tcbType *StackOverflowPt;
+static void StackOverflow(tcbType *pt)
+{
+    StackOverflowPt = pt;
+    DisableInterrupts();
+    while ( 1 )
+    {
+    }
+}
+
 /**************************************  
 @ function name: Scheduler()
 @ parameter in:  none
 @ parameter out: none
-@ description:   OS scheduler runs one periodic thread every 1 ms and
-                 the other one every 100 ms in Round Robin criteria.
+@ description:   OS scheduler runs the periodic event threads that are
+                 due, then picks the next main thread that is not
+                 blocked in Round Robin criteria, the idle thread if all
+                 of them are blocked. The cycles since the last switch
+                 are charged to the thread that ran, the guard word
+                 of its stack is checked first.
 @ note:          this function is linked to the osasm SysTick_Handler
-                 context switcher, for future features to be added.
+                 context switcher. OS_Suspend also pends SysTick, the
+                 periodic threads only run when COUNTFLAG shows that a
+                 whole time slice went by.
 */
 void Scheduler(void) // every time slice
 {
-    TaskCounter++;
+    tcbType *pt;
+    uint32_t now;
+
+    if ( RunPt->stack[0] != (int32_t)STACK_GUARD )
+    {
+        StackOverflow(RunPt);
+    }
+    if ( STCTRL & COUNTFLAG )  // reading STCTRL clears COUNTFLAG on the target
+    {
+#ifdef HOST_PORT
+        __atomic_and_fetch(&STCTRL, ~COUNTFLAG, __ATOMIC_SEQ_CST);
+#endif
+        RunPeriodicEvents();
+    }
+    now = CYCLE_COUNT();
+    RunPt->cycles += now - SwitchStamp;
+    SwitchStamp = now;
+
+    pt = LastPt;
+    do
+    {
+        pt = pt->next;
+        if ( pt->blocked == NULL_PTR )
+        {
+            RunPt = LastPt = pt;
+            return;
+        }
+    } while ( pt != LastPt );
+    RunPt = &IdleTcb;          // every main thread is blocked
+}
+
+//******** OS_Suspend ***************
+// Give up the rest of the time slice, the next main thread
+// that is not blocked runs. Called by main threads only.
+// The SysTick count is left alone so the periodic threads
+// keep their 1 ms steps, the next thread gets what is left
+// of the time slice.
+// Inputs: none
+// Outputs: none
+void OS_Suspend(void)
+{
+    INTCTRL = PENDSTSET;       // trigger SysTick
+#ifdef HOST_PORT
+    Host_TakePending();        // no NVIC on the host, take the SysTick now
+#endif
+}
+
+//******** OS_ThreadCycles ***************
+// CPU time of a main thread or of the idle thread in bus cycles,
+// from the cycle counter at every switch, up to the last switch
+// Inputs:  thread 0 to NUMTHREADS-1 in OS_AddThreads order,
+//          NUMTHREADS for the idle thread
+//          where to store the cycles
+// Outputs: 1 if successful, 0 if there is no such thread
+int OS_ThreadCycles(uint32_t thread, uint64_t* cycles)
+{
+    long cr;
+
+    if ( thread > NUMTHREADS )
+    {
+        return 0;
+    }
+    cr = StartCritical();      // two words, not read atomically
+    *cycles = (thread == NUMTHREADS) ? IdleTcb.cycles : tcbs[thread].cycles;
+    EndCritical(cr);
+    return 1;
+}
+
+//******** OS_StackHighWater ***************
+// Most stack words a thread has used since OS_AddThreads, the
+// words from the top down to the lowest one no longer
+// STACK_PAINT, ISRs that interrupted it included.
+// Inputs:  thread 0 to NUMTHREADS-1 in OS_AddThreads order,
+//          NUMTHREADS for the idle thread
+// Outputs: words used, STACKSIZE if the guard word is gone,
+//          0 before OS_AddThreads
+uint32_t OS_StackHighWater(uint32_t thread)
+{
+    int32_t* stack;
+    uint32_t word = 1;
 
-    // periodic task 1 runs every 1 ms, 1, 2, 3...
-    // periodic task 2 runs every 100 ms, 1, 101...
-    if ( TaskCounter >= PeriodicEventThreads[0].PeriodicTaskPeriod ) // runs every 1 ms
+    if ( thread > NUMTHREADS )
+    {
+        return 0;
+    }
+    stack = (thread == NUMTHREADS) ? IdleTcb.stack : tcbs[thread].stack;
+    if ( stack == NULL_PTR )
+    {
+        return 0;
+    }
+    if ( stack[0] != (int32_t)STACK_GUARD )
     {
-        (PeriodicEventThreads[0].PeriodicTaskPtr)();  // Task0
+        return STACKSIZE;
     }
-    if ( TaskCounter >= PeriodicEventThreads[1].PeriodicTaskPeriod ) // runs every 100 ms
+    while ( (word < STACKSIZE) && (stack[word] == (int32_t)STACK_PAINT) )
     {
-        (PeriodicEventThreads[1].PeriodicTaskPtr)();  // Task1
-        TaskCounter = 0;
+        word++;
     }
-    
-    RunPt = RunPt->next;
+    return STACKSIZE - word;
 }
 
 // ******** OS_InitSemaphore ************
@@ -243,9 +575,7 @@ void OS_InitSemaphore(int32_t* semaPt, int32_t value)
 }
 
 // ******** OS_Wait ************
-// Decrement semaphore
-// Lab2 spinlock (does not suspend while spinning)
-// Lab3 block if less than zero
+// Decrement semaphore and block if less than zero
 // Inputs:  pointer to a counting semaphore
 // Outputs: none
 void OS_Wait(int32_t* semaPt)
@@ -253,26 +583,38 @@ void OS_Wait(int32_t* semaPt)
 	long cr;
     cr = StartCritical();  // ensure mutual exclusion
 
-    while ( (*semaPt) <= 0 )
+    (*semaPt) = (*semaPt) - 1;
+    if ( (*semaPt) < 0 )
     {
-        EndCritical(cr);   // interrupts could happen here
-        cr = StartCritical();
+        RunPt->blocked = semaPt;   // the scheduler skips it until OS_Signal
+        EndCritical(cr);
+        OS_Suspend();              // runs again once it is woken up
+        return;
     }
-
-    (*semaPt) = (*semaPt) - 1;  // decrement as indication of sucessful reception
     EndCritical(cr);
 }
 
 // ******** OS_Signal ************
-// Increment semaphore
-// Lab2 spinlock
-// Lab3 wakeup blocked thread if appropriate
+// Increment semaphore, wake up a blocked thread if appropriate
 // Inputs:  pointer to a counting semaphore
 // Outputs: none
 void OS_Signal(int32_t* semaPt)
 {
+    tcbType *pt;
     long cr = StartCritical();        // ensure mutual exclusion 
     (*semaPt) = (*semaPt) + 1;  // increment as indication of new available data
+    if ( ((*semaPt) <= 0) && (LastPt != NULL_PTR) )  // a thread may still be blocked on it
+    {
+        pt = LastPt;            // the next one round robin wakes up
+        do                      // one lap, a value set below 0 has no thread
+        {
+            pt = pt->next;
+        } while ( (pt->blocked != semaPt) && (pt != LastPt) );
+        if ( pt->blocked == semaPt )
+        {
+            pt->blocked = NULL_PTR;
+        }
+    }
     EndCritical(cr);
 }
 
@@ -305,9 +647,11 @@ void OS_MailBox_Send(uint32_t data)
     long cr = StartCritical();
     MailData = data;
 
-    if ( MailSend )  // mailbox has unread data
+    if ( MailSend > 0 )  // mailbox has unread data, the receiver gets the new one
     {
         MailLost++;
+        EndCritical(cr);
+        return;
     }
 	EndCritical(cr);
     OS_Signal(&MailSend);
@@ -316,8 +660,7 @@ void OS_MailBox_Send(uint32_t data)
 // ******** OS_MailBox_Recv ************
 // retreive mail from the MailBox
 // Use semaphore to synchronize with OS_MailBox_Send
-// Lab 2 spin on semaphore if mailbox empty
-// Lab 3 block on semaphore if mailbox empty
+// Blocks on the semaphore while the mailbox is empty
 // Inputs:  none
 // Outputs: data retreived
 // Errors:  none
@@ -333,4 +676,90 @@ uint32_t OS_MailBox_Recv(void)
     return data;
 }
 
+// ******** OS_MailBox_Create ************
+// Initialize a mailbox that passes pointers to buffers, empty.
+// The data is never copied: the buffer belongs to the receiver
+// once it is received, or to the sender again if it comes back
+// from OS_MailBox_Put.
+// Producer is an event or main thread, consumer is a main thread
+// Inputs:  pointer to a mailbox
+//          storage for size pointers
+//          number of slots, at least 1
+//          MAILBOX_QUEUE: buffers are received in order, a full
+//          mailbox refuses new ones
+//          MAILBOX_LATEST: a full mailbox drops its oldest buffer,
+//          with one slot the receiver always gets the newest
+// Outputs: 1 if successful, 0 if size is 0
+int OS_MailBox_Create(MailBoxType* mailPt, void** slots, uint32_t size, uint32_t mode)
+{
+    if ( size == 0 )
+    {
+        return 0;
+    }
+    mailPt->Slots = slots;
+    mailPt->Size = size;
+    mailPt->Mode = mode;
+    mailPt->Put = 0;
+    mailPt->Get = 0;
+    mailPt->Used = 0;
+    OS_InitSemaphore(&mailPt->Count, 0);
+    return 1;
+}
+
+// ******** OS_MailBox_Put ************
+// Pass a buffer to the receiver, do not spin/block if full
+// Inputs:  pointer to a mailbox
+//          buffer to be passed, not NULL_PTR
+// Outputs: the buffer that leaves the mailbox unread, the sender
+//          owns it again: NULL_PTR if none, buffer itself if a
+//          MAILBOX_QUEUE mailbox is full, the oldest buffer if a
+//          MAILBOX_LATEST mailbox is full
+void* OS_MailBox_Put(MailBoxType* mailPt, void* buffer)
+{
+    void* dropped = NULL_PTR;
+    long cr = StartCritical();
+
+    if ( mailPt->Used == mailPt->Size )
+    {
+        if ( mailPt->Mode == MAILBOX_QUEUE )
+        {
+            EndCritical(cr);
+            return buffer;        // refused, the sender keeps it
+        }
+        // the newest takes the place of the oldest, the count of
+        // pointers to receive does not change
+        dropped = mailPt->Slots[mailPt->Get];
+        mailPt->Get = (mailPt->Get + 1 == mailPt->Size) ? 0 : mailPt->Get + 1;
+        mailPt->Used--;
+    }
+    mailPt->Slots[mailPt->Put] = buffer;
+    mailPt->Put = (mailPt->Put + 1 == mailPt->Size) ? 0 : mailPt->Put + 1;
+    mailPt->Used++;
+    EndCritical(cr);
+    if ( dropped == NULL_PTR )    // one more pointer to receive
+    {
+        OS_Signal(&mailPt->Count);
+    }
+    return dropped;
+}
+
+// ******** OS_MailBox_Get ************
+// Receive the oldest buffer in a mailbox
+// Blocks on the mailbox semaphore while the mailbox is empty
+// Inputs:  pointer to a mailbox
+// Outputs: buffer received, owned by the receiver
+void* OS_MailBox_Get(MailBoxType* mailPt)
+{
+    void* buffer;
+    long cr;
+
+    OS_Wait(&mailPt->Count);      // one pointer is claimed for this thread
+    cr = StartCritical();
+    buffer = mailPt->Slots[mailPt->Get];
+    mailPt->Get = (mailPt->Get + 1 == mailPt->Size) ? 0 : mailPt->Get + 1;
+    mailPt->Used--;
+    EndCritical(cr);
+    return buffer;
+}
+
 
@@ -28,7 +28,7 @@
 
  // grader needs access to TCBs and stacks
 #define NUMTHREADS             4              // maximum number of threads
-#define PERIODIC_TASKS_NUM     2
+#define PERIODIC_TASKS_NUM     8              // maximum number of periodic event threads
 #define THREADS_NUM_3          3
 #define STACKSIZE              100            // number of 32-bit words in stack per thread
 #define NULL_PTR               ((void*)0)     // Null pointer
@@ -61,16 +61,24 @@
 #define R14     0x14141414
 #define R15     0x15151515   // PC register.
 #define R16     0x01000000   // Thumb bit register - PSR.
+#define EXC_RETURN  0xFFFFFFF9   // SysTick LR, back to thread mode on MSP.
 
 /*
     TCB data structure.
-    sp:   stack pointer
-    next: linked list pointer
+    sp:      stack pointer
+    next:    linked list pointer
+    blocked: semaphore the thread is blocked on, NULL_PTR if none
+    cycles:  bus cycles the thread ran, event threads that ran in its
+             time slices included
+    stack:   lowest word of its stack, the guard word
 */
 struct tcb
 {
     int32_t*    sp;       // pointer to stack (valid for threads not running
     struct tcb* next;     // linked-list pointer
+    int32_t*    blocked;  // nonzero if blocked on this semaphore
+    uint64_t    cycles;   // CPU time in bus cycles
+    int32_t*    stack;    // lowest word of the stack, STACK_GUARD
 };
 typedef struct tcb tcbType;
 
@@ -78,6 +86,11 @@ typedef struct tcb tcbType;
     Periodic tasks data structure.
     PeriodicTaskPtr:    function pointer for the periodic task
     PeriodicTaskPeriod: period of the periodic task
+    PeriodicTaskPhase:  time slice of the first run, 0 to period-1
+    Counter:            time slices to the next run
+    Runs:               number of runs
+    MinDelay, MaxDelay: shortest and longest time in bus cycles from the
+                        start of the time slice to the start of a run
 */
 typedef void(*vTaskPtr)(void);  // function pointer tasks none and returns none.
 
@@ -85,8 +98,37 @@ typedef struct
 {
     vTaskPtr PeriodicTaskPtr;
     uint32_t PeriodicTaskPeriod;
+    uint32_t PeriodicTaskPhase;
+    uint32_t Counter;
+    uint32_t Runs;
+    uint32_t MinDelay;
+    uint32_t MaxDelay;
 }PeriodicTaskType;
 
+/*
+    Pointer mailbox data structure, see OS_MailBox_Create.
+    Slots:  ring of Size buffer pointers, storage owned by the caller
+    Size:   number of slots
+    Mode:   MAILBOX_QUEUE or MAILBOX_LATEST
+    Put:    next slot to fill
+    Get:    oldest slot
+    Used:   pointers in the ring
+    Count:  semaphore, pointers not yet claimed by a receiver
+*/
+#define MAILBOX_QUEUE         (0U)           // full mailbox refuses new buffers
+#define MAILBOX_LATEST        (1U)           // full mailbox drops its oldest buffer
+
+typedef struct
+{
+    void**   Slots;
+    uint32_t Size;
+    uint32_t Mode;
+    uint32_t Put;
+    uint32_t Get;
+    uint32_t Used;
+    int32_t  Count;
+}MailBoxType;
+
 // ******** OS_Init ************
 // Initialize operating system, disable interrupts
 // Initialize OS controlled I/O: systick, bus clock as fast as possible
@@ -114,6 +156,28 @@ int OS_AddThreads3(void(*task0)(void),
     void(*task1)(void),
     void(*task2)(void));
 
+//******** OS_AddPeriodicEventThread ***************
+// Add one background periodic event thread, up to PERIODIC_TASKS_NUM
+// The phase is chosen so the thread shares as few time slices as
+// possible with the ones added before it over the hyperperiod
+// Inputs: pointer to a void/void event thread function
+//         period given in units of OS_Launch (Lab 2 this will be msec)
+// Outputs: 1 if successful, 0 if this thread cannot be added
+// Same rules as OS_AddPeriodicEventThreads
+int OS_AddPeriodicEventThread(void(*thread)(void), uint32_t period);
+
+//******** OS_PeriodicEventStats ***************
+// Timing of a periodic event thread
+// Inputs:  event 0 to PERIODIC_TASKS_NUM-1 in the order they were added
+//          where to store the phase, in time slices
+//          where to store the number of runs
+//          where to store the longest delay, in bus cycles from the
+//          start of the time slice to the start of a run
+//          where to store the jitter, longest minus shortest delay
+// Outputs: 1 if successful, 0 if there is no such event thread
+int OS_PeriodicEventStats(uint32_t event, uint32_t* phase, uint32_t* runs,
+    uint32_t* delay, uint32_t* jitter);
+
 //******** OS_AddPeriodicEventThreads ***************
 // Add two background periodic event threads
 // Typically this function receives the highest priority
@@ -134,6 +198,33 @@ int OS_AddPeriodicEventThreads(void(*thread1)(void), uint32_t period1,
 // Errors: TheTimeSlice must be less than 16,777,216
 void OS_Launch(uint32_t TheTimeSlice);
 
+//******** OS_Suspend ***************
+// Give up the rest of the time slice, the next main thread
+// that is not blocked runs. Called by main threads only.
+// Inputs: none
+// Outputs: none
+void OS_Suspend(void);
+
+//******** OS_ThreadCycles ***************
+// CPU time of a main thread or of the idle thread in bus cycles,
+// from the cycle counter at every switch, up to the last switch
+// Inputs:  thread 0 to NUMTHREADS-1 in OS_AddThreads order,
+//          NUMTHREADS for the idle thread
+//          where to store the cycles
+// Outputs: 1 if successful, 0 if there is no such thread
+int OS_ThreadCycles(uint32_t thread, uint64_t* cycles);
+
+//******** OS_StackHighWater ***************
+// Most stack words a thread has used, ISRs that interrupted it
+// included, out of STACKSIZE. The lowest word of every stack is
+// a guard checked on every switch, an overwritten guard stops
+// the system (StackOverflowPt in os.c).
+// Inputs:  thread 0 to NUMTHREADS-1 in OS_AddThreads order,
+//          NUMTHREADS for the idle thread
+// Outputs: words used, STACKSIZE if the guard word is gone,
+//          0 before OS_AddThreads
+uint32_t OS_StackHighWater(uint32_t thread);
+
 // ******** OS_InitSemaphore ************
 // Initialize counting semaphore
 // Inputs:  pointer to a semaphore
@@ -142,17 +233,13 @@ void OS_Launch(uint32_t TheTimeSlice);
 void OS_InitSemaphore(int32_t* semaPt, int32_t value);
 
 // ******** OS_Wait ************
-// Decrement semaphore
-// Lab2 spinlock (does not suspend while spinning)
-// Lab3 block if less than zero
+// Decrement semaphore and block if less than zero
 // Inputs:  pointer to a counting semaphore
 // Outputs: none
 void OS_Wait(int32_t* semaPt);
 
 // ******** OS_Signal ************
-// Increment semaphore
-// Lab2 spinlock
-// Lab3 wakeup blocked thread if appropriate
+// Increment semaphore, wake up a blocked thread if appropriate
 // Inputs:  pointer to a counting semaphore
 // Outputs: none
 void OS_Signal(int32_t* semaPt);
@@ -175,11 +262,43 @@ void OS_MailBox_Send(uint32_t data);
 // ******** OS_MailBox_Recv ************
 // retreive mail from the MailBox
 // Use semaphore to synchronize with OS_MailBox_Send
-// Lab 2 spin on semaphore if mailbox empty
-// Lab 3 block on semaphore if mailbox empty
+// Blocks on the semaphore while the mailbox is empty
 // Inputs:  none
 // Outputs: data retreived
 // Errors:  none
 uint32_t OS_MailBox_Recv(void);
 
+// ******** OS_MailBox_Create ************
+// Initialize a mailbox that passes pointers to buffers, empty.
+// The data is never copied: the buffer belongs to the receiver
+// once it is received, or to the sender again if it comes back
+// from OS_MailBox_Put.
+// Producer is an event or main thread, consumer is a main thread
+// Inputs:  pointer to a mailbox
+//          storage for size pointers
+//          number of slots, at least 1
+//          MAILBOX_QUEUE: buffers are received in order, a full
+//          mailbox refuses new ones
+//          MAILBOX_LATEST: a full mailbox drops its oldest buffer,
+//          with one slot the receiver always gets the newest
+// Outputs: 1 if successful, 0 if size is 0
+int OS_MailBox_Create(MailBoxType* mailPt, void** slots, uint32_t size, uint32_t mode);
+
+// ******** OS_MailBox_Put ************
+// Pass a buffer to the receiver, do not spin/block if full
+// Inputs:  pointer to a mailbox
+//          buffer to be passed, not NULL_PTR
+// Outputs: the buffer that leaves the mailbox unread, the sender
+//          owns it again: NULL_PTR if none, buffer itself if a
+//          MAILBOX_QUEUE mailbox is full, the oldest buffer if a
+//          MAILBOX_LATEST mailbox is full
+void* OS_MailBox_Put(MailBoxType* mailPt, void* buffer);
+
+// ******** OS_MailBox_Get ************
+// Receive the oldest buffer in a mailbox
+// Blocks on the mailbox semaphore while the mailbox is empty
+// Inputs:  pointer to a mailbox
+// Outputs: buffer received, owned by the receiver
+void* OS_MailBox_Get(MailBoxType* mailPt);
+
 #endif /* os.h */
@@ -20,27 +20,42 @@
 ; SysTick_Handler
 ; Context Switcher in assembly for high performance.
 ; 1. Disable interrupts
-; 2. Save the current context by pushing the 8 registers R4-R11
+; 2. Save the current context by pushing the 8 registers R4-R11, and
+;    EXC_RETURN. A thread that used the FPU, EXC_RETURN bit 4 clear, had
+;    S0-S15,FPSCR stacked by the CPU and also pushes S16-S31.
 ; 3. Load the RunPtr to SP
 ; 4. Skip to the next thread, RunPtr = RunPtr->next
-; 5. Restore the 8 registers R4-R11
+; 5. Restore EXC_RETURN, the 8 registers R4-R11 and for an FPU thread
+;    S16-S31
 ; 6. Enable interrupts back
-; 7. Branch to LR, CPU restores the remaining 8 registers automatically
+; 7. Branch to LR, CPU restores the remaining 8 registers automatically,
+;    and S0-S15,FPSCR for an FPU thread
 
 SysTick_Handler                ; 1) Saves R0-R3,R12,LR,PC,PSR
     CPSID   I                  ; 2) Prevent interrupt during switch
+    IF {TARGET_FPU_VFP}
+    TST     LR, #0x10          ;    EXC_RETURN bit 4 clear, FPU thread
+    IT      EQ
+    VPUSHEQ {S16-S31}
+    ENDIF
     PUSH    {R4-R11}           ; 3) Save the current context, remaining registers R4-R11
+    PUSH    {R0, LR}           ;    and EXC_RETURN, R0 keeps the stack 8 byte aligned for the C Scheduler.
     LDR     R0, =RunPt        ; 4) Load the current thread, R0 = RunPtr
     LDR     R1, [R0]           ;    R1 = RunPtr
     STR     SP, [R1]           ; 5) Save SP into TCB
     ;LDR     R1, [R1, #4]       ; 6) R1 = RunPtr->next
     ;STR     R1, [R0]           ;    RunPtr = R1
-    PUSH    {R0, LR}           ; R0 and LR must be saved before branching to Scheduler written in C.
     BL      Scheduler          ; Extending the capabilities of scheduler using C.
-    POP     {R0, LR}
+    LDR     R0, =RunPt
     LDR     R1, [R0]
     LDR     SP, [R1]           ; 7) SP = RunPtr->sp
+    POP     {R0, LR}           ;    EXC_RETURN of the new thread
     POP     {R4-R11}           ; 8) Restore the 8 registers, R4-R11
+    IF {TARGET_FPU_VFP}
+    TST     LR, #0x10
+    IT      EQ
+    VPOPEQ  {S16-S31}
+    ENDIF
     CPSIE   I                  ; 9) tasks run with interrupts enabled
     BX      LR                 ; 10) restore R0-R3,R12,LR,PC,PSR
 
@@ -49,7 +64,8 @@ SysTick_Handler                ; 1) Saves R0-R3,R12,LR,PC,PSR
 ; Setting the SP to the value of the first thread.
 ; Pulling all registers off the stack explicitly.
 ; The stack is set as if it had been running previously, was interrupted
-; - 8 registers were pushed - and suspended - another 8 registers pushed.
+; - 8 registers were pushed - and suspended - another 8 registers and
+; EXC_RETURN pushed.
 ; When launch the first thread for the first time we do not execute a 
 ; return from interrupt (we just pull 16 registers from its stack). 
 ;Thus, the state of the thread is initialized and is now ready to run.
@@ -58,6 +74,7 @@ StartOS
     LDR     R0, =RunPt        ; Currently running thread
     LDR     R2, [R0]           ; R1 has the value of RunPtr
     LDR     SP, [R2]           ; SP = RunPtr->sp
+    ADD     SP, SP, #8         ; Discard padding and EXC_RETURN, no FPU state yet
     POP     {R4-R11}           ; Restore registers R4-R11
     POP     {R0-R3}
     POP     {R12}
@@ -56,9 +56,9 @@ uint32_t SoundRMS;          // Root Mean Square average of most recent sound sam
 uint32_t LightData;         // 100 lux
 int32_t TemperatureData;    // 0.1C
 // semaphores
-int32_t NewData;  // true when new numbers to display on top of LCD
-int32_t LCDmutex; // exclusive access to LCD
-int32_t I2Cmutex; // exclusive access to I2C
+sema_t NewData;  // true when new numbers to display on top of LCD
+sema_t LCDmutex; // exclusive access to LCD
+sema_t I2Cmutex; // exclusive access to I2C
 int ReDrawAxes = 0;         // non-zero means redraw axes on next display task
 
 enum plotstate{
@@ -349,6 +349,7 @@ void Task3(void){
 // Outputs: none
 void Task4(void){int32_t voltData,tempData;
   int done;
+  uint64_t lastWake = OS_Ticks();
   while(1){
     TExaS_Task4();     // records system time in array, toggles virtual logic analyzer
     Profile_Toggle4(); // viewed by a real logic analyzer to know Task4 started
@@ -357,7 +358,7 @@ void Task4(void){int32_t voltData,tempData;
     BSP_TempSensor_Start();
     OS_Signal(&I2Cmutex);
     done = 0;
-    OS_Sleep(1000);    // waits about 1 sec
+    OS_SleepUntil(&lastWake, 1000);    // one sample every second
     while(done == 0){
       OS_Wait(&I2Cmutex);
       done = BSP_TempSensor_End(&voltData, &tempData);
@@ -423,6 +424,7 @@ void Task5(void){int32_t soundSum;
 // Outputs: none
 void Task6(void){ uint32_t lightData;
   int done;
+  uint64_t lastWake = OS_Ticks();
   while(1){
     TExaS_Task6();     // records system time in array, toggles virtual logic analyzer
     Profile_Toggle6(); // viewed by a real logic analyzer to know Task6 started
@@ -431,7 +433,7 @@ void Task6(void){ uint32_t lightData;
     BSP_LightSensor_Start();
     OS_Signal(&I2Cmutex);
     done = 0;
-    OS_Sleep(800);     // waits about 0.8 sec
+    OS_SleepUntil(&lastWake, 800);     // one sample every 0.8 sec
     while(done == 0){
       OS_Wait(&I2Cmutex);
       done = BSP_LightSensor_End(&lightData);
@@ -455,7 +457,7 @@ void Task7(void){
   Count7 = 0;
   while(1){
     Count7++;
-    WaitForInterrupt();
+    OS_Idle();           // WaitForInterrupt, tickless when all others sleep
   }
 }
 /* ****************************************** */
@@ -468,7 +470,7 @@ void Task7(void){
 // Remember that you must have exactly one main() function, so
 // to work on this step, you must rename all other main()
 // functions in this file.
-int32_t s1,s2;
+sema_t s1,s2;
 int main_step1(void){
   OS_InitSemaphore(&s1, 0);
   OS_InitSemaphore(&s2, 1);
@@ -499,7 +501,7 @@ int main_step1(void){
 // Remember that you must have exactly one main() function, so
 // to work on this step, you must rename all other main()
 // functions in this file.
-int32_t sAB,sCD,sEF;
+sema_t sAB,sCD,sEF;
 int32_t CountA,CountB,CountC,CountD,CountE,CountF;
 void TaskA(void){ // producer
   CountA = 0;
@@ -816,7 +818,7 @@ void TaskT(void){ // consumer as main thread
   }
 }
 int32_t CountU=0;
-int32_t sUV;
+sema_t sUV;
 void TaskU(void){ // event thread every 100 ms
   CountU++;
   TExaS_Task2();
@@ -887,7 +889,7 @@ int main_step5(void){
 /* ****************************************** */
 /*          End of Step 5 Section             */
 /* ****************************************** */
-const unsigned short title2[] = {
+//const unsigned short title2[] = {
 // 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
 // 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
 // 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
@@ -12,34 +12,138 @@
 // function definitions in osasm.s
 void StartOS(void);
 void static RunPeriodicEvents(void);
+uint32_t static EventPhase(uint32_t period);
+void static Idle(void);
 
 #define NUMTHREADS       6        // maximum number of threads
-#define NUMPERIODIC      2        // maximum number of periodic threads
-#define STACKSIZE        100      // number of 32-bit words in stack per thread
+#define IDLE             NUMTHREADS  // tcb of the kernel idle thread
+#define NUMPERIODIC      8        // maximum number of periodic threads
+#define STACKSIZE        100      // default 32-bit words in stack per thread
+#ifndef STACK_WORDS               // words of each stack, OS_AddThreads order, then Idle
+#define STACK_WORDS      STACKSIZE, STACKSIZE, STACKSIZE, STACKSIZE, STACKSIZE, STACKSIZE, STACKSIZE
+#endif
+#ifndef STACKPOOL
+#define STACKPOOL        ((NUMTHREADS+1)*STACKSIZE)  // words shared by all stacks
+#endif
+#define STACKMIN         32       // smallest stack in words
+#define STACK_PAINT      0xA5A5A5A5  // stack words never used
+#define STACK_GUARD      0x5AFE57AC  // lowest word of every stack
+#define THUMB_BIT        0x01000000  // thumb bit in the PSR of a new thread
 #define TIMER_FREQ       1000
 #define TIMER_PRIORITY	 6
+#ifndef TICKLESS
+#define TICKLESS         1        // 0 keeps every tick in OS_Idle
+#endif
+#ifndef PENDSV_SWITCH
+#define PENDSV_SWITCH    1        // 0 switches through SysTick as before
+#endif
+#define NULL             (void*)0
+
+// free running bus cycle counter for the periodic event delays,
+// the DWT cycle counter on the target
+#ifdef HOST_PORT
+#define CYCLE_COUNT()    Host_CycleCount()
+#else
+#define DEMCR            (*((volatile uint32_t *)0xE000EDFC))
+#define DWT_CTRL         (*((volatile uint32_t *)0xE0001000))
+#define DWT_CYCCNT       (*((volatile uint32_t *)0xE0001004))
+#define CPACR            (*((volatile uint32_t *)0xE000ED88))
+#define CYCLE_COUNT()    DWT_CYCCNT
+#endif
+
+// apply a write to STCTRL, the host timer does not see the register
+#ifdef HOST_PORT
+#define SYSTICK_UPDATE()   Host_SysTickControl()
+#else
+#define SYSTICK_UPDATE()
+#endif
+
+// pend a context switch. PendSV runs the same switch as SysTick at the
+// same priority 7 and leaves SysTick to the time slice.
+#define PENDSVSET        0x10000000  // INTCTRL, pend PendSV
+#define PENDSTSET        0x04000000  // INTCTRL, pend SysTick
+#if PENDSV_SWITCH
+#define SWITCH_PEND()    (INTCTRL = PENDSVSET)
+#else
+#define SWITCH_PEND()    (INTCTRL = PENDSTSET)
+#endif
+
+#ifndef EVENT_STAGGER
+#define EVENT_STAGGER    1        // 0 runs every periodic event thread at phase 0
+#endif
+
+// acquire load and release store of a FIFO index, and a full barrier.
+// One core: they keep the compiler from moving data accesses across
+// them, DMB orders them for the bus.
+#ifdef __GNUC__
+#define LOAD_ACQUIRE(x)       __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(x, v)   __atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+#define MEMORY_BARRIER()      __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#else
+#define LOAD_ACQUIRE(x)       (__dmb(0xF), (x))
+#define STORE_RELEASE(x, v)   do { __dmb(0xF); (x) = (v); } while (0)
+#define MEMORY_BARRIER()      __dmb(0xF)
+#endif
 
  // ************** TCB **************
 struct tcb{
   int32_t *sp;        // pointer to stack (valid for threads not running
   int32_t sleep;	  // nonzero if this thread is sleeping
-  int32_t *blockd;	  // nonzero if blocked on this semaphore
+  sema_t *blockd;	  // nonzero if blocked on this semaphore
+  struct tcb *nextBlocked;  // queue of the semaphore it is blocked on
   struct tcb *next;   // linked-list pointer
+  uint32_t sleepDelta;    // ticks after the previous one in the sleep queue
+  struct tcb *nextSleep;  // sleep queue pointer
+  flags_t *waitFlags;     // flag group it is blocked on, NULL if none
+  uint32_t flagsMask;     // flags it waits for
+  uint32_t flagsMode;     // FLAGS_ANY or FLAGS_ALL, plus FLAGS_CLEAR
+  uint32_t flagsGot;      // flags it woke up with, 0 on timeout
+  int32_t *stack;         // lowest word of the stack, from StackPool
+  uint32_t stackWords;    // size of the stack
 };
 
 typedef struct tcb tcbType;
-tcbType tcbs[NUMTHREADS];
+tcbType tcbs[NUMTHREADS+1];      // the six main threads and Idle
 tcbType *RunPt;
-int32_t Stacks[NUMTHREADS][STACKSIZE];
+const uint32_t StackWords[NUMTHREADS+1] = { STACK_WORDS };
+#ifdef __GNUC__
+__attribute__((aligned(8))) int32_t StackPool[STACKPOOL];  // even sized stacks keep 8 byte aligned tops
+#else
+__align(8) int32_t StackPool[STACKPOOL];  // even sized stacks keep 8 byte aligned tops
+#endif
+uint64_t IdleCycles;  // bus cycles Idle ran, for OS_IdleCycles
+uint32_t IdleStamp;   // cycle count Idle last started running at
+tcbType *SleepList;   // sleep queue, head wakes up first
+uint64_t TickCount;   // ms since OS_Init, counted by RunPeriodicEvents
+uint32_t TickStep = 1;  // ticks per RunPeriodicEvents interrupt
+uint32_t TickCycles;    // cycles per tick
+uint32_t TickDue;       // cycle count the last RunPeriodicEvents was due at
+int32_t TickLag;        // cycles the tick timer lost to restarts
+tcbType *IdlePt;        // thread in OS_Idle with the ticks stopped, or NULL
 
 // ************* Event task *************
+// TaskCounter counts down to the next run, TaskPhase is the tick
+// of the first run modulo TaskPeriod. MinDelay and MaxDelay are in
+// bus cycles from the start of the tick to the start of a run.
 typedef struct eventTask {
 	void(*PeriodicEventTask)(void);
 	uint32_t TaskPeriod;
 	uint32_t TaskCounter;
+	uint32_t TaskPhase;
+	uint32_t Runs;
+	uint32_t MinDelay;
+	uint32_t MaxDelay;
 }eventTask_t, *eventTaskPt;
 
 eventTask_t event_tasks[NUMPERIODIC];
+uint32_t NumEvents;     // event threads added so far
+#if TICKLESS
+int static AloneReady(tcbType *pt);
+uint32_t static TickLagged(void);
+void static TickStretch(void);
+void static TickCatchUp(void);
+void static TickResume(void);
+#endif
 
 // ******* threads values enumerator *******
 enum threads {
@@ -61,40 +165,74 @@ void OS_Init(void){
   DisableInterrupts();
   BSP_Clock_InitFastest();   // set processor clock to fastest speed
   uint8_t i;
-  for ( i = 0; i < NUMTHREADS; i++ ) {
-	  tcbs[i].blockd = 0;
+  for ( i = 0; i <= IDLE; i++ ) {
+	  tcbs[i].blockd = NULL;
+	  tcbs[i].nextBlocked = NULL;
 	  tcbs[i].next = NULL;
 	  tcbs[i].sp = NULL;
 	  tcbs[i].sleep = 0;
+	  tcbs[i].sleepDelta = 0;
+	  tcbs[i].nextSleep = NULL;
+	  tcbs[i].waitFlags = NULL;
   }
+  SleepList = NULL;
+  TickCount = 0;
+  IdleCycles = 0;
 
   for ( i = 0; i < NUMPERIODIC; i++ ) {
 	  event_tasks[i].PeriodicEventTask = NULL;
 	  event_tasks[i].TaskPeriod = 0;
 	  event_tasks[i].TaskCounter = 0;
   }
+  NumEvents = 0;
+#ifndef HOST_PORT
+  DEMCR |= 0x01000000;       // enable the DWT
+  DWT_CYCCNT = 0;
+  DWT_CTRL |= 0x00000001;    // start the cycle counter
+  CPACR |= 0x00F00000;       // FPU on, saved by the switch, see osasm.s
+#endif
   RunPt = NULL;
+  TickStep = 1;              // a tick can come before OS_Launch, see TickLagged
+  TickLag = 0;
+  TickCycles = BSP_Clock_GetFreq()/TIMER_FREQ;
+  TickDue = CYCLE_COUNT();
   BSP_PeriodicTask_Init(&RunPeriodicEvents, TIMER_FREQ, TIMER_PRIORITY);
 }
 
 // ********* Initialize stack *********
-void SetInitialStack(int i){
-	tcbs[i].sp = &Stacks[i][STACKSIZE - 16];
-	Stacks[i][STACKSIZE - 1] = 0x010000000;     // enable thumb bit	in PSR
-	Stacks[i][STACKSIZE - 3] = 0x14141414;      // R14
-	Stacks[i][STACKSIZE - 4] = 0x12121212;      // R12
-	Stacks[i][STACKSIZE - 5] = 0x03030303;      // R3
-	Stacks[i][STACKSIZE - 6] = 0x02020202;      // R2
-	Stacks[i][STACKSIZE - 7] = 0x01010101;      // R1
-	Stacks[i][STACKSIZE - 8] = 0x00000000;      // R0
-	Stacks[i][STACKSIZE - 9] = 0x11111111;      // R11
-	Stacks[i][STACKSIZE - 10] = 0x10101010;     // R10
-	Stacks[i][STACKSIZE - 11] = 0x09090909;     // R9
-	Stacks[i][STACKSIZE - 12] = 0x08080808;     // R8
-	Stacks[i][STACKSIZE - 13] = 0x07070707;     // R7
-	Stacks[i][STACKSIZE - 14] = 0x06060606;     // R6
-	Stacks[i][STACKSIZE - 15] = 0x05050505;     // R5
-	Stacks[i][STACKSIZE - 16] = 0x04040404;     // R4
+// Build the initial stack frame of thread i at the top of its stack,
+// PC is the thread entry. The rest of the stack is painted with
+// STACK_PAINT for OS_StackHighWater, the lowest word is STACK_GUARD.
+// On the host the TCB sp is a host context instead, see host/osasm.c
+void SetInitialStack(int i, void(*thread)(void)){
+	uint32_t j;
+	tcbs[i].stack[0] = (int32_t)STACK_GUARD;
+	for ( j = 1; j < tcbs[i].stackWords; j++ )
+		tcbs[i].stack[j] = (int32_t)STACK_PAINT;
+#ifdef HOST_PORT
+	tcbs[i].sp = Host_InitialStack(thread);
+#else
+	int32_t *top = &tcbs[i].stack[tcbs[i].stackWords];
+	tcbs[i].sp = top - 18;
+	top[-1] = THUMB_BIT;       // enable thumb bit	in PSR
+	top[-2] = (int32_t)(thread);  // PC
+	top[-3] = 0x14141414;      // R14
+	top[-4] = 0x12121212;      // R12
+	top[-5] = 0x03030303;      // R3
+	top[-6] = 0x02020202;      // R2
+	top[-7] = 0x01010101;      // R1
+	top[-8] = 0x00000000;      // R0
+	top[-9] = 0x11111111;      // R11
+	top[-10] = 0x10101010;     // R10
+	top[-11] = 0x09090909;     // R9
+	top[-12] = 0x08080808;     // R8
+	top[-13] = 0x07070707;     // R7
+	top[-14] = 0x06060606;     // R6
+	top[-15] = 0x05050505;     // R5
+	top[-16] = 0x04040404;     // R4
+	top[-17] = 0xFFFFFFF9;     // EXC_RETURN, thread mode on MSP, FPU unused
+	top[-18] = 0x00000000;     // padding to 8 bytes
+#endif
 }
 
 //********** OS_AddThreads ***************
@@ -102,12 +240,18 @@ void SetInitialStack(int i){
 // Inputs: function pointers to six void/void main threads
 // Outputs: 1 if successful, 0 if this thread can not be added
 // This function will only be called once, after OS_Init and before OS_Launch
+// The stacks are carved out of StackPool with the sizes in STACK_WORDS,
+// rounded up to an even number, it fails if one is below STACKMIN or
+// they do not all fit
 int OS_AddThreads(void(*thread0)(void),
                   void(*thread1)(void),
                   void(*thread2)(void),
                   void(*thread3)(void),
                   void(*thread4)(void),
                   void(*thread5)(void)){
+	void(*entry[NUMTHREADS+1])(void) = { thread0, thread1, thread2, thread3, thread4, thread5,
+	                                     &Idle };  // Idle is outside the list, see Scheduler
+	uint32_t words, used = 0;
 	uint16_t cr = StartCritical();
 	int8_t THREAD;
 	tcbs[THREAD0].next = &tcbs[THREAD1];	 // Circular linked list
@@ -117,16 +261,17 @@ int OS_AddThreads(void(*thread0)(void),
 	tcbs[THREAD4].next = &tcbs[THREAD5];
 	tcbs[THREAD5].next = &tcbs[THREAD0];
 
-	for ( THREAD = 0; THREAD < NUMTHREADS; THREAD++ )	 // Initialize stacks of threads.
-		SetInitialStack(THREAD);
-
-	// assign to stack pointer of each thread, pointer to that thread. 
-	Stacks[THREAD0][STACKSIZE - 2] = (uint32_t)(thread0);  
-	Stacks[THREAD1][STACKSIZE - 2] = (uint32_t)(thread1);
-	Stacks[THREAD2][STACKSIZE - 2] = (uint32_t)(thread2);
-	Stacks[THREAD3][STACKSIZE - 2] = (uint32_t)(thread3);
-	Stacks[THREAD4][STACKSIZE - 2] = (uint32_t)(thread4);
-	Stacks[THREAD5][STACKSIZE - 2] = (uint32_t)(thread5);
+	for ( THREAD = 0; THREAD <= IDLE; THREAD++ ) {	 // Initialize stacks of threads.
+		words = (StackWords[THREAD] + 1) & ~1u;   // 8 byte aligned tops
+		if ( (words < STACKMIN) || (used + words > STACKPOOL) ) {
+			EndCritical(cr);
+			return 0;
+		}
+		tcbs[THREAD].stack = &StackPool[used];
+		tcbs[THREAD].stackWords = words;
+		used += words;
+		SetInitialStack(THREAD, entry[THREAD]);
+	}
 	RunPt = &tcbs[THREAD0];
 	EndCritical(cr);
   return 1;               // successful
@@ -142,38 +287,190 @@ int OS_AddThreads(void(*thread0)(void),
 // It is assumed the time to run these event threads is short compared to 1 msec
 // These threads cannot spin, block, loop, sleep, or kill
 // These threads can call OS_Signal
-// In Lab 3 this will be called exactly twice
+// Up to NUMPERIODIC threads, the phase is chosen so each one shares
+// as few ticks as possible with the ones added before it
 int OS_AddPeriodicEventThread(void(*thread)(void), uint32_t period){
-	static uint8_t itr = 0;
-	if ( itr < NUMPERIODIC ) {
-		if ( event_tasks[itr].PeriodicEventTask == NULL ) {
-			event_tasks[itr].PeriodicEventTask = thread;
-			event_tasks[itr].TaskPeriod = period;
-			itr++;
-		}
-		return 1;
+	eventTask_t *ev;
+	if ( (NumEvents >= NUMPERIODIC) || (period == 0) || (thread == NULL) )
+		return 0;
+	ev = &event_tasks[NumEvents];
+	ev->PeriodicEventTask = thread;
+	ev->TaskPeriod = period;
+	ev->TaskPhase = EventPhase(period);
+	ev->TaskCounter = ev->TaskPhase + period;   // first run one period in
+	ev->Runs = 0;
+	ev->MinDelay = 0xFFFFFFFF;
+	ev->MaxDelay = 0;
+	NumEvents++;
+	return 1;
+}
+
+//******** OS_PeriodicEventStats ***************
+// Timing of a periodic event thread
+// Inputs:  event 0 to NUMPERIODIC-1 in the order they were added
+//          where to store the phase, in ticks
+//          where to store the number of runs
+//          where to store the longest delay, in bus cycles from the
+//          start of the tick to the start of a run
+//          where to store the jitter, longest minus shortest delay
+// Outputs: 1 if successful, 0 if there is no such event thread
+int OS_PeriodicEventStats(uint32_t event, uint32_t *phase, uint32_t *runs,
+                          uint32_t *delay, uint32_t *jitter){
+	eventTask_t *ev;
+	if ( event >= NumEvents )
+		return 0;
+	ev = &event_tasks[event];
+	*phase = ev->TaskPhase;
+	*runs = ev->Runs;
+	*delay = ev->MaxDelay;
+	*jitter = (ev->Runs > 0) ? (ev->MaxDelay - ev->MinDelay) : 0;
+	return 1;
+}
+
+// *********** Sleep queue *************
+// Sleeping threads ordered by wake up time, the sleepDelta of each one
+// counts from the wake up of the thread before it, so a tick only
+// counts down the head. Called with interrupts disabled.
+void static SleepInsert(tcbType *pt, uint32_t sleepTime){
+	tcbType **link = &SleepList;
+	while ( (*link != NULL) && ((*link)->sleepDelta <= sleepTime) ) {
+		sleepTime -= (*link)->sleepDelta;
+		link = &(*link)->nextSleep;
 	}
-	else
+	pt->sleepDelta = sleepTime;
+	pt->nextSleep = *link;
+	if ( *link != NULL )
+		(*link)->sleepDelta -= sleepTime;
+	*link = pt;
+}
+
+// take thread pt out of the sleep queue before it is due, the thread
+// after it gets its sleepDelta
+void static SleepRemove(tcbType *pt){
+	tcbType **link = &SleepList;
+	while ( *link != pt )
+		link = &(*link)->nextSleep;
+	*link = pt->nextSleep;
+	if ( pt->nextSleep != NULL )
+		pt->nextSleep->sleepDelta += pt->sleepDelta;
+	pt->sleep = 0;
+}
+
+// unlink thread pt from the queue of semaphore semaPt
+void static QueueRemove(sema_t *semaPt, tcbType *pt){
+	tcbType **link = &semaPt->Head;
+	tcbType *prev = NULL;
+	while ( *link != pt ) {
+		prev = *link;
+		link = &(*link)->nextBlocked;
+	}
+	*link = pt->nextBlocked;
+	if ( semaPt->Tail == pt )
+		semaPt->Tail = prev;
+}
+
+// *********** Event phase *************
+// Two event threads with periods p1, p2 and phases f1, f2 meet in
+// some tick of the hyperperiod exactly when f1 and f2 are equal
+// modulo gcd(p1, p2). Take the phase that meets the fewest event
+// threads added before, the lowest one on a tie.
+uint32_t static Gcd(uint32_t a, uint32_t b){
+	uint32_t r;
+	while ( b != 0 ) {
+		r = a % b;
+		a = b;
+		b = r;
+	}
+	return a;
+}
+
+uint32_t static EventPhase(uint32_t period){
+	uint32_t phase, best = 0, bestMeets = NUMPERIODIC + 1;
+	uint32_t meets, g, i;
+	if ( EVENT_STAGGER == 0 )
 		return 0;
+	for ( phase = 0; (phase < period) && (bestMeets > 0); phase++ ) {
+		meets = 0;
+		for ( i = 0; i < NumEvents; i++ ) {
+			g = Gcd(period, event_tasks[i].TaskPeriod);
+			if ( (phase % g) == (event_tasks[i].TaskPhase % g) )
+				meets++;
+		}
+		if ( meets < bestMeets ) {
+			bestMeets = meets;
+			best = phase;
+		}
+	}
+	return best;
 }
 
 // *********** Run periodic events *************
-// Decrement sleep counter and run periodic threads.
+// Count down the sleep queue and run periodic threads.
+// Each event thread counts down its own ticks, the delay of every
+// run from the start of the tick is kept for OS_PeriodicEventStats.
+// A tickless step counts TickStep ticks at once.
 void static RunPeriodicEvents(void){
+	uint32_t start, delay;
+	eventTask_t *ev;
 	uint8_t i;
-	for ( i = 0; i < NUMTHREADS; i++ ) {	// Decrement sleep counter of main threads
-		if ( tcbs[i].sleep )
-			tcbs[i].sleep--;
-	}
-	for ( i = 0; i < NUMPERIODIC; i++ ) {	// Run periodic event threads
-		if ( event_tasks[i].PeriodicEventTask != NULL ) {
-			event_tasks[i].TaskCounter = event_tasks[i].TaskCounter + 1;
-			if ( event_tasks[i].TaskCounter >= event_tasks[i].TaskPeriod ) {
-				(*(event_tasks[i].PeriodicEventTask))();
-				event_tasks[i].TaskCounter = 0;
+	tcbType *pt;
+	uint16_t cr;
+	uint32_t ticks = TickStep, left;
+	start = CYCLE_COUNT();
+	cr = StartCritical();
+#if TICKLESS
+	TickDue += TickStep*TickCycles;
+	ticks += TickLagged();
+#endif
+	TickCount += ticks;
+	left = ticks;
+	if ( SleepList != NULL ) {	// Only the head of the sleep queue counts down
+		while ( (SleepList != NULL) && (SleepList->sleepDelta <= left) ) {
+			pt = SleepList;         // Wake up
+			left -= pt->sleepDelta;
+			SleepList = pt->nextSleep;
+			pt->sleep = 0;
+			if ( pt->waitFlags != NULL ) {  // OS_WaitFlags timed out
+				QueueRemove(&pt->waitFlags->Wait, pt);
+				pt->waitFlags = NULL;
+				pt->blockd = NULL;
+				pt->flagsGot = 0;
 			}
 		}
+		if ( SleepList != NULL )
+			SleepList->sleepDelta -= left;
+	}
+	EndCritical(cr);
+	for ( i = 0; i < NumEvents; i++ ) {	// Run periodic event threads
+		ev = &event_tasks[i];
+		if ( ev->TaskCounter > ticks ) {
+			ev->TaskCounter -= ticks;
+		}
+		else {
+			ev->TaskCounter += ev->TaskPeriod - ticks;
+			while ( (int32_t)ev->TaskCounter <= 0 )
+				ev->TaskCounter += ev->TaskPeriod;  // lagged past a whole period, runs once
+			delay = CYCLE_COUNT() - start;
+			if ( delay < ev->MinDelay )
+				ev->MinDelay = delay;
+			if ( delay > ev->MaxDelay )
+				ev->MaxDelay = delay;
+			ev->Runs++;
+			(*(ev->PeriodicEventTask))();
+		}
 	}
+#if TICKLESS
+	cr = StartCritical();
+	if ( IdlePt != NULL ) {
+		if ( AloneReady(IdlePt) )
+			TickStretch();
+		else {
+			TickResume();               // on a tick, no time to catch up
+			SWITCH_PEND();              // run the threads woken up
+		}
+	}
+	EndCritical(cr);
+#endif
 }
 
 // *********** OS_Launch ***************
@@ -184,19 +481,59 @@ void static RunPeriodicEvents(void){
 void OS_Launch(uint32_t theTimeSlice){
   STCTRL = 0;                  // disable SysTick during setup
   STCURRENT = 0;               // any write to current clears it
-  SYSPRI3 =(SYSPRI3&0x00FFFFFF)|0xE0000000; // priority 7
+  SYSPRI3 =(SYSPRI3&0x0000FFFF)|0xE0E00000; // SysTick and PendSV priority 7
   STRELOAD = theTimeSlice - 1; // reload value
+  TickCycles = BSP_Clock_GetFreq()/TIMER_FREQ;
+  BSP_PeriodicTask_Init(&RunPeriodicEvents, TIMER_FREQ, TIMER_PRIORITY);  // ticks from now
+  TickDue = CYCLE_COUNT();
   STCTRL = 0x00000007;         // enable, core clock and interrupt arm
   StartOS();                   // start on the first task
 }
 
+// ******** StackOverflow ************
+// The guard word at the bottom of the stack of pt was overwritten, the
+// thread (or an ISR that interrupted it) ran past its stack into the
+// one below. Stop with interrupts disabled, StackOverflowPt tells the
+// debugger which thread it was.
+// Inputs:  thread that overflowed
+// Outputs: none, never returns
+tcbType *StackOverflowPt;
+void static StackOverflow(tcbType *pt){
+	StackOverflowPt = pt;
+	DisableInterrupts();
+	for(;;){
+	}
+}
+
 // ************ Scheduler ************
-// runs every ms
+// runs every ms. When every thread sleeps or is blocked it runs Idle,
+// which goes back to the list where it left it.
+// The guard word of the thread that ran is checked first.
 void Scheduler(void){         // every time slice
+	tcbType *first;
+	uint32_t now;
+	if ( RunPt->stack[0] != (int32_t)STACK_GUARD )
+		StackOverflow(RunPt);
 	//RunPeriodicEvents();
-	RunPt = RunPt->next;      // ROUND ROBIN, skip blocked and sleeping threads
-	while ( RunPt->blockd || RunPt->sleep )
+#if TICKLESS
+	if ( (IdlePt != NULL) && !AloneReady(IdlePt) ) {
+		TickCatchUp();              // woken up by an ISR between ticks
+		TickResume();
+	}
+#endif
+	now = CYCLE_COUNT();
+	if ( RunPt == &tcbs[IDLE] )
+		IdleCycles += now - IdleStamp;
+	first = RunPt = RunPt->next;  // ROUND ROBIN, skip blocked and sleeping threads
+	while ( RunPt->blockd || RunPt->sleep ) {
 		RunPt = RunPt->next;
+		if ( RunPt == first ) {   // none can run
+			tcbs[IDLE].next = first;
+			RunPt = &tcbs[IDLE];
+			IdleStamp = now;
+			return;
+		}
+	}
 }
 
 // ************ OS_Suspend ***************
@@ -204,10 +541,16 @@ void Scheduler(void){         // every time slice
 // Inputs: none
 // Outputs: none
 // Will be run again depending on sleep/block status
+// With PENDSV_SWITCH the next thread gets what is left of the time
+// slice, through SysTick it gets a full one.
 void OS_Suspend(void){
+#if !PENDSV_SWITCH
   STCURRENT = 0;        // any write to current clears it
-  INTCTRL = 0x04000000; // trigger SysTick
-// next thread gets a full time slice
+#endif
+  SWITCH_PEND();        // trigger PendSV, or SysTick
+#ifdef HOST_PORT
+  Host_TakePending();   // no NVIC on the host, take the switch now
+#endif
 }
 
 // ******** OS_Sleep ************
@@ -216,18 +559,212 @@ void OS_Suspend(void){
 // output: none
 // OS_Sleep(0) implements cooperative multitasking
 void OS_Sleep(uint32_t sleepTime){
+	DisableInterrupts();
 	RunPt->sleep = sleepTime;  // set sleep parameter in TCB
+	if ( sleepTime )
+		SleepInsert(RunPt, sleepTime);
+	EnableInterrupts();
 	OS_Suspend();              // suspend, stops running
 }
 
+// ******** OS_Ticks ************
+// Time since OS_Init in ms, 64 bits so it does not wrap
+// Inputs:  none
+// Outputs: ticks
+uint64_t OS_Ticks(void){
+	uint64_t ticks;
+	uint16_t cr = StartCritical();  // two words, not read atomically
+	ticks = TickCount;
+	EndCritical(cr);
+	return ticks;
+}
+
+// ******** OS_SleepUntil ************
+// Sleep until period ms after the last wake up, for a main thread
+// that runs every period ms. The wake up times do not depend on
+// how long the thread ran, so the rate does not drift.
+// Start with lastWake = OS_Ticks() before the loop.
+// Inputs:  pointer to the last wake up time, advanced by period
+//          period in ms
+// Outputs: 1 if it slept, 0 if the wake up time had passed already,
+//          then it returns at once and lastWake catches up on the
+//          next calls
+int OS_SleepUntil(uint64_t *lastWake, uint32_t period){
+	*lastWake += period;
+	DisableInterrupts();
+	if ( *lastWake <= TickCount ) {
+		EnableInterrupts();
+		return 0;
+	}
+	RunPt->sleep = (int32_t)(*lastWake - TickCount);
+	SleepInsert(RunPt, RunPt->sleep);
+	EnableInterrupts();
+	OS_Suspend();
+	return 1;
+}
+
+// *********** Tickless idle *************
+// OS_Idle stops SysTick while its caller is the only thread not
+// sleeping or blocked, and RunPeriodicEvents stretches its own period
+// on the next tick: one interrupt every TickStep ticks, the largest
+// divisor of TIMER_FREQ that does not pass the first sleeper or the
+// next event thread run. A thread made ready ends it, on a tick in
+// RunPeriodicEvents, or between ticks in Scheduler after an ISR woke
+// it up. The time lost restarting the timer adds up in TickLag and
+// is counted back as whole ticks.
+#if TICKLESS
+
+// 1 if no main thread but pt is neither sleeping nor blocked
+int static AloneReady(tcbType *pt){
+	uint8_t i;
+	for ( i = 0; i < NUMTHREADS; i++ ) {
+		if ( (&tcbs[i] != pt) && (tcbs[i].blockd == NULL) && (tcbs[i].sleep == 0) )
+			return 0;
+	}
+	return 1;
+}
+
+// whole ticks out of TickLag, OS_Init sets TickCycles before the
+// timer starts, a tick can come while the threads are added
+uint32_t static TickLagged(void){
+	uint32_t ticks;
+	if ( TickLag < (int32_t)TickCycles )
+		return 0;
+	ticks = (uint32_t)TickLag / TickCycles;
+	TickLag -= ticks*TickCycles;
+	return ticks;
+}
+
+// restart the timer at one interrupt every step ticks
+void static TickRestart(uint32_t step){
+	uint32_t now = CYCLE_COUNT();
+	TickLag += (int32_t)(now - TickDue);
+	TickDue = now;
+	TickStep = step;
+	BSP_PeriodicTask_Init(&RunPeriodicEvents, TIMER_FREQ/step, TIMER_PRIORITY);
+}
+
+// program the longest step that wakes up the first sleeper and runs
+// every event thread on time, TIMER_FREQ ticks at most
+void static TickStretch(void){
+	uint32_t step = TIMER_FREQ;
+	uint8_t i;
+	if ( (SleepList != NULL) && (SleepList->sleepDelta < step) )
+		step = SleepList->sleepDelta;
+	for ( i = 0; i < NumEvents; i++ ) {
+		if ( event_tasks[i].TaskCounter < step )
+			step = event_tasks[i].TaskCounter;
+	}
+	while ( TIMER_FREQ % step )
+		step--;
+	if ( step != TickStep )
+		TickRestart(step);
+}
+
+// count the whole ticks of the step gone by, between two interrupts.
+// They are fewer than TickStep so no sleeper or event thread is due.
+void static TickCatchUp(void){
+	int32_t gone = (int32_t)(CYCLE_COUNT() - TickDue);
+	uint32_t ticks;
+	uint8_t i;
+	if ( (TickStep == 1) || (gone < (int32_t)TickCycles) )
+		return;
+	ticks = (uint32_t)gone / TickCycles;
+	if ( ticks >= TickStep )
+		ticks = TickStep - 1;       // its interrupt is on the way
+	TickDue += ticks*TickCycles;
+	TickCount += ticks;
+	if ( SleepList != NULL )
+		SleepList->sleepDelta -= ticks;
+	for ( i = 0; i < NumEvents; i++ )
+		event_tasks[i].TaskCounter -= ticks;
+}
+
+// back to a tick every ms and the time slice
+void static TickResume(void){
+	if ( TickStep > 1 )
+		TickRestart(1);
+	IdlePt = NULL;
+	STCURRENT = 0;
+	STCTRL = 0x00000007;
+	SYSTICK_UPDATE();
+}
+#endif
+
+// ******** OS_Idle ************
+// Wait for an interrupt, called over and over by an idle thread.
+// With TICKLESS, while every other thread sleeps or is blocked, the
+// time slice and the idle ticks stop until the first sleeper or event
+// thread is due or an ISR wakes a thread. OS_Ticks lags by up to one
+// step in the meantime.
+// Inputs:  none
+// Outputs: none
+void OS_Idle(void){
+	DisableInterrupts();
+#if TICKLESS
+	if ( (IdlePt == NULL) && AloneReady(RunPt) ) {
+		IdlePt = RunPt;
+		STCTRL = 0;                 // nobody to share the time slice with
+		SYSTICK_UPDATE();
+	}
+#endif
+	WaitForInterrupt();             // wakes up on an interrupt pending
+	EnableInterrupts();             // it runs here
+}
+
+// ******** Idle ************
+// Kernel thread run by Scheduler when every main thread sleeps or is
+// blocked. It sleeps the core, Scheduler counts the time it ran.
+void static Idle(void){
+	for(;;){
+		OS_Idle();
+	}
+}
+
+// ******** OS_IdleCycles ************
+// Bus cycles the idle thread ran since OS_Init. Over an interval,
+// the CPU use is 1 - (idle cycles)/(bus cycles of the interval).
+// Inputs:  none
+// Outputs: idle cycles, up to the last switch
+uint64_t OS_IdleCycles(void){
+	uint64_t cycles;
+	uint16_t cr = StartCritical();  // two words, not read atomically
+	cycles = IdleCycles;
+	EndCritical(cr);
+	return cycles;
+}
+
+// ******** OS_StackHighWater ************
+// Most stack words a thread has used since OS_AddThreads, the words
+// from the top down to the lowest one no longer STACK_PAINT, ISRs
+// that interrupted it included.
+// Inputs:  thread, 0 to NUMTHREADS-1 in OS_AddThreads order, IDLE
+//          for the idle thread
+// Outputs: words used, the whole stack if the guard word is gone,
+//          0 before OS_AddThreads
+uint32_t OS_StackHighWater(uint32_t thread){
+	int32_t *stack;
+	uint32_t i = 1, words;
+	if ( (thread > IDLE) || (tcbs[thread].stack == NULL) )
+		return 0;
+	stack = tcbs[thread].stack;
+	words = tcbs[thread].stackWords;
+	if ( stack[0] != (int32_t)STACK_GUARD )
+		return words;
+	while ( (i < words) && (stack[i] == (int32_t)STACK_PAINT) )
+		i++;
+	return words - i;
+}
+
 // ******** OS_InitSemaphore ************
 // Initialize counting semaphore
 // Inputs:  pointer to a semaphore
 //          initial value of semaphore
 // Outputs: none
-void OS_InitSemaphore(int32_t *semaPt, int32_t value){
+void OS_InitSemaphore(sema_t *semaPt, int32_t value){
 	uint16_t cr = StartCritical();
-	*semaPt = value;
+	semaPt->Value = value;
+	semaPt->Head = semaPt->Tail = NULL;
 	EndCritical(cr);
 }
 
@@ -237,11 +774,17 @@ void OS_InitSemaphore(int32_t *semaPt, int32_t value){
 // Lab3 block if less than zero
 // Inputs:  pointer to a counting semaphore
 // Outputs: none
-void OS_Wait(int32_t *semaPt){
+void OS_Wait(sema_t *semaPt){
 	DisableInterrupts();
-	(*semaPt)--;
-	if ( (*semaPt) < 0 ) {
-		RunPt->blockd = *semaPt;
+	semaPt->Value--;
+	if ( semaPt->Value < 0 ) {
+		RunPt->blockd = semaPt;
+		RunPt->nextBlocked = NULL;     // join the tail of its queue
+		if ( semaPt->Head == NULL )
+			semaPt->Head = RunPt;
+		else
+			semaPt->Tail->nextBlocked = RunPt;
+		semaPt->Tail = RunPt;
 		EnableInterrupts();
 		OS_Suspend();
 	}
@@ -254,24 +797,137 @@ void OS_Wait(int32_t *semaPt){
 // Lab3 wakeup blocked thread if appropriate
 // Inputs:  pointer to a counting semaphore
 // Outputs: none
-void OS_Signal(int32_t *semaPt){
+void OS_Signal(sema_t *semaPt){
 	tcbType *ptr;
 	DisableInterrupts();
-	(*semaPt)++;
-	if ( (*semaPt) < 0 ) {
-		ptr = RunPt->next;
-		while ( ptr->blockd != *semaPt )
-			ptr = ptr->next;
-		ptr->blockd = 0;            // Wake up thread, not blocked.
+	semaPt->Value++;
+	if ( semaPt->Value <= 0 ) {     // a thread is still blocked on it
+		ptr = semaPt->Head;         // head of its queue
+		semaPt->Head = ptr->nextBlocked;
+		ptr->blockd = NULL;         // Wake up thread, not blocked.
+		if ( (IdlePt != NULL) || (RunPt == &tcbs[IDLE]) )
+			SWITCH_PEND();          // nothing else was running, switch now
 	}
 	EnableInterrupts();
 }
 
-#define FIFOSIZE 10     // can be any size
-uint32_t PutIndex;      // index of where to put next
-uint32_t GetIndex;      // index of where to get next
+// ******** Event flags ************
+// A thread waiting for flags is blocked on the Wait queue of the group,
+// with a timeout it is in the sleep queue as well. Whichever comes
+// first, OS_SetFlags or RunPeriodicEvents, takes it out of the other.
+
+// 1 if the flags got satisfy a wait for mask in mode
+int static FlagsMet(uint32_t got, uint32_t mask, uint32_t mode){
+	if ( mode & FLAGS_ALL )
+		return got == mask;
+	return got != 0;
+}
+
+// ******** OS_InitFlags ************
+// Initialize an event flag group
+// Inputs:  pointer to a flag group
+//          flags set to start with
+// Outputs: none
+void OS_InitFlags(flags_t *flagsPt, uint32_t bits){
+	uint16_t cr = StartCritical();
+	flagsPt->Bits = bits;
+	flagsPt->Wait.Value = 0;
+	flagsPt->Wait.Head = flagsPt->Wait.Tail = NULL;
+	EndCritical(cr);
+}
+
+// ******** OS_WaitFlags ************
+// Wait until any (FLAGS_ANY) or all (FLAGS_ALL) of the flags in mask
+// are set, or until timeout ms went by. With FLAGS_CLEAR, or-ed into
+// the mode, the flags it waited for are cleared as it wakes up.
+// Inputs:  pointer to a flag group
+//          flags to wait for, not 0
+//          FLAGS_ANY or FLAGS_ALL, plus FLAGS_CLEAR
+//          timeout in ms, 0 waits forever
+// Outputs: the flags of mask that were set, 0 on timeout
+// Called by main threads only
+uint32_t OS_WaitFlags(flags_t *flagsPt, uint32_t mask, uint32_t mode, uint32_t timeout){
+	uint32_t got;
+	DisableInterrupts();
+	got = flagsPt->Bits & mask;
+	if ( FlagsMet(got, mask, mode) ) {
+		if ( mode & FLAGS_CLEAR )
+			flagsPt->Bits &= ~got;
+		EnableInterrupts();
+		return got;
+	}
+	RunPt->waitFlags = flagsPt;
+	RunPt->flagsMask = mask;
+	RunPt->flagsMode = mode;
+	RunPt->blockd = &flagsPt->Wait;
+	RunPt->nextBlocked = NULL;      // join the tail of its queue
+	if ( flagsPt->Wait.Head == NULL )
+		flagsPt->Wait.Head = RunPt;
+	else
+		flagsPt->Wait.Tail->nextBlocked = RunPt;
+	flagsPt->Wait.Tail = RunPt;
+	if ( timeout ) {
+		RunPt->sleep = timeout;
+		SleepInsert(RunPt, timeout);
+	}
+	EnableInterrupts();
+	OS_Suspend();               // flagsGot is set when it runs again
+	return RunPt->flagsGot;
+}
+
+// ******** OS_SetFlags ************
+// Set flags and wake up the threads waiting for them
+// Inputs:  pointer to a flag group
+//          flags to set
+// Outputs: none
+// Can be called by main threads, event threads and ISRs
+void OS_SetFlags(flags_t *flagsPt, uint32_t bits){
+	tcbType *pt, *next;
+	uint32_t got;
+	uint16_t cr = StartCritical();
+	flagsPt->Bits |= bits;
+	for ( pt = flagsPt->Wait.Head; pt != NULL; pt = next ) {
+		next = pt->nextBlocked;
+		got = flagsPt->Bits & pt->flagsMask;
+		if ( !FlagsMet(got, pt->flagsMask, pt->flagsMode) )
+			continue;
+		if ( pt->flagsMode & FLAGS_CLEAR )
+			flagsPt->Bits &= ~got;
+		QueueRemove(&flagsPt->Wait, pt);
+		if ( pt->sleep )
+			SleepRemove(pt);        // woke up before the timeout
+		pt->flagsGot = got;
+		pt->waitFlags = NULL;
+		pt->blockd = NULL;          // runs on its next turn
+		if ( (IdlePt != NULL) || (RunPt == &tcbs[IDLE]) )
+			SWITCH_PEND();          // nothing else was running, switch now
+	}
+	EndCritical(cr);
+}
+
+// ******** OS_ClearFlags ************
+// Clear flags
+// Inputs:  pointer to a flag group
+//          flags to clear
+// Outputs: the flags set before
+// Can be called by main threads, event threads and ISRs
+uint32_t OS_ClearFlags(flags_t *flagsPt, uint32_t bits){
+	uint32_t was;
+	uint16_t cr = StartCritical();
+	was = flagsPt->Bits;
+	flagsPt->Bits = was & ~bits;
+	EndCritical(cr);
+	return was;
+}
+
+#define FIFOSIZE 16     // power of two
+#if (FIFOSIZE & (FIFOSIZE - 1)) != 0
+#error "FIFOSIZE must be a power of two"
+#endif
+uint32_t PutIndex;      // entries put since OS_FIFO_Init, written by Put
+uint32_t GetIndex;      // entries got since OS_FIFO_Init, written by Get
 uint32_t FIFO[FIFOSIZE];
-int32_t CurrentSize;    // 0 means FIFO empty, FSIZE means full
+sema_t DataReady;       // -1 while the consumer is blocked on an empty FIFO
 uint32_t LostData;      // number of lost pieces of data
 
 enum FIFO_status {
@@ -288,7 +944,7 @@ enum FIFO_status {
 // Outputs: none
 void OS_FIFO_Init(void){
 	PutIndex = GetIndex = EMPTY;
-	OS_InitSemaphore(&CurrentSize, EMPTY);
+	OS_InitSemaphore(&DataReady, 0);
 	LostData = NONE;
 }
 
@@ -299,15 +955,16 @@ void OS_FIFO_Init(void){
 // Inputs:  data to be stored
 // Outputs: 0 if successful, -1 if the FIFO is full
 int OS_FIFO_Put(uint32_t data){
-	if ( CurrentSize == FIFOSIZE ) {
+	uint32_t put = PutIndex;
+	if ( put - LOAD_ACQUIRE(GetIndex) == FIFOSIZE ) {
 		LostData++;
 		return -1;
 	}
-	else {
-		FIFO[PutIndex] = data;
-		PutIndex = (PutIndex + 1) % FIFOSIZE;  // Wrap around FIFO size.
-		OS_Signal(&CurrentSize);
-	}
+	FIFO[put & (FIFOSIZE - 1)] = data;
+	STORE_RELEASE(PutIndex, put + 1);    // the entry is visible from here
+	MEMORY_BARRIER();                    // PutIndex before DataReady
+	if ( DataReady.Value < 0 )           // the consumer blocked on empty
+		OS_Signal(&DataReady);
 	return 0;
 }
 
@@ -319,10 +976,16 @@ int OS_FIFO_Put(uint32_t data){
 // Outputs: data retrieved
 uint32_t OS_FIFO_Get(void){
 	uint32_t data;
-	OS_Wait(&CurrentSize);     // Block if empty
-	data = FIFO[GetIndex];	   // Return data
-	GetIndex = (GetIndex + 1) % FIFOSIZE;	 // Wrap around FIFO size.
-  return data;
+	uint32_t get = GetIndex;
+	while ( LOAD_ACQUIRE(PutIndex) == get ) {   // empty
+		DisableInterrupts();
+		if ( PutIndex == get )
+			OS_Wait(&DataReady);    // a put in between would be missed
+		EnableInterrupts();
+	}
+	data = FIFO[get & (FIFOSIZE - 1)];
+	STORE_RELEASE(GetIndex, get + 1);    // the slot is free from here
+	return data;
 }
 
 
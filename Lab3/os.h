@@ -28,6 +28,28 @@
 #ifndef __OS_H
 #define __OS_H  1
 
+// ******** Semaphore ************
+// Counting semaphore that owns the FIFO queue of the threads blocked
+// on it, a negative Value is minus the number of threads in the queue.
+struct tcb;
+typedef struct sema{
+  int32_t Value;       // semaphore count
+  struct tcb *Head;    // next thread to wake up, NULL if none blocked
+  struct tcb *Tail;    // last thread to wake up
+} sema_t;
+
+// ******** Event flags ************
+// 32 flag bits, set by main threads, event threads or ISRs. Threads
+// wait for any or all of a mask in a FIFO queue. FLAGS_CLEAR clears
+// the bits a thread waited for as it wakes up, so it consumes them.
+#define FLAGS_ANY       0
+#define FLAGS_ALL       1
+#define FLAGS_CLEAR     2
+typedef struct flags{
+  uint32_t Bits;       // flags set
+  sema_t Wait;         // threads blocked on it, only Head and Tail used
+} flags_t;
+
 
 // ******** OS_Init ************
 // Initialize operating system, disable interrupts
@@ -42,6 +64,7 @@ void OS_Init(void);
 // Inputs: function pointers to six void/void main threads
 // Outputs: 1 if successful, 0 if this thread can not be added
 // This function will only be called once, after OS_Init and before OS_Launch
+// Each stack has its own size, STACK_WORDS in os.c
 int OS_AddThreads(void(*thread0)(void),
                   void(*thread1)(void),
                   void(*thread2)(void),
@@ -59,9 +82,22 @@ int OS_AddThreads(void(*thread0)(void),
 // It is assumed the time to run these event threads is short compared to 1 msec
 // These threads cannot spin, block, loop, sleep, or kill
 // These threads can call OS_Signal
-// In Lab 3 this will be called exactly twice
+// Up to NUMPERIODIC threads, the phase is chosen so each one shares
+// as few ticks as possible with the ones added before it
 int OS_AddPeriodicEventThread(void(*thread)(void), uint32_t period);
 
+//******** OS_PeriodicEventStats ***************
+// Timing of a periodic event thread
+// Inputs:  event 0 to NUMPERIODIC-1 in the order they were added
+//          where to store the phase, in ticks
+//          where to store the number of runs
+//          where to store the longest delay, in bus cycles from the
+//          start of the tick to the start of a run
+//          where to store the jitter, longest minus shortest delay
+// Outputs: 1 if successful, 0 if there is no such event thread
+int OS_PeriodicEventStats(uint32_t event, uint32_t *phase, uint32_t *runs,
+                          uint32_t *delay, uint32_t *jitter);
+
 //******** OS_Launch ***************
 // Start the scheduler, enable interrupts
 // Inputs: number of clock cycles for each time slice
@@ -83,12 +119,55 @@ void OS_Suspend(void);
 // OS_Sleep(0) implements cooperative multitasking
 void OS_Sleep(uint32_t sleepTime);
 
+// ******** OS_Ticks ************
+// Time since OS_Init in ms, 64 bits so it does not wrap
+// Inputs:  none
+// Outputs: ticks
+uint64_t OS_Ticks(void);
+
+// ******** OS_SleepUntil ************
+// Sleep until period ms after the last wake up, for a main thread
+// that runs every period ms. The wake up times do not depend on
+// how long the thread ran, so the rate does not drift.
+// Start with lastWake = OS_Ticks() before the loop.
+// Inputs:  pointer to the last wake up time, advanced by period
+//          period in ms
+// Outputs: 1 if it slept, 0 if the wake up time had passed already,
+//          then it returns at once and lastWake catches up on the
+//          next calls
+int OS_SleepUntil(uint64_t *lastWake, uint32_t period);
+
+// ******** OS_Idle ************
+// Wait for an interrupt, for an idle thread to call over and over.
+// While all other threads sleep or are blocked the ticks stop until
+// the first sleeper or event thread is due, or an ISR wakes a thread.
+// Inputs:  none
+// Outputs: none
+void OS_Idle(void);
+
+// ******** OS_IdleCycles ************
+// Bus cycles the kernel idle thread ran since OS_Init, it runs when
+// every main thread sleeps or is blocked. Over an interval, the CPU
+// use is 1 - (idle cycles)/(bus cycles of the interval).
+// Inputs:  none
+// Outputs: idle cycles, up to the last switch
+uint64_t OS_IdleCycles(void);
+
+// ******** OS_StackHighWater ************
+// Most stack words a thread has used, ISRs that interrupted it
+// included, to size its entry in STACK_WORDS. The lowest word of every
+// stack is a guard checked on every switch, an overwritten guard stops
+// the system (StackOverflowPt in os.c).
+// Inputs:  thread, 0 to 5 in OS_AddThreads order, 6 for the idle thread
+// Outputs: words used, 0 before OS_AddThreads
+uint32_t OS_StackHighWater(uint32_t thread);
+
 // ******** OS_InitSemaphore ************
 // Initialize counting semaphore
 // Inputs:  pointer to a semaphore
 //          initial value of semaphore
 // Outputs: none
-void OS_InitSemaphore(int32_t *semaPt, int32_t value);
+void OS_InitSemaphore(sema_t *semaPt, int32_t value);
 
 // ******** OS_Wait ************
 // Decrement semaphore and block if less than zero
@@ -96,7 +175,7 @@ void OS_InitSemaphore(int32_t *semaPt, int32_t value);
 // Lab3 block if less than zero
 // Inputs:  pointer to a counting semaphore
 // Outputs: none
-void OS_Wait(int32_t *semaPt);
+void OS_Wait(sema_t *semaPt);
 
 // ******** OS_Signal ************
 // Increment semaphore
@@ -104,7 +183,42 @@ void OS_Wait(int32_t *semaPt);
 // Lab3 wakeup blocked thread if appropriate
 // Inputs:  pointer to a counting semaphore
 // Outputs: none
-void OS_Signal(int32_t *semaPt);
+void OS_Signal(sema_t *semaPt);
+
+// ******** OS_InitFlags ************
+// Initialize an event flag group
+// Inputs:  pointer to a flag group
+//          flags set to start with
+// Outputs: none
+void OS_InitFlags(flags_t *flagsPt, uint32_t bits);
+
+// ******** OS_WaitFlags ************
+// Wait until any (FLAGS_ANY) or all (FLAGS_ALL) of the flags in mask
+// are set, or until timeout ms went by. With FLAGS_CLEAR, or-ed into
+// the mode, the flags it waited for are cleared as it wakes up.
+// Inputs:  pointer to a flag group
+//          flags to wait for, not 0
+//          FLAGS_ANY or FLAGS_ALL, plus FLAGS_CLEAR
+//          timeout in ms, 0 waits forever
+// Outputs: the flags of mask that were set, 0 on timeout
+// Called by main threads only
+uint32_t OS_WaitFlags(flags_t *flagsPt, uint32_t mask, uint32_t mode, uint32_t timeout);
+
+// ******** OS_SetFlags ************
+// Set flags and wake up the threads waiting for them
+// Inputs:  pointer to a flag group
+//          flags to set
+// Outputs: none
+// Can be called by main threads, event threads and ISRs
+void OS_SetFlags(flags_t *flagsPt, uint32_t bits);
+
+// ******** OS_ClearFlags ************
+// Clear flags
+// Inputs:  pointer to a flag group
+//          flags to clear
+// Outputs: the flags set before
+// Can be called by main threads, event threads and ISRs
+uint32_t OS_ClearFlags(flags_t *flagsPt, uint32_t bits);
 
 // ******** OS_FIFO_Init ************
 // Initialize FIFO. 
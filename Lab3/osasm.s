@@ -15,23 +15,39 @@
         EXTERN  RunPt            ; currently running thread
         EXPORT  StartOS
         EXPORT  SysTick_Handler
+        EXPORT  PendSV_Handler
         IMPORT  Scheduler
 
 
+; PendSV_Handler runs the same switch, pended by OS_Suspend and by the
+; ISRs that wake a thread up. SysTick and PendSV both have priority 7,
+; neither one interrupts the other.
+; EXC_RETURN is saved with R4-R11. Its bit 4 is clear for a thread that
+; used the FPU, only such a thread has S16-S31 saved and restored.
+PendSV_Handler
 SysTick_Handler                ; 1) Saves R0-R3,R12,LR,PC,PSR
     CPSID   I                  ; 2) Prevent interrupt during switch
+    IF {TARGET_FPU_VFP}
+    TST     LR, #0x10          ;    EXC_RETURN bit 4 clear, FPU thread:
+    IT      EQ                 ;    S0-S15,FPSCR stacked by the core,
+    VPUSHEQ {S16-S31}          ;    save the rest
+    ENDIF
     PUSH    {R4-R11}		   ; 3) Save the remaining registers
+	PUSH    {R0, LR}           ;     and EXC_RETURN, R0 keeps 8 byte alignment
 	LDR     R0, =RunPt         ; 4) R0 points to the current thread
 	LDR     R1, [R0]           ;     R1 -> RunPt
 	STR     SP, [R1]           ; 5) Save stack pointer into TCB
-	 	;LDR     R1, [R1, #4]	   ; R1 = RunPt->next
-	    ;STR     R1, [R0]           ; RunPt = R1
-	PUSH    {R0, LR}           ;     
 	BL      Scheduler          ;     Call outside c function (Scheduler)
-	POP     {R0, LR}
+	LDR     R0, =RunPt
 	LDR     R1, [R0]           ; 6) R1 = RunPt new thread
 	LDR     SP, [R1]           ; 7) SP -> new thread to launch, SP = RunPt->sp
+	POP     {R0, LR}           ;     EXC_RETURN of the new thread
 	POP     {R4-R11}           ; 8) Pull out the 8 registers from the stack
+    IF {TARGET_FPU_VFP}
+    TST     LR, #0x10
+    IT      EQ
+    VPOPEQ  {S16-S31}
+    ENDIF
     CPSIE   I                  ; 9) tasks run with interrupts enabled
     BX      LR                 ; 10) restore R0-R3,R12,LR,PC,PSR
 
@@ -39,6 +55,7 @@ StartOS
     LDR     R0, =RunPt         ; LOAD R0 WITH THE CURRENT RUNNUNG THREAD pointer
 	LDR     R2, [R0]
 	LDR     SP, [R2]           ; NOW THE ACTUAL SP POINTS TO THREAD
+	ADD     SP, SP, #8         ; DISCARD PADDING AND EXC_RETURN, NO FPU STATE YET
 	POP     {R4-R11}
 	POP     {R0-R3}
 	POP     {R12}
@@ -57,9 +57,9 @@ uint32_t SoundRMS;          // Root Mean Square average of most recent sound sam
 uint32_t LightData;         // 100 lux
 int32_t TemperatureData;    // 0.1C
 // semaphores
-int32_t NewData;  // true when new numbers to display on top of LCD
-int32_t LCDmutex; // exclusive access to LCD
-int32_t I2Cmutex; // exclusive access to I2C
+sema_t NewData;  // true when new numbers to display on top of LCD
+mutex_t LCDmutex; // exclusive access to LCD
+mutex_t I2Cmutex; // exclusive access to I2C
 int ReDrawAxes = 0;         // non-zero means redraw axes on next display task
 
 enum plotstate{
@@ -85,8 +85,8 @@ enum plotstate PlotState = Accelerometer;
 // High priority thread run by OS in real time at 1000 Hz
 #define SOUNDRMSLENGTH 1000 // number of samples to collect before calculating RMS (may overflow if greater than 4104)
 int16_t SoundArray[SOUNDRMSLENGTH];
-int32_t TakeSoundData; // binary semaphore
-int32_t ADCmutex;      // access to ADC
+sema_t TakeSoundData; // binary semaphore
+mutex_t ADCmutex;      // access to ADC
 // *********Task0*********
 // Task0 measures sound intensity
 // Periodic main thread runs in real time at 1000 Hz
@@ -102,9 +102,9 @@ void Task0(void){
     OS_Wait(&TakeSoundData); // signaled by OS every 1ms
     TExaS_Task0();     // record system time in array, toggle virtual logic analyzer
     Profile_Toggle0(); // viewed by the logic analyzer to know Task0 started
-    OS_Wait(&ADCmutex);
+    OS_Lock(&ADCmutex);
     BSP_Microphone_Input(&SoundData);
-    OS_Signal(&ADCmutex);
+    OS_Unlock(&ADCmutex);
     soundSum = soundSum + (int32_t)SoundData;
     SoundArray[time] = SoundData;
     time = time + 1;
@@ -122,7 +122,7 @@ void Task0(void){
 
 //---------------- Task1 measures acceleration ----------------
 // Event thread run by OS in real time at 10 Hz
-int32_t TakeAccelerationData;
+sema_t TakeAccelerationData;
 uint32_t LostTask1Data;     // number of times that the FIFO was full when acceleration data was ready
 uint16_t AccX, AccY, AccZ;  // returned by BSP as 10-bit numbers
 #define ALPHA 128           // The degree of weighting decrease, a constant smoothing factor between 0 and 1,023. A higher ALPHA discounts older observations faster.
@@ -153,9 +153,9 @@ void Task1(void){uint32_t squared;
     OS_Wait(&TakeAccelerationData); // signaled by OS every 100ms
     TExaS_Task1();     // records system time in array, toggles virtual logic analyzer
     Profile_Toggle1(); // viewed by the logic analyzer to know Task1 started
-    OS_Wait(&ADCmutex);
+    OS_Lock(&ADCmutex);
     BSP_Accelerometer_Input(&AccX, &AccY, &AccZ);
-    OS_Signal(&ADCmutex);
+    OS_Unlock(&ADCmutex);
     squared = AccX*AccX + AccY*AccY + AccZ*AccZ;
     if(OS_FIFO_Put(squared) == -1){  // makes Task2 run every 100ms
       LostTask1Data = LostTask1Data + 1;
@@ -181,7 +181,7 @@ void Task1(void){uint32_t squared;
 #define TEMP_MAX 1023
 #define TEMP_MIN 0
 void drawaxes(void){
-  OS_Wait(&LCDmutex);
+  OS_Lock(&LCDmutex);
   if(PlotState == Accelerometer){
     BSP_LCD_Drawaxes(AXISCOLOR, BGCOLOR, "Time", "Mag", MAGCOLOR, "Ave", EWMACOLOR, ACCELERATION_MAX, ACCELERATION_MIN);
   } else if(PlotState == Microphone){
@@ -191,7 +191,7 @@ void drawaxes(void){
   } else if(PlotState == Light){
     BSP_LCD_Drawaxes(AXISCOLOR, BGCOLOR, "Time", "Light", LIGHTCOLOR, "", 0, LIGHT_MAX, LIGHT_MIN);
   }
-  OS_Signal(&LCDmutex);  ReDrawAxes = 0;
+  OS_Unlock(&LCDmutex);  ReDrawAxes = 0;
 }
 void Task2(void){uint32_t data;
   uint32_t localMin;   // smallest measured magnitude since odd-numbered step detected
@@ -258,7 +258,7 @@ void Task2(void){uint32_t data;
       drawaxes();
       ReDrawAxes = 0;
     }
-    OS_Wait(&LCDmutex);
+    OS_Lock(&LCDmutex);
     if(PlotState == Accelerometer){
       BSP_LCD_PlotPoint(Magnitude, MAGCOLOR);
       BSP_LCD_PlotPoint(EWMA, EWMACOLOR);
@@ -270,7 +270,7 @@ void Task2(void){uint32_t data;
       BSP_LCD_PlotPoint(LightData, LIGHTCOLOR);
     }
     BSP_LCD_PlotIncrement();
-    OS_Signal(&LCDmutex);
+    OS_Unlock(&LCDmutex);
   }
 }
 /* ****************************************** */
@@ -286,7 +286,7 @@ void Task2(void){uint32_t data;
 // checks the switches, updates the mode, and outputs to the buzzer and LED
 // Inputs:  none
 // Outputs: none
-int32_t SwitchTouch;
+sema_t SwitchTouch;
 void Task3(void){
   uint8_t current;
 	OS_InitSemaphore(&SwitchTouch,0); // signaled on touch button1
@@ -328,19 +328,20 @@ void Task3(void){
 // Outputs: none
 void Task4(void){int32_t voltData,tempData;
   int done;
+  uint64_t lastWake = OS_Ticks();
   while(1){
     TExaS_Task4();     // records system time in array, toggles virtual logic analyzer
     Profile_Toggle4(); // viewed by the logic analyzer to know Task4 started
 
-    OS_Wait(&I2Cmutex);
+    OS_Lock(&I2Cmutex);
     BSP_TempSensor_Start();
-    OS_Signal(&I2Cmutex);
+    OS_Unlock(&I2Cmutex);
     done = 0;
-    OS_Sleep(1000);    // waits about 1 sec
+    OS_SleepUntil(&lastWake, 1000);    // one sample every second
     while(done == 0){
-      OS_Wait(&I2Cmutex);
+      OS_Lock(&I2Cmutex);
       done = BSP_TempSensor_End(&voltData, &tempData);
-      OS_Signal(&I2Cmutex);
+      OS_Unlock(&I2Cmutex);
     }
     TemperatureData = tempData/10000;
   }
@@ -361,12 +362,12 @@ void Task4(void){int32_t voltData,tempData;
 // Inputs:  none
 // Outputs: none
 void Task5(void){int32_t soundSum;
-  OS_Wait(&LCDmutex);
+  OS_Lock(&LCDmutex);
   BSP_LCD_DrawString(0,  0, "Temp=",  TOPTXTCOLOR);
   BSP_LCD_DrawString(0,  1, "Step=",  TOPTXTCOLOR);
   BSP_LCD_DrawString(10, 0, "Light=", TOPTXTCOLOR);
   BSP_LCD_DrawString(10, 1, "Sound=", TOPTXTCOLOR);
-  OS_Signal(&LCDmutex);
+  OS_Unlock(&LCDmutex);
   while(1){
     OS_Wait(&NewData);
     TExaS_Task5();     // records system time in array, toggles virtual logic analyzer
@@ -376,7 +377,7 @@ void Task5(void){int32_t soundSum;
       soundSum = soundSum + (SoundArray[i] - SoundAvg)*(SoundArray[i] - SoundAvg);
     }
     SoundRMS = sqrt32(soundSum/SOUNDRMSLENGTH);
-    OS_Wait(&LCDmutex);
+    OS_Lock(&LCDmutex);
     BSP_LCD_SetCursor(5,  0); BSP_LCD_OutUFix2_1(TemperatureData, TEMPCOLOR);
     BSP_LCD_SetCursor(5,  1); BSP_LCD_OutUDec4(Steps,             MAGCOLOR);
     BSP_LCD_SetCursor(16, 0); BSP_LCD_OutUDec4(LightData,         LIGHTCOLOR);
@@ -387,7 +388,7 @@ void Task5(void){int32_t soundSum;
       BSP_LCD_SetCursor(0, 12); BSP_LCD_OutUDec4(LostTask1Data, BSP_LCD_Color565(255, 0, 0));
     }
 //end of debug code
-    OS_Signal(&LCDmutex);
+    OS_Unlock(&LCDmutex);
   }
 }
 /* ****************************************** */
@@ -402,19 +403,20 @@ void Task5(void){int32_t soundSum;
 // Outputs: none
 void Task6(void){ uint32_t lightData;
   int done;
+  uint64_t lastWake = OS_Ticks();
   while(1){
     TExaS_Task6();     // records system time in array, toggles virtual logic analyzer
     Profile_Toggle6(); // viewed by the logic analyzer to know Task6 started
 
-    OS_Wait(&I2Cmutex);
+    OS_Lock(&I2Cmutex);
     BSP_LightSensor_Start();
-    OS_Signal(&I2Cmutex);
+    OS_Unlock(&I2Cmutex);
     done = 0;
-    OS_Sleep(800);     // waits about 0.8 sec
+    OS_SleepUntil(&lastWake, 800);     // one sample every 0.8 sec
     while(done == 0){
-      OS_Wait(&I2Cmutex);
+      OS_Lock(&I2Cmutex);
       done = BSP_LightSensor_End(&lightData);
-      OS_Signal(&I2Cmutex);
+      OS_Unlock(&I2Cmutex);
     }
     LightData = lightData/100;
   }
@@ -434,7 +436,7 @@ void Task7(void){
   Count7 = 0;
   while(1){
     Count7++;
-    WaitForInterrupt();
+    OS_Idle();         // WaitForInterrupt, tickless when all others sleep
   }
 }
 /* ****************************************** */
@@ -472,10 +474,10 @@ int main(void){
   BSP_TempSensor_Init();
   Time = 0;
   OS_InitSemaphore(&NewData, 0);  // 0 means no data
-  OS_InitSemaphore(&LCDmutex, 1); // 1 means free
-  OS_InitSemaphore(&I2Cmutex, 1); // 1 means free
+  OS_InitMutex(&LCDmutex, MUTEX_INHERIT, 0);
+  OS_InitMutex(&I2Cmutex, MUTEX_INHERIT, 0);
   OS_InitSemaphore(&TakeSoundData, 0);
-  OS_InitSemaphore(&ADCmutex, 1);
+  OS_InitMutex(&ADCmutex, MUTEX_INHERIT, 0);
   BSP_Microphone_Init();
   BSP_Accelerometer_Init();
   OS_InitSemaphore(&TakeAccelerationData, 0);
@@ -524,7 +526,7 @@ int n;             // loop counter
 // Remember that you must have exactly one main() function, so
 // to work on this step, you must rename all other main()
 // functions in this file.
-int32_t sAB,sCD,sEF;
+sema_t sAB,sCD,sEF;
 int32_t CountA,CountB,CountC,CountD,CountE,CountF,CountG,CountH;
 void TaskA(void){ // producer highest priority
   CountA = 0;
@@ -627,8 +629,8 @@ int main_step1(void){
 // Remember that you must have exactly one main() function, so
 // to work on this step, you must rename all other main()
 // functions in this file.
-int32_t sIJ,sKL,sMN;
-int32_t sI,sK;
+sema_t sIJ,sKL,sMN;
+sema_t sI,sK;
 int32_t CountI,CountJ,CountK,CountL,CountM,CountN,CountO,CountP;
 void TaskI(void){ // producer highest priority
   CountI = 0;
@@ -735,8 +737,8 @@ int main_step2(void){
 // Remember that you must have exactly one main() function, so
 // to work on this step, you must rename all other main()
 // functions in this file.
-int32_t sQR;
-int32_t sQ;
+sema_t sQR;
+sema_t sQ;
 int32_t CountQ,CountR;
 void TaskQ(void){ // producer
   CountQ = 0;
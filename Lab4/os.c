@@ -14,12 +14,29 @@
 // function definitions in osasm.s
 void StartOS(void);
 
+#ifndef NUMTHREADS
 #define NUMTHREADS       8        // maximum number of threads
+#endif
+#define NUMPRIORITIES    32       // priorities 0 (highest) to 31, one bit each
 #define NUMPERIODIC      2        // maximum number of periodic threads
+#define NUMREALTIME      8        // maximum number of real-time threads
 #define STACKSIZE        100      // number of 32-bit words in stack per thread
+#ifndef STACKPOOL
+#define STACKPOOL        (NUMTHREADS*STACKSIZE)  // words shared by all stacks
+#endif
+#define STACKMIN         32       // smallest stack in words, 8 byte multiple
+#define STACK_PAINT      0xA5A5A5A5  // stack words never used
+#define STACK_GUARD      0x5AFE57AC  // lowest word of every stack
 #define TIMER_FREQ       1000
 #define TIMER_PRIORITY	 6
+#ifndef TICKLESS
+#define TICKLESS         1        // 0 keeps every tick in OS_Idle
+#endif
+#ifndef PENDSV_SWITCH
+#define PENDSV_SWITCH    1        // 0 switches through SysTick as before
+#endif
 #define THUMB_BIT   0x01000000  // thumb bit in Process Stack Pointer PSR
+#define EXC_RETURN  0xFFFFFFF9  // back to thread mode on MSP, no FPU state
 #define REG14       0x14141414
 #define REG12       0x12121212
 #define REG11       0x11111111
@@ -36,21 +53,325 @@ void StartOS(void);
 #define REG00       0x00000000
 #define NULL        (void*)0
 
+// number of leading zeros, one CLZ instruction on the Cortex M4
+#ifdef __GNUC__
+#define CLZ(x)      __builtin_clz(x)
+#else
+#define CLZ(x)      __clz(x)
+#endif
+
+// free running bus cycle counter for the thread statistics, the DWT
+// cycle counter on the target
+#ifdef HOST_PORT
+#define CYCLE_COUNT()    Host_CycleCount()
+#else
+#define DEMCR            (*((volatile uint32_t *)0xE000EDFC))
+#define DWT_CTRL         (*((volatile uint32_t *)0xE0001000))
+#define DWT_CYCCNT       (*((volatile uint32_t *)0xE0001004))
+#define CPACR            (*((volatile uint32_t *)0xE000ED88))
+#define CYCLE_COUNT()    DWT_CYCCNT
+#endif
+
+// apply a write to STCTRL, the host timer does not see the register
+#ifdef HOST_PORT
+#define SYSTICK_UPDATE()   Host_SysTickControl()
+#else
+#define SYSTICK_UPDATE()
+#endif
+
+// pend a context switch. PendSV runs the same switch as SysTick at the
+// same priority 7 and leaves SysTick to the time slice, a yield does
+// not restart it.
+#define PENDSVSET        0x10000000  // INTCTRL, pend PendSV
+#define PENDSTSET        0x04000000  // INTCTRL, pend SysTick
+#if PENDSV_SWITCH
+#define SWITCH_PEND()    (INTCTRL = PENDSVSET)
+#else
+#define SWITCH_PEND()    (INTCTRL = PENDSTSET)
+#endif
+
+// **************** Kernel trace ***************
+// TRACE_ENTRIES records in a ring, see os.h. A writer claims a record
+// with an atomic increment of Index, so Scheduler, the event threads
+// and main threads can log at the same time without masking.
+#ifndef TRACE_ENTRIES
+#define TRACE_ENTRIES    0        // no trace
+#endif
+// **************** Thread statistics ***************
+// THREAD_STATS 0 leaves out the time stamps of Scheduler, the blocking
+// primitives and the wake ups, OS_GetStats then reports only the
+// priority, every count is 0.
+#ifndef THREAD_STATS
+#define THREAD_STATS     1        // collect the statistics of OS_GetStats
+#endif
+#if TRACE_ENTRIES
+struct trace{
+  traceHeader_t Header;
+  traceRecord_t Records[TRACE_ENTRIES];
+} Trace;
+#ifdef __GNUC__
+#define TRACE_CLAIM()    __atomic_fetch_add(&Trace.Header.Index, 1, __ATOMIC_RELAXED)
+#else
+uint32_t static TraceClaim(void){
+	uint32_t i;
+	do {
+		i = __ldrex(&Trace.Header.Index);
+	} while ( __strex(i + 1, &Trace.Header.Index) );
+	return i;
+}
+#define TRACE_CLAIM()    TraceClaim()
+#endif
+#define TRACE(event, pt, arg)  TraceWrite((event), (pt), (arg))
+#else
+#define TRACE(event, pt, arg)
+#endif
+
+// acquire load and release store of a FIFO index, and a full barrier.
+// One core: they keep the compiler from moving data accesses across
+// them, DMB orders them for the bus.
+#ifdef __GNUC__
+#define LOAD_ACQUIRE(x)       __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(x, v)   __atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+#define MEMORY_BARRIER()      __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#else
+#define LOAD_ACQUIRE(x)       (__dmb(0xF), (x))
+#define STORE_RELEASE(x, v)   do { __dmb(0xF); (x) = (v); } while (0)
+#define MEMORY_BARRIER()      __dmb(0xF)
+#endif
 
 // **************** TCB ***************
 struct tcb{
   int32_t *sp;       // pointer to stack (valid for threads not running)
   int32_t Sleep;     // nonzero if this thread is sleeping.
-  int32_t *Blocked;  // nonzero if this thread is blocked.
+  uint32_t SleepDelta;    // ticks after the previous one in the sleep queue
+  struct tcb *nextSleep;  // sleep queue pointer
+  sema_t *Blocked;   // nonzero if this thread is blocked.
+  struct tcb *nextBlocked;  // queue of the semaphore it is blocked on
   int32_t Priority; // threads with high priority run more frequently.
-  struct tcb *next;  // linked-list pointer
+  int32_t BasePriority;   // Priority when it holds no mutex
+  struct mutex *Held;     // mutexes it owns, most recent first
+  struct mutex *WaitMutex;  // mutex it is blocked on, NULL if none
+  flags_t *WaitFlags;     // flag group it is blocked on, NULL if none
+  uint32_t FlagsMask;     // flags it waits for
+  uint32_t FlagsMode;     // FLAGS_ANY or FLAGS_ALL, plus FLAGS_CLEAR
+  uint32_t FlagsGot;      // flags it woke up with, 0 on timeout
+  struct tcb *next;  // free TCB list pointer
+  struct tcb *nextReady;  // ready list of this priority, circular
+  struct tcb *prevReady;
+  int32_t *Stack;    // lowest word of the stack, from StackPool
+  uint32_t StackWords;    // size of the stack
+  struct rtThread *Rt;    // timing of a real-time thread, NULL if none
+  uint32_t BlockStart;    // cycle count when it blocked
+  uint32_t ReleaseStart;  // cycle count when it woke up from a sleep
+  uint32_t Released;      // 1 from the wake up until it runs
+  threadStats_t Stats;    // see OS_GetStats
 };
 
 typedef struct tcb tcbType;
-tcbType tcbs[NUMTHREADS];
+tcbType tcbs[NUMTHREADS];   // pool of TCBs, free ones are on FreeTcbs
+tcbType *FreeTcbs;
 tcbType *RunPt;
-int32_t Stacks[NUMTHREADS][STACKSIZE];
+uint32_t NumThreads;    // threads alive
+uint64_t TickCount;     // ms since OS_Init, counted by RunPeriodicEvents
+tcbType *SleepList;     // sleep queue, head wakes up first
+uint32_t SwitchStamp;   // cycle count of the last context switch
+uint32_t TickStep = 1;  // ticks per RunPeriodicEvents interrupt
+uint32_t TickCycles;    // cycles per tick
+uint32_t TickDue;       // cycle count the last RunPeriodicEvents was due at
+int32_t TickLag;        // cycles the tick timer lost to restarts
+tcbType *IdlePt;        // thread in OS_Idle with the ticks stopped, or NULL
+const threadStats_t NoStats;   // all zero, for a new thread
 void static RunPeriodicEvents(void);
+#if TRACE_ENTRIES
+void static TraceWrite(uint8_t event, tcbType *pt, uint32_t arg);
+#endif
+int32_t static HeldPriority(tcbType *pt);
+void static SetPriority(tcbType *pt, int32_t priority);
+void static SemaRemove(sema_t *semaPt, tcbType *pt);
+#if TICKLESS
+int static AloneReady(tcbType *pt);
+uint32_t static TickLagged(void);
+void static TickStretch(void);
+void static TickCatchUp(void);
+void static TickResume(void);
+#endif
+
+// **************** Real-time threads ***************
+// A real-time thread has a period, a worst case execution time and a
+// relative deadline. A job is released every period, the thread runs
+// it and calls OS_WaitPeriod. Under SCHED_RM the real-time threads get
+// priorities 0 to NUMREALTIME-1 by period, shortest first. Under
+// SCHED_EDF they all run at priority 0 and its ready list is kept by
+// absolute deadline, earliest first.
+typedef struct rtThread{
+  tcbType *Tcb;           // NULL if this entry is free
+  uint32_t Period;        // ms
+  uint32_t Wcet;          // us
+  uint32_t Deadline;      // ms after the release
+  uint32_t Release;       // TickCount of the current job
+  uint32_t AbsDeadline;   // TickCount the current job is due
+  uint32_t Jobs;          // jobs finished
+  uint32_t Misses;        // jobs finished late or skipped
+} rtThread_t;
+
+rtThread_t RealTime[NUMREALTIME];
+uint32_t RealTimeMode = SCHED_RM;
+
+// 1 if thread a must run before thread b at the EDF level, threads
+// that are not real-time come last
+int static EarlierDeadline(tcbType *a, tcbType *b){
+	if ( b->Rt == NULL )
+		return a->Rt != NULL;
+	if ( a->Rt == NULL )
+		return 0;
+	return (int32_t)(a->Rt->AbsDeadline - b->Rt->AbsDeadline) < 0;
+}
+
+// 1 if the list of this priority is kept by deadline
+#define EDFLEVEL(priority)  ((RealTimeMode == SCHED_EDF) && ((priority) == 0))
+
+// **************** Ready lists ***************
+// One circular list per priority of the threads neither blocked nor
+// sleeping, ReadyList[p] is the next to run at priority p. Bit 31-p of
+// ReadyMask is set when list p is not empty, so the highest ready
+// priority is the number of leading zeros of ReadyMask.
+// Called with interrupts disabled.
+tcbType *ReadyList[NUMPRIORITIES];
+uint32_t ReadyMask;
+
+// add thread pt at the tail of its priority, it runs after the others.
+// At the EDF level it goes behind the threads due no later than it.
+void static ReadyInsert(tcbType *pt){
+	tcbType *head = ReadyList[pt->Priority];
+	tcbType *pos = head;
+	if ( head == NULL ) {
+		pt->nextReady = pt->prevReady = pt;
+		ReadyList[pt->Priority] = pt;
+		ReadyMask |= 0x80000000 >> pt->Priority;
+		return;
+	}
+	if ( EDFLEVEL(pt->Priority) ) {
+		if ( EarlierDeadline(pt, head) )
+			ReadyList[pt->Priority] = pt;   // new head, insert before old one
+		else {
+			pos = head->nextReady;
+			while ( (pos != head) && !EarlierDeadline(pt, pos) )
+				pos = pos->nextReady;
+		}
+	}
+	pt->nextReady = pos;               // insert before pos
+	pt->prevReady = pos->prevReady;
+	pos->prevReady->nextReady = pt;
+	pos->prevReady = pt;
+}
+
+// **************** Stack pool ***************
+// Stacks of any size are carved out of StackPool, first fit. Free
+// blocks are kept by address with their header in their lowest words,
+// a freed stack merges with the free blocks next to it.
+// Called with interrupts disabled.
+typedef struct stackBlock{
+  uint32_t Words;              // size of this free block
+  struct stackBlock *next;     // next free block, at a higher address
+} stackBlock_t;
+
+#ifdef __GNUC__
+__attribute__((aligned(8))) int32_t StackPool[STACKPOOL];  // even sized blocks keep 8 byte aligned tops
+#else
+__align(8) int32_t StackPool[STACKPOOL];  // even sized blocks keep 8 byte aligned tops
+#endif
+stackBlock_t *StackFreeList;
+
+// allocate *words words (rounded up to an 8 byte multiple, at least
+// STACKMIN), *words is set to the size given. NULL if none is big enough
+int32_t static *StackAlloc(uint32_t *words){
+	stackBlock_t **link = &StackFreeList;
+	stackBlock_t *block;
+	uint32_t size = (*words + 1) & ~1u;
+	if ( size < STACKMIN )
+		size = STACKMIN;
+	while ( (*link != NULL) && ((*link)->Words < size) )
+		link = &(*link)->next;
+	block = *link;
+	if ( block == NULL )
+		return NULL;
+	if ( block->Words - size >= STACKMIN ) {   // split, take the top end
+		block->Words -= size;
+		*words = size;
+		return (int32_t *)block + block->Words;
+	}
+	*link = block->next;                  // take the whole block
+	*words = block->Words;
+	return (int32_t *)block;
+}
+
+// return a stack of the given size to the pool
+void static StackFree(int32_t *stack, uint32_t words){
+	stackBlock_t **link = &StackFreeList;
+	stackBlock_t *block = (stackBlock_t *)stack;
+	stackBlock_t *prev = NULL;
+	while ( (*link != NULL) && (*link < block) ) {
+		prev = *link;
+		link = &(*link)->next;
+	}
+	block->Words = words;
+	block->next = *link;
+	*link = block;
+	if ( (block->next != NULL) &&
+	     ((int32_t *)block + block->Words == (int32_t *)block->next) ) {
+		block->Words += block->next->Words;      // merge with the next one
+		block->next = block->next->next;
+	}
+	if ( (prev != NULL) && ((int32_t *)prev + prev->Words == (int32_t *)block) ) {
+		prev->Words += block->Words;             // merge with the one before
+		prev->next = block->next;
+	}
+}
+
+// **************** Sleep queue ***************
+// Sleeping threads ordered by wake up time, the SleepDelta of each one
+// counts from the wake up of the thread before it, so a tick only
+// counts down the head. Threads waking up on the same tick keep the
+// order they went to sleep in.
+// Called with interrupts disabled.
+void static SleepInsert(tcbType *pt, uint32_t sleepTime){
+	tcbType **link = &SleepList;
+	while ( (*link != NULL) && ((*link)->SleepDelta <= sleepTime) ) {
+		sleepTime -= (*link)->SleepDelta;
+		link = &(*link)->nextSleep;
+	}
+	pt->SleepDelta = sleepTime;
+	pt->nextSleep = *link;
+	if ( *link != NULL )
+		(*link)->SleepDelta -= sleepTime;
+	*link = pt;
+}
+
+// take thread pt out of the sleep queue before it is due, the thread
+// after it gets its SleepDelta
+void static SleepRemove(tcbType *pt){
+	tcbType **link = &SleepList;
+	while ( *link != pt )
+		link = &(*link)->nextSleep;
+	*link = pt->nextSleep;
+	if ( pt->nextSleep != NULL )
+		pt->nextSleep->SleepDelta += pt->SleepDelta;
+	pt->Sleep = 0;
+}
+
+// remove thread pt, it is about to block or sleep
+void static ReadyRemove(tcbType *pt){
+	if ( pt->nextReady == pt ) {   // last one at this priority
+		ReadyList[pt->Priority] = NULL;
+		ReadyMask &= ~(0x80000000 >> pt->Priority);
+	}
+	else {
+		pt->prevReady->nextReady = pt->nextReady;
+		pt->nextReady->prevReady = pt->prevReady;
+		if ( ReadyList[pt->Priority] == pt )
+			ReadyList[pt->Priority] = pt->nextReady;
+	}
+}
 
 
 // ******* threads values enumerator *******
@@ -74,35 +395,96 @@ enum threads {
 void OS_Init(void){
   DisableInterrupts();
   BSP_Clock_InitFastest();// set processor clock to fastest speed
-  uint8_t i;
+  uint32_t i;
   for ( i = 0; i < NUMTHREADS; i++ ) {	 // Initializing threads.
 	  tcbs[i].Blocked = NULL;
-	  tcbs[i].next = NULL;
+	  tcbs[i].nextBlocked = NULL;
+	  tcbs[i].next = (i + 1 < NUMTHREADS) ? &tcbs[i + 1] : NULL;
+	  tcbs[i].Stack = NULL;
+	  tcbs[i].StackWords = 0;
+	  tcbs[i].Rt = NULL;
+	  tcbs[i].nextReady = tcbs[i].prevReady = NULL;
 	  tcbs[i].sp = NULL;
 	  tcbs[i].Priority = 0;
+	  tcbs[i].BasePriority = 0;
+	  tcbs[i].Held = NULL;
+	  tcbs[i].WaitMutex = NULL;
+	  tcbs[i].WaitFlags = NULL;
 	  tcbs[i].Sleep = 0;
+	  tcbs[i].SleepDelta = 0;
+	  tcbs[i].nextSleep = NULL;
   }
+  FreeTcbs = &tcbs[0];
+  StackFreeList = (stackBlock_t *)StackPool;	 // all of the pool is free
+  StackFreeList->Words = STACKPOOL;
+  StackFreeList->next = NULL;
+  RunPt = NULL;
+  SleepList = NULL;
+  for ( i = 0; i < NUMPRIORITIES; i++ )
+	  ReadyList[i] = NULL;
+  ReadyMask = 0;
+  NumThreads = 0;
+  TickCount = 0;
+  for ( i = 0; i < NUMREALTIME; i++ )
+	  RealTime[i].Tcb = NULL;
+  RealTimeMode = SCHED_RM;
+#ifndef HOST_PORT
+  DEMCR |= 0x01000000;       // enable the DWT
+  DWT_CYCCNT = 0;
+  DWT_CTRL |= 0x00000001;    // start the cycle counter
+  CPACR |= 0x00F00000;       // FPU on, saved by the switch, see osasm.s
+#endif
+#if TRACE_ENTRIES
+  Trace.Header.Magic = TRACE_MAGIC;
+  Trace.Header.Entries = TRACE_ENTRIES;
+  Trace.Header.Clock = BSP_Clock_GetFreq();
+  Trace.Header.Index = 0;
+#endif
+  TickStep = 1;              // a tick can come before OS_Launch, see TickLagged
+  TickLag = 0;
+  TickCycles = BSP_Clock_GetFreq()/TIMER_FREQ;
+  TickDue = CYCLE_COUNT();
   BSP_PeriodicTask_Init(&RunPeriodicEvents, TIMER_FREQ, TIMER_PRIORITY);				
   // set up periodic timer to run runperiodicevents to implement sleeping
 }
 
-void SetInitialStack(int i){
-	tcbs[i].sp = &Stacks[i][STACKSIZE - 16];    // Set stack pointer of each thread.
-	Stacks[i][STACKSIZE - 1] = THUMB_BIT;      // enable thumb bit	in PSR
-	Stacks[i][STACKSIZE - 3] = REG14;      // R14
-	Stacks[i][STACKSIZE - 4] = REG12;      // R12
-	Stacks[i][STACKSIZE - 5] = REG03;      // R3
-	Stacks[i][STACKSIZE - 6] = REG02;      // R2
-	Stacks[i][STACKSIZE - 7] = REG01;      // R1
-	Stacks[i][STACKSIZE - 8] = REG00;      // R0
-	Stacks[i][STACKSIZE - 9] = REG11;      // R11
-	Stacks[i][STACKSIZE - 10] = REG10;     // R10
-	Stacks[i][STACKSIZE - 11] = REG09;     // R9
-	Stacks[i][STACKSIZE - 12] = REG08;     // R8
-	Stacks[i][STACKSIZE - 13] = REG07;     // R7
-	Stacks[i][STACKSIZE - 14] = REG06;     // R6
-	Stacks[i][STACKSIZE - 15] = REG05;     // R5
-	Stacks[i][STACKSIZE - 16] = REG04;     // R4
+// ******** SetInitialStack ************
+// Build the initial stack frame of thread pt at the top of pt->Stack,
+// PC is the thread entry. The rest of the stack is painted with
+// STACK_PAINT for OS_StackHighWater, the lowest word is STACK_GUARD.
+// On the host the TCB sp is a host context instead, see host/osasm.c,
+// the context of the thread that used the TCB before is freed here
+void SetInitialStack(tcbType *pt, void(*thread)(void)){
+	uint32_t i;
+	pt->Stack[0] = (int32_t)STACK_GUARD;
+	for ( i = 1; i < pt->StackWords; i++ )
+		pt->Stack[i] = (int32_t)STACK_PAINT;
+#ifdef HOST_PORT
+	if ( pt->sp != NULL )
+		Host_FreeStack(pt->sp);
+	pt->sp = Host_InitialStack(thread);
+#else
+	int32_t *top = &pt->Stack[pt->StackWords];
+	pt->sp = top - 18;             // Set stack pointer of the thread.
+	top[-1] = THUMB_BIT;           // enable thumb bit	in PSR
+	top[-2] = (int32_t)(thread);   // PC
+	top[-3] = REG14;      // R14
+	top[-4] = REG12;      // R12
+	top[-5] = REG03;      // R3
+	top[-6] = REG02;      // R2
+	top[-7] = REG01;      // R1
+	top[-8] = REG00;      // R0
+	top[-9] = REG11;      // R11
+	top[-10] = REG10;     // R10
+	top[-11] = REG09;     // R9
+	top[-12] = REG08;     // R8
+	top[-13] = REG07;     // R7
+	top[-14] = REG06;     // R6
+	top[-15] = REG05;     // R5
+	top[-16] = REG04;     // R4
+	top[-17] = EXC_RETURN;  // LR of SysTick_Handler, FPU unused
+	top[-18] = REG00;     // padding to 8 bytes
+#endif
 }
 
 //******** OS_AddThreads ***************
@@ -119,9 +501,9 @@ int OS_AddThreads(void(*thread0)(void), uint32_t p0,
                   void(*thread5)(void), uint32_t p5,
                   void(*thread6)(void), uint32_t p6,
                   void(*thread7)(void), uint32_t p7){
-	uint16_t cr = StartCritical();
 	uint8_t THREAD;
-	uint16_t PRIORITY[NUMTHREADS];
+	uint32_t PRIORITY[8];
+	void (*THREADS[8])(void);
 	PRIORITY[0] = p0;
 	PRIORITY[1] = p1;
 	PRIORITY[2] = p2;
@@ -130,31 +512,157 @@ int OS_AddThreads(void(*thread0)(void), uint32_t p0,
 	PRIORITY[5] = p5;
 	PRIORITY[6] = p6;
 	PRIORITY[7] = p7;
+	THREADS[0] = thread0;
+	THREADS[1] = thread1;
+	THREADS[2] = thread2;
+	THREADS[3] = thread3;
+	THREADS[4] = thread4;
+	THREADS[5] = thread5;
+	THREADS[6] = thread6;
+	THREADS[7] = thread7;
 
-	tcbs[THREAD0].next = &tcbs[THREAD1];	 // Circular linked list
-	tcbs[THREAD1].next = &tcbs[THREAD2];
-	tcbs[THREAD2].next = &tcbs[THREAD3];
-	tcbs[THREAD3].next = &tcbs[THREAD4];
-	tcbs[THREAD4].next = &tcbs[THREAD5];
-	tcbs[THREAD5].next = &tcbs[THREAD6];
-	tcbs[THREAD6].next = &tcbs[THREAD7];
-	tcbs[THREAD7].next = &tcbs[THREAD0];
-
-	for ( THREAD = 0; THREAD < NUMTHREADS; THREAD++ ) {	 // Initialize stacks and threads priority
-		SetInitialStack(THREAD);
-		tcbs[THREAD].Priority = PRIORITY[THREAD];     
+	for ( THREAD = THREAD0; THREAD <= THREAD7; THREAD++ ) {
+		if ( OS_AddThread(THREADS[THREAD], PRIORITY[THREAD]) == 0 )
+			return 0;
 	}
-	RunPt = &tcbs[THREAD0];			   // Initialize run pointer to first thread
-	EndCritical(cr);
   return 1;               // successful
 }
 
+//******** OS_AddThread ***************
+// Add one main thread to the scheduler with a STACKSIZE word stack
+// Inputs: function pointer to a void/void main thread
+//         priority (0 highest, NUMPRIORITIES-1 lowest)
+// Outputs: 1 if successful, 0 if this thread can not be added
+int OS_AddThread(void(*thread)(void), uint32_t priority){
+  return OS_CreateThread(thread, priority, STACKSIZE);
+}
+
+// ******** CreateThread ************
+// Take a TCB and a stack from the pools and make the thread ready,
+// rt is its real-time entry or NULL. Called with interrupts disabled.
+// Outputs: the new TCB, NULL if no TCB or no stack is free
+tcbType static *CreateThread(void(*thread)(void), uint32_t priority,
+                             uint32_t stackWords, rtThread_t *rt){
+	tcbType *pt = FreeTcbs;
+	int32_t *stack = NULL;
+	if ( pt != NULL )
+		stack = StackAlloc(&stackWords);
+	if ( stack == NULL )
+		return NULL;
+	FreeTcbs = pt->next;
+	pt->next = NULL;
+	pt->Stack = stack;
+	pt->StackWords = stackWords;
+	pt->Priority = pt->BasePriority = priority;
+	pt->Held = NULL;
+	pt->WaitMutex = NULL;
+	pt->WaitFlags = NULL;
+	pt->Sleep = 0;
+	pt->Blocked = NULL;
+	pt->Rt = rt;
+	pt->Released = 0;
+	pt->Stats = NoStats;
+	SetInitialStack(pt, thread);
+	ReadyInsert(pt);
+	if ( RunPt == NULL )
+		RunPt = pt;                  // Initialize run pointer to first thread
+	NumThreads++;
+	return pt;
+}
+
+//******** OS_CreateThread ***************
+// Create a main thread with a TCB from the pool and a stack from the
+// stack pool, it joins the end of the ready list of its priority.
+// It runs from the next time slice on, even if its priority is higher.
+// Inputs: function pointer to a void/void main thread
+//         priority (0 highest, NUMPRIORITIES-1 lowest)
+//         stack size in 32-bit words, rounded up to an even number
+//         and at least STACKMIN
+// Outputs: 1 if successful, 0 if no TCB or no stack is free
+// Called before OS_Launch or by a main thread, not by event threads
+int OS_CreateThread(void(*thread)(void), uint32_t priority, uint32_t stackWords){
+	tcbType *pt;
+	uint16_t cr;
+	if ( priority >= NUMPRIORITIES )
+		return 0;
+	cr = StartCritical();
+	pt = CreateThread(thread, priority, stackWords, NULL);
+	EndCritical(cr);
+  return pt != NULL;      // 1 if successful
+}
+
+//******** OS_Kill ***************
+// Kill the running thread, its TCB and stack go back to the pools
+// Inputs: none
+// Outputs: none (does not return)
+// Mutexes it holds are unlocked, it must not hold a semaphore other
+// threads wait on
+void OS_Kill(void){
+	while ( RunPt->Held != NULL )
+		OS_Unlock(RunPt->Held);
+	DisableInterrupts();
+	ReadyRemove(RunPt);
+	if ( RunPt->Rt != NULL )
+		RunPt->Rt->Tcb = NULL;      // its utilization is free again
+	StackFree(RunPt->Stack, RunPt->StackWords);
+	RunPt->Stack = NULL;
+	RunPt->next = FreeTcbs;
+	FreeTcbs = RunPt;
+	NumThreads--;
+	// nothing allocates before the switch, it saves R4-R11 on the
+	// freed stack and never comes back to this thread
+	EnableInterrupts();
+	OS_Suspend();
+	for(;;){
+	}
+}
+
 
 void static RunPeriodicEvents(void){
-	uint8_t THREAD;         // DECREMENT SLEEP COUNTERS
-	for ( THREAD = 0; THREAD < NUMTHREADS; THREAD++ )
-		if ( tcbs[THREAD].Sleep )
-			tcbs[THREAD].Sleep--;
+	tcbType *pt;            // COUNT DOWN THE HEAD OF THE SLEEP QUEUE
+	uint32_t ticks = TickStep;
+	uint16_t cr = StartCritical();
+#if TICKLESS
+	TickDue += TickStep*TickCycles;
+	ticks += TickLagged();
+#endif
+	TickCount += ticks;
+	if ( SleepList != NULL ) {
+		while ( (SleepList != NULL) && (SleepList->SleepDelta <= ticks) ) {
+			pt = SleepList;             // woke up
+			ticks -= pt->SleepDelta;
+			SleepList = pt->nextSleep;
+			pt->Sleep = 0;
+#if THREAD_STATS
+			pt->ReleaseStart = CYCLE_COUNT();
+			pt->Released = 1;
+#endif
+			TRACE(TRACE_RELEASE, pt, 0);
+			if ( pt->WaitFlags != NULL ) {  // OS_WaitFlags timed out
+				SemaRemove(&pt->WaitFlags->Wait, pt);
+				pt->WaitFlags = NULL;
+				pt->Blocked = NULL;
+				pt->FlagsGot = 0;
+			}
+			if ( pt->Blocked == 0 )
+				ReadyInsert(pt);
+			if ( pt->Rt != NULL )
+				SWITCH_PEND();          // job released, run the scheduler now
+		}
+		if ( SleepList != NULL )
+			SleepList->SleepDelta -= ticks;
+	}
+#if TICKLESS
+	if ( IdlePt != NULL ) {
+		if ( AloneReady(IdlePt) )
+			TickStretch();
+		else {
+			TickResume();               // on a tick, no time to catch up
+			SWITCH_PEND();              // run the threads woken up
+		}
+	}
+#endif
+	EndCritical(cr);
     // In Lab 4, handle periodic events in RealTimeEvents
 }
 
@@ -166,30 +674,334 @@ void static RunPeriodicEvents(void){
 void OS_Launch(uint32_t theTimeSlice){
   STCTRL = 0;                  // disable SysTick during setup
   STCURRENT = 0;               // any write to current clears it
-  SYSPRI3 = (SYSPRI3 & 0x00FFFFFF) | 0xE0000000;// priority 7
+  SYSPRI3 = (SYSPRI3 & 0x0000FFFF) | 0xE0E00000;// SysTick and PendSV priority 7
   STRELOAD = theTimeSlice - 1; // reload value
+  TickCycles = BSP_Clock_GetFreq()/TIMER_FREQ;
+  BSP_PeriodicTask_Init(&RunPeriodicEvents, TIMER_FREQ, TIMER_PRIORITY);  // ticks from now
+  TickDue = SwitchStamp = CYCLE_COUNT();
   STCTRL = 0x00000007;         // enable, core clock and interrupt arm
   StartOS();                   // start on the first task
 }
 
+// ******** StackOverflow ************
+// The guard word at the bottom of the stack of pt was overwritten, the
+// thread (or an ISR that interrupted it) ran past its stack and the
+// memory below is corrupt. Nothing can safely go on: stop with
+// interrupts disabled, StackOverflowPt tells the debugger which thread.
+// Inputs:  thread that overflowed
+// Outputs: none, never returns
+tcbType *StackOverflowPt;
+void static StackOverflow(tcbType *pt){
+	StackOverflowPt = pt;
+	DisableInterrupts();
+	for(;;){
+	}
+}
+
 // ***************** Scheduler *****************
-// look at all threads in TCB list choose
-// highest priority thread not blocked and not sleeping 
+// choose the highest priority thread not blocked and not sleeping,
+// the leading zeros of ReadyMask give its priority in constant time.
 // If there are multiple highest priority (not blocked, not sleeping),
-// run these round robin.
+// run these round robin: the head of the ready list runs and the
+// next one becomes the head.
+// If no thread is ready RunPt keeps running.
+// The time since the last switch is charged to the thread that ran,
+// time in event threads included.
 // runs every ms.
+// The guard word of the thread that ran is checked first, a killed
+// thread has no stack any more.
 void Scheduler(void){      // every time slice
-	uint8_t Max = 255;
-	tcbType *pt = RunPt;
-	tcbType *bestPt;
-	do {
-		pt = pt->next;
-		if ( (pt->Blocked == 0) && (pt->Sleep == 0) && (pt->Priority < Max) ) {
-			Max = pt->Priority;
-			bestPt = pt;
+	uint32_t priority;
+#if THREAD_STATS
+	uint32_t now, latency, bin;
+#endif
+	tcbType *lastPt = RunPt;
+	if ( (RunPt->Stack != NULL) && (RunPt->Stack[0] != (int32_t)STACK_GUARD) )
+		StackOverflow(RunPt);
+#if THREAD_STATS
+	now = CYCLE_COUNT();
+	RunPt->Stats.RunCycles += now - SwitchStamp;
+	SwitchStamp = now;
+#endif
+#if TICKLESS
+	if ( (IdlePt != NULL) && !AloneReady(IdlePt) ) {
+		TickCatchUp();              // woken up by an ISR between ticks
+		TickResume();
+	}
+#endif
+	if ( ReadyMask == 0 )
+		return;
+	priority = CLZ(ReadyMask);
+	RunPt = ReadyList[priority];
+	if ( !EDFLEVEL(priority) || (RunPt->Rt == NULL) )
+		ReadyList[priority] = RunPt->nextReady;  // EDF keeps the earliest deadline
+	if ( RunPt != lastPt ) {
+#if THREAD_STATS
+		RunPt->Stats.Switches++;
+#endif
+		TRACE(TRACE_SWITCH_OUT, lastPt, lastPt->Priority);
+		TRACE(TRACE_SWITCH_IN, RunPt, RunPt->Priority);
+	}
+#if THREAD_STATS
+	if ( RunPt->Released ) {        // first run after a sleep
+		RunPt->Released = 0;
+		latency = now - RunPt->ReleaseStart;
+		if ( latency > RunPt->Stats.MaxLatency )
+			RunPt->Stats.MaxLatency = latency;
+		latency = latency / (BSP_Clock_GetFreq() / 1000000);   // us
+		bin = latency ? 32 - CLZ(latency) : 0;
+		if ( bin >= JITTERBINS )
+			bin = JITTERBINS - 1;
+		RunPt->Stats.Jitter[bin]++;
+		RunPt->Stats.Releases++;
+	}
+#endif
+}
+
+// ******** OS_GetStats ************
+// CPU time, switches, blocking and release latency of a thread,
+// collected since it was created, all 0 but the priority if built
+// with THREAD_STATS 0
+// Inputs:  thread, 0 to NUMTHREADS-1 in the TCB pool
+//          where to store the statistics
+// Outputs: 1 if successful, 0 if there is no such thread alive
+int OS_GetStats(uint32_t thread, threadStats_t *stats){
+	uint16_t cr;
+	if ( (thread >= NUMTHREADS) || (tcbs[thread].Stack == NULL) )
+		return 0;
+	cr = StartCritical();
+	*stats = tcbs[thread].Stats;
+	stats->Priority = tcbs[thread].Priority;
+	EndCritical(cr);
+	return 1;
+}
+
+// ******** OS_StackHighWater ************
+// Most stack words a thread has used since it was created, the words
+// from the top down to the lowest one no longer STACK_PAINT. ISRs run
+// on the stack of the thread they interrupt and count too. A thread
+// that used a word but left STACK_PAINT in it reads low by that much.
+// Scans the stack with interrupts disabled.
+// Inputs:  thread, 0 to NUMTHREADS-1 in the TCB pool
+// Outputs: words used, the whole stack if the guard word is gone,
+//          0 if there is no such thread alive
+uint32_t OS_StackHighWater(uint32_t thread){
+	tcbType *pt;
+	uint32_t i = 1, words = 0;
+	uint16_t cr;
+	if ( thread >= NUMTHREADS )
+		return 0;
+	pt = &tcbs[thread];
+	cr = StartCritical();
+	if ( pt->Stack != NULL ) {
+		words = pt->StackWords;
+		if ( pt->Stack[0] == (int32_t)STACK_GUARD ) {
+			while ( (i < words) && (pt->Stack[i] == (int32_t)STACK_PAINT) )
+				i++;
+			words -= i;
 		}
-	} while ( pt != RunPt);
-	RunPt = bestPt;
+	}
+	EndCritical(cr);
+	return words;
+}
+
+#if TRACE_ENTRIES
+// ******** TraceWrite ************
+// Log one event in the trace ring, lock free
+// Inputs:  TRACE_ event
+//          thread, NULL for none
+//          argument, see os.h
+// Outputs: none
+void static TraceWrite(uint8_t event, tcbType *pt, uint32_t arg){
+	traceRecord_t *rec = &Trace.Records[TRACE_CLAIM() & (TRACE_ENTRIES - 1)];
+	rec->Time = CYCLE_COUNT();
+	rec->Event = event;
+	rec->Thread = (pt == NULL) ? TRACE_NOTHREAD : (uint8_t)(pt - tcbs);
+	rec->Arg = (arg > 0xFFFF) ? 0xFFFF : (uint16_t)arg;
+}
+#endif
+
+// ******** Unblocked ************
+// Keep the longest time thread pt was blocked, it wakes up now.
+// Called with interrupts disabled.
+void static Unblocked(tcbType *pt){
+#if THREAD_STATS
+	uint32_t blocked = CYCLE_COUNT() - pt->BlockStart;
+	if ( blocked > pt->Stats.MaxBlocked )
+		pt->Stats.MaxBlocked = blocked;
+#endif
+}
+
+// ******** Preempt ************
+// Thread pt was just made ready. Pend a switch if it outranks the
+// running thread, it runs when interrupts allow, at the end of the
+// ISR that woke it. Otherwise nothing switches before the time slice.
+// Called with interrupts disabled.
+void static Preempt(tcbType *pt){
+	if ( (pt->Priority < RunPt->Priority) || (IdlePt != NULL) )
+		SWITCH_PEND();              // with the ticks stopped, always
+}
+
+// ******** OS_RealTimeMode ************
+// Select how real-time threads are scheduled
+// Inputs:  SCHED_RM or SCHED_EDF
+// Outputs: none
+// Called before the first OS_AddRealTimeThread
+void OS_RealTimeMode(uint32_t mode){
+	RealTimeMode = mode;
+}
+
+// ******** Admissible ************
+// Schedulability test of the real-time threads plus candidate c.
+// SCHED_EDF: the density sum of Wcet/min(Deadline,Period) is at most 1.
+// SCHED_RM: response time analysis, each thread with the interference
+// of the threads with a shorter or equal period meets its deadline.
+// Outputs: 1 if the set can be scheduled
+int static Admissible(rtThread_t *c){
+	uint64_t density = 0;        // parts per million
+	uint64_t response, last, periodUs;
+	uint32_t i, j;
+	rtThread_t *ti, *tj;
+	if ( RealTimeMode == SCHED_EDF ) {
+		for ( i = 0; i <= NUMREALTIME; i++ ) {
+			ti = (i < NUMREALTIME) ? &RealTime[i] : c;
+			if ( (ti->Tcb != NULL) || (ti == c) )
+				density += ((uint64_t)ti->Wcet*1000 + ti->Deadline - 1) / ti->Deadline;
+		}
+		return density <= 1000000;
+	}
+	for ( i = 0; i <= NUMREALTIME; i++ ) {
+		ti = (i < NUMREALTIME) ? &RealTime[i] : c;
+		if ( (ti->Tcb == NULL) && (ti != c) )
+			continue;
+		response = ti->Wcet;
+		do {
+			last = response;
+			response = ti->Wcet;
+			for ( j = 0; j <= NUMREALTIME; j++ ) {
+				tj = (j < NUMREALTIME) ? &RealTime[j] : c;
+				if ( (tj == ti) || ((tj->Tcb == NULL) && (tj != c)) || (tj->Period > ti->Period) )
+					continue;
+				periodUs = (uint64_t)tj->Period*1000;
+				response += ((last + periodUs - 1) / periodUs) * tj->Wcet;
+			}
+			if ( response > (uint64_t)ti->Deadline*1000 )
+				return 0;
+		} while ( response != last );
+	}
+	return 1;
+}
+
+// ******** SetRealTimePriorities ************
+// SCHED_RM: rank the real-time threads by period, 0 for the shortest,
+// equal periods share a priority. SCHED_EDF: all at priority 0.
+// This is the base priority, mutexes held can still raise it.
+// Called with interrupts disabled.
+void static SetRealTimePriorities(void){
+	uint32_t i, j, priority;
+	tcbType *pt;
+	for ( i = 0; i < NUMREALTIME; i++ ) {
+		pt = RealTime[i].Tcb;
+		if ( pt == NULL )
+			continue;
+		priority = 0;
+		if ( RealTimeMode == SCHED_RM ) {
+			for ( j = 0; j < NUMREALTIME; j++ )
+				if ( (RealTime[j].Tcb != NULL) && (RealTime[j].Period < RealTime[i].Period) )
+					priority++;
+		}
+		pt->BasePriority = priority;
+		SetPriority(pt, HeldPriority(pt));
+	}
+}
+
+// ******** OS_AddRealTimeThread ************
+// Admit a periodic real-time thread, its first job is released now.
+// Threads that are not real-time should use priorities NUMREALTIME
+// (8) and up so they run in the time left over.
+// Inputs:  pointer to a void/void thread that runs one job and calls
+//          OS_WaitPeriod in a loop
+//          period in ms
+//          worst case execution time of a job in us
+//          relative deadline in ms, 0 means the period
+//          stack size in 32-bit words
+// Outputs: real-time thread number for OS_RealTimeStats,
+//          -1 if the set would not be schedulable or nothing is free
+int OS_AddRealTimeThread(void(*thread)(void), uint32_t period,
+                         uint32_t wcet, uint32_t deadline, uint32_t stackWords){
+	rtThread_t *rt = NULL;
+	rtThread_t candidate;
+	tcbType *pt = NULL;
+	uint32_t i;
+	uint16_t cr;
+	if ( deadline == 0 )
+		deadline = period;
+	if ( (period == 0) || (wcet == 0) || (deadline > period) )
+		return -1;
+	candidate.Tcb = NULL;
+	candidate.Period = period;
+	candidate.Wcet = wcet;
+	candidate.Deadline = deadline;
+	cr = StartCritical();
+	for ( i = 0; (i < NUMREALTIME) && (rt == NULL); i++ ) {
+		if ( RealTime[i].Tcb == NULL )
+			rt = &RealTime[i];
+	}
+	if ( (rt != NULL) && Admissible(&candidate) ) {
+		*rt = candidate;
+		rt->Release = TickCount;
+		rt->AbsDeadline = TickCount + deadline;
+		rt->Jobs = rt->Misses = 0;
+		pt = CreateThread(thread, (RealTimeMode == SCHED_EDF) ? 0 : NUMREALTIME - 1,
+		                  stackWords, rt);
+	}
+	if ( pt == NULL ) {
+		EndCritical(cr);
+		return -1;
+	}
+	rt->Tcb = pt;
+	SetRealTimePriorities();
+	EndCritical(cr);
+	return rt - RealTime;
+}
+
+// ******** OS_WaitPeriod ************
+// End the job of the running real-time thread and sleep until the
+// next release. A job finished after its deadline is a miss, so is
+// every release skipped because the job ran past it.
+// Inputs:  none
+// Outputs: none
+void OS_WaitPeriod(void){
+	rtThread_t *rt = RunPt->Rt;
+	DisableInterrupts();
+	rt->Jobs++;
+	if ( (int32_t)(TickCount - rt->AbsDeadline) > 0 )
+		rt->Misses++;
+	rt->Release += rt->Period;
+	while ( (int32_t)(TickCount - rt->Release) >= 0 ) {
+		rt->Release += rt->Period;     // overran the next release
+		rt->Misses++;
+	}
+	rt->AbsDeadline = rt->Release + rt->Deadline;
+	RunPt->Sleep = rt->Release - TickCount;
+	TRACE(TRACE_SLEEP, RunPt, RunPt->Sleep);
+	ReadyRemove(RunPt);
+	SleepInsert(RunPt, RunPt->Sleep);
+	EnableInterrupts();
+	OS_Suspend();
+}
+
+// ******** OS_RealTimeStats ************
+// Jobs and deadline misses of a real-time thread
+// Inputs:  real-time thread number from OS_AddRealTimeThread
+//          where to store the jobs finished and the misses
+// Outputs: 1 if successful, 0 if there is no such thread
+int OS_RealTimeStats(uint32_t id, uint32_t *jobs, uint32_t *misses){
+	if ( (id >= NUMREALTIME) || (RealTime[id].Tcb == NULL) )
+		return 0;
+	*jobs = RealTime[id].Jobs;
+	*misses = RealTime[id].Misses;
+	return 1;
 }
 
 //******** OS_Suspend ***************
@@ -197,10 +1009,16 @@ void Scheduler(void){      // every time slice
 // Inputs: none
 // Outputs: none
 // Will be run again depending on sleep/block status
+// With PENDSV_SWITCH the next thread gets what is left of the time
+// slice, through SysTick it gets a full one.
 void OS_Suspend(void){
+#if !PENDSV_SWITCH
   STCURRENT = 0;        // any write to current clears it
-  INTCTRL = 0x04000000; // trigger SysTick
-// next thread gets a full time slice
+#endif
+  SWITCH_PEND();        // trigger PendSV, or SysTick
+#ifdef HOST_PORT
+  Host_TakePending();   // no NVIC on the host, take the switch now
+#endif
 }
 
 // ******** OS_Sleep ************
@@ -209,32 +1027,118 @@ void OS_Suspend(void){
 // output: none
 // OS_Sleep(0) implements cooperative multitasking
 void OS_Sleep(uint32_t sleepTime){
+	DisableInterrupts();
 	RunPt->Sleep = sleepTime;   // set sleep parameter in TCB, same as Lab 3
+	TRACE(TRACE_SLEEP, RunPt, sleepTime);
+	if ( sleepTime ) {
+		ReadyRemove(RunPt);
+		SleepInsert(RunPt, sleepTime);
+	}
+	EnableInterrupts();
 	OS_Suspend();               // suspend, stops running.
 }
 
+// ******** OS_Ticks ************
+// Time since OS_Init in ms, 64 bits so it does not wrap
+// Inputs:  none
+// Outputs: ticks
+uint64_t OS_Ticks(void){
+	uint64_t ticks;
+	uint16_t cr = StartCritical();  // two words, not read atomically
+	ticks = TickCount;
+	EndCritical(cr);
+	return ticks;
+}
+
+// ******** OS_SleepUntil ************
+// Sleep until period ms after the last wake up, for a main thread
+// that runs every period ms. The wake up times do not depend on
+// how long the thread ran, so the rate does not drift.
+// Start with lastWake = OS_Ticks() before the loop.
+// Inputs:  pointer to the last wake up time, advanced by period
+//          period in ms
+// Outputs: 1 if it slept, 0 if the wake up time had passed already,
+//          then it returns at once and lastWake catches up on the
+//          next calls
+int OS_SleepUntil(uint64_t *lastWake, uint32_t period){
+	*lastWake += period;
+	DisableInterrupts();
+	if ( *lastWake <= TickCount ) {
+		EnableInterrupts();
+		return 0;
+	}
+	RunPt->Sleep = (int32_t)(*lastWake - TickCount);
+	TRACE(TRACE_SLEEP, RunPt, RunPt->Sleep);
+	ReadyRemove(RunPt);
+	SleepInsert(RunPt, RunPt->Sleep);
+	EnableInterrupts();
+	OS_Suspend();
+	return 1;
+}
+
 // ******** OS_InitSemaphore ************
-// Initialize counting semaphore
+// Initialize counting semaphore, blocked threads wake up in FIFO order
+// Inputs:  pointer to a semaphore
+//          initial value of semaphore
+// Outputs: none
+void OS_InitSemaphore(sema_t *semaPt, int32_t value){
+	OS_InitSemaphoreOrder(semaPt, value, SEMA_FIFO);
+}
+
+// ******** OS_InitSemaphoreOrder ************
+// Initialize counting semaphore with the order blocked threads wake up in
 // Inputs:  pointer to a semaphore
 //          initial value of semaphore
+//          SEMA_FIFO or SEMA_PRIORITY
 // Outputs: none
-void OS_InitSemaphore(int32_t *semaPt, int32_t value){
+void OS_InitSemaphoreOrder(sema_t *semaPt, int32_t value, uint32_t order){
 	DisableInterrupts();
-	*semaPt = value;
+	semaPt->Value = value;
+	semaPt->Head = semaPt->Tail = NULL;
+	semaPt->Order = order;
 	EnableInterrupts();
 }
 
+// ******** SemaEnqueue ************
+// Queue thread pt on semaphore semaPt, called with interrupts disabled.
+// FIFO queues append in constant time, priority queues go behind the
+// threads of the same or higher priority already blocked.
+void static SemaEnqueue(sema_t *semaPt, tcbType *pt){
+	tcbType **link;
+	pt->nextBlocked = NULL;
+	if ( semaPt->Head == NULL ) {
+		semaPt->Head = semaPt->Tail = pt;
+	}
+	else if ( (semaPt->Order == SEMA_FIFO) || (semaPt->Tail->Priority <= pt->Priority) ) {
+		semaPt->Tail->nextBlocked = pt;
+		semaPt->Tail = pt;
+	}
+	else {
+		link = &semaPt->Head;
+		while ( (*link)->Priority <= pt->Priority )
+			link = &(*link)->nextBlocked;
+		pt->nextBlocked = *link;   // never the tail, checked above
+		*link = pt;
+	}
+}
+
 // ******** OS_Wait ************
 // Decrement semaphore and block if less than zero
 // Lab2 spinlock (does not suspend while spinning)
 // Lab3 block if less than zero
 // Inputs:  pointer to a counting semaphore
 // Outputs: none
-void OS_Wait(int32_t *semaPt){
+void OS_Wait(sema_t *semaPt){
 	DisableInterrupts();
-	(*semaPt)--;
-	if ( (*semaPt) < 0 ) {
+	TRACE(TRACE_WAIT, RunPt, (uintptr_t)semaPt & 0xFFFF);
+	semaPt->Value--;
+	if ( semaPt->Value < 0 ) {
 		RunPt->Blocked = semaPt;
+#if THREAD_STATS
+		RunPt->BlockStart = CYCLE_COUNT();
+#endif
+		ReadyRemove(RunPt);
+		SemaEnqueue(semaPt, RunPt);
 		EnableInterrupts();
 		OS_Suspend();
 	}
@@ -247,25 +1151,298 @@ void OS_Wait(int32_t *semaPt){
 // Lab3 wakeup blocked thread if appropriate
 // Inputs:  pointer to a counting semaphore
 // Outputs: none
-void OS_Signal(int32_t *semaPt){
+void OS_Signal(sema_t *semaPt){
+	tcbType *pt;
+	DisableInterrupts();
+	TRACE(TRACE_SIGNAL, RunPt, (uintptr_t)semaPt & 0xFFFF);
+	semaPt->Value++;
+	if ( semaPt->Value <= 0 ) {	  // a thread is still blocked on it.
+		pt = semaPt->Head;        // head of its queue
+		semaPt->Head = pt->nextBlocked;
+		pt->Blocked = NULL;       // Wake up this thread.
+		Unblocked(pt);
+		if ( pt->Sleep == 0 ) {
+			ReadyInsert(pt);
+			Preempt(pt);
+		}
+	}
+	EnableInterrupts();
+}
+
+// **************** Mutexes ***************
+// The priority of a thread is its BasePriority raised by the mutexes it
+// holds: to the Ceiling of a MUTEX_CEILING mutex, to the highest thread
+// blocked on a MUTEX_INHERIT mutex. A mutex wakes the highest blocked
+// thread first and hands itself over to it.
+// Called with interrupts disabled.
+
+// priority thread pt runs at with the mutexes it holds
+int32_t static HeldPriority(tcbType *pt){
+	int32_t priority = pt->BasePriority;
+	mutex_t *m;
+	for ( m = pt->Held; m != NULL; m = m->nextHeld ) {
+		if ( m->Protocol == MUTEX_CEILING ) {
+			if ( m->Ceiling < priority )
+				priority = m->Ceiling;
+		}
+		else if ( (m->Wait.Head != NULL) && (m->Wait.Head->Priority < priority) )
+			priority = m->Wait.Head->Priority;
+	}
+	return priority;
+}
+
+// unlink thread pt from the queue of semaphore semaPt
+void static SemaRemove(sema_t *semaPt, tcbType *pt){
+	tcbType **link = &semaPt->Head;
+	tcbType *prev = NULL;
+	while ( *link != pt ) {
+		prev = *link;
+		link = &(*link)->nextBlocked;
+	}
+	*link = pt->nextBlocked;
+	if ( semaPt->Tail == pt )
+		semaPt->Tail = prev;
+}
+
+// run thread pt at a new priority, it moves to the ready list or to the
+// place in a priority queue that goes with it. If pt is blocked on a
+// MUTEX_INHERIT mutex, the owner of that mutex is updated in turn.
+void static SetPriority(tcbType *pt, int32_t priority){
+	mutex_t *m;
+	while ( pt->Priority != priority ) {
+		if ( pt->Blocked != NULL ) {
+			if ( pt->Blocked->Order == SEMA_PRIORITY ) {
+				SemaRemove(pt->Blocked, pt);
+				pt->Priority = priority;
+				SemaEnqueue(pt->Blocked, pt);
+			}
+			else
+				pt->Priority = priority;
+		}
+		else if ( pt->Sleep == 0 ) {
+			ReadyRemove(pt);
+			pt->Priority = priority;
+			ReadyInsert(pt);
+		}
+		else
+			pt->Priority = priority;
+		m = pt->WaitMutex;
+		if ( (m == NULL) || (m->Protocol != MUTEX_INHERIT) )
+			return;
+		pt = m->Owner;
+		priority = HeldPriority(pt);
+	}
+}
+
+// make thread pt the owner of mutex mutexPt
+void static MutexTake(mutex_t *mutexPt, tcbType *pt){
+	mutexPt->Owner = pt;
+	mutexPt->nextHeld = pt->Held;
+	pt->Held = mutexPt;
+	SetPriority(pt, HeldPriority(pt));
+}
+
+// ******** OS_InitMutex ************
+// Initialize a mutex, free
+// Inputs:  pointer to a mutex
+//          MUTEX_INHERIT or MUTEX_CEILING
+//          ceiling priority for MUTEX_CEILING, the highest priority
+//          (smallest number) of the threads that lock it
+// Outputs: none
+void OS_InitMutex(mutex_t *mutexPt, uint32_t protocol, uint32_t ceiling){
+	DisableInterrupts();
+	mutexPt->Owner = NULL;
+	mutexPt->nextHeld = NULL;
+	mutexPt->Protocol = protocol;
+	mutexPt->Ceiling = ceiling;
+	mutexPt->Wait.Value = 0;
+	mutexPt->Wait.Head = mutexPt->Wait.Tail = NULL;
+	mutexPt->Wait.Order = SEMA_PRIORITY;
+	EnableInterrupts();
+}
+
+// ******** OS_Lock ************
+// Take a mutex, block until its owner unlocks it if it is taken.
+// Under MUTEX_INHERIT the owner runs at least at the priority of this
+// thread meanwhile, under MUTEX_CEILING this thread runs at the ceiling
+// while it holds the mutex.
+// Inputs:  pointer to a mutex, not held by this thread
+// Outputs: none
+// Called by main threads only
+void OS_Lock(mutex_t *mutexPt){
+	tcbType *owner;
+	DisableInterrupts();
+	owner = mutexPt->Owner;
+	if ( owner == NULL ) {
+		MutexTake(mutexPt, RunPt);
+		EnableInterrupts();
+		return;
+	}
+	RunPt->Blocked = &mutexPt->Wait;
+#if THREAD_STATS
+	RunPt->BlockStart = CYCLE_COUNT();
+#endif
+	RunPt->WaitMutex = mutexPt;
+	ReadyRemove(RunPt);
+	SemaEnqueue(&mutexPt->Wait, RunPt);
+	if ( mutexPt->Protocol == MUTEX_INHERIT )
+		SetPriority(owner, HeldPriority(owner));
+	EnableInterrupts();
+	OS_Suspend();               // owns the mutex when it runs again
+}
+
+// ******** OS_Unlock ************
+// Release a mutex held by this thread, the highest priority thread
+// blocked on it becomes the owner and runs now if it has a higher
+// priority than this thread has left.
+// Inputs:  pointer to a mutex
+// Outputs: none
+// Nothing happens if this thread is not the owner
+void OS_Unlock(mutex_t *mutexPt){
+	mutex_t **link;
 	tcbType *pt;
 	DisableInterrupts();
-	(*semaPt)++;
-	if ( (*semaPt) < 0 ) {	  // if semaphore still less than 0.
-		pt = RunPt->next;
-		while ( pt->Blocked != semaPt )
-			pt = pt->next;
-		pt->Blocked = 0;     // Wake up this thread.
+	if ( mutexPt->Owner != RunPt ) {
+		EnableInterrupts();
+		return;
+	}
+	link = &RunPt->Held;
+	while ( *link != mutexPt )
+		link = &(*link)->nextHeld;
+	*link = mutexPt->nextHeld;
+	mutexPt->Owner = NULL;
+	pt = mutexPt->Wait.Head;
+	if ( pt != NULL ) {
+		mutexPt->Wait.Head = pt->nextBlocked;
+		pt->Blocked = NULL;
+		pt->WaitMutex = NULL;
+		Unblocked(pt);
+		ReadyInsert(pt);
+		MutexTake(mutexPt, pt);
+	}
+	SetPriority(RunPt, HeldPriority(RunPt));
+	if ( (pt != NULL) && (pt->Priority < RunPt->Priority) ) {
+		EnableInterrupts();
+		OS_Suspend();
+		return;
+	}
+	EnableInterrupts();
+}
+
+// **************** Event flags ***************
+// A thread waiting for flags is blocked on the Wait queue of the group,
+// with a timeout it is in the sleep queue as well. Whichever comes
+// first, OS_SetFlags or RunPeriodicEvents, takes it out of the other.
+
+// 1 if the flags got satisfy a wait for mask in mode
+int static FlagsMet(uint32_t got, uint32_t mask, uint32_t mode){
+	if ( mode & FLAGS_ALL )
+		return got == mask;
+	return got != 0;
+}
+
+// ******** OS_InitFlags ************
+// Initialize an event flag group
+// Inputs:  pointer to a flag group
+//          flags set to start with
+// Outputs: none
+void OS_InitFlags(flags_t *flagsPt, uint32_t bits){
+	flagsPt->Bits = bits;
+	OS_InitSemaphoreOrder(&flagsPt->Wait, 0, SEMA_PRIORITY);
+}
+
+// ******** OS_WaitFlags ************
+// Wait until any (FLAGS_ANY) or all (FLAGS_ALL) of the flags in mask
+// are set, or until timeout ms went by. With FLAGS_CLEAR, or-ed into
+// the mode, the flags it waited for are cleared as it wakes up.
+// Inputs:  pointer to a flag group
+//          flags to wait for, not 0
+//          FLAGS_ANY or FLAGS_ALL, plus FLAGS_CLEAR
+//          timeout in ms, 0 waits forever
+// Outputs: the flags of mask that were set, 0 on timeout
+// Called by main threads only
+uint32_t OS_WaitFlags(flags_t *flagsPt, uint32_t mask, uint32_t mode, uint32_t timeout){
+	uint32_t got;
+	DisableInterrupts();
+	TRACE(TRACE_WAIT, RunPt, (uintptr_t)flagsPt & 0xFFFF);
+	got = flagsPt->Bits & mask;
+	if ( FlagsMet(got, mask, mode) ) {
+		if ( mode & FLAGS_CLEAR )
+			flagsPt->Bits &= ~got;
+		EnableInterrupts();
+		return got;
+	}
+	RunPt->WaitFlags = flagsPt;
+	RunPt->FlagsMask = mask;
+	RunPt->FlagsMode = mode;
+	RunPt->Blocked = &flagsPt->Wait;
+#if THREAD_STATS
+	RunPt->BlockStart = CYCLE_COUNT();
+#endif
+	ReadyRemove(RunPt);
+	SemaEnqueue(&flagsPt->Wait, RunPt);
+	if ( timeout ) {
+		RunPt->Sleep = timeout;
+		SleepInsert(RunPt, timeout);
 	}
 	EnableInterrupts();
+	OS_Suspend();               // FlagsGot is set when it runs again
+	return RunPt->FlagsGot;
 }
 
-#define FIFOSIZE 10    // can be any size
-uint32_t PutIndex;      // index of where to put next
-uint32_t GetIndex;      // index of where to get next
+// ******** OS_SetFlags ************
+// Set flags and wake up the threads waiting for them, highest priority
+// first. A woken thread with a higher priority than the running one
+// runs next.
+// Inputs:  pointer to a flag group
+//          flags to set
+// Outputs: none
+// Can be called by main threads, event threads and ISRs
+void OS_SetFlags(flags_t *flagsPt, uint32_t bits){
+	tcbType *pt, *next;
+	uint32_t got;
+	uint16_t cr = StartCritical();
+	TRACE(TRACE_SIGNAL, RunPt, (uintptr_t)flagsPt & 0xFFFF);
+	flagsPt->Bits |= bits;
+	for ( pt = flagsPt->Wait.Head; pt != NULL; pt = next ) {
+		next = pt->nextBlocked;
+		got = flagsPt->Bits & pt->FlagsMask;
+		if ( !FlagsMet(got, pt->FlagsMask, pt->FlagsMode) )
+			continue;
+		if ( pt->FlagsMode & FLAGS_CLEAR )
+			flagsPt->Bits &= ~got;
+		SemaRemove(&flagsPt->Wait, pt);
+		if ( pt->Sleep )
+			SleepRemove(pt);        // woke up before the timeout
+		pt->FlagsGot = got;
+		pt->WaitFlags = NULL;
+		pt->Blocked = NULL;
+		Unblocked(pt);
+		ReadyInsert(pt);
+		Preempt(pt);
+	}
+	EndCritical(cr);
+}
+
+// ******** OS_ClearFlags ************
+// Clear flags
+// Inputs:  pointer to a flag group
+//          flags to clear
+// Outputs: the flags set before
+// Can be called by main threads, event threads and ISRs
+uint32_t OS_ClearFlags(flags_t *flagsPt, uint32_t bits){
+	uint32_t was;
+	uint16_t cr = StartCritical();
+	was = flagsPt->Bits;
+	flagsPt->Bits = was & ~bits;
+	EndCritical(cr);
+	return was;
+}
+
+#define FIFOSIZE 16     // power of two
+fifo_t Fifo;            // the FIFO of OS_FIFO_Init, OS_FIFO_Put and OS_FIFO_Get
 uint32_t FIFO[FIFOSIZE];
-int32_t CurrentSize;// 0 means FIFO empty, FSIZE means full
-uint32_t LostData;  // number of lost pieces of data
+uint32_t LostData;      // number of lost pieces of data
 
 
 enum FIFO_status {
@@ -273,63 +1450,124 @@ enum FIFO_status {
 	NONE = 0,
 	FULL = 1
 };
+
+// ******** OS_FIFO_Create ************
+// Initialize a FIFO object on storage owned by the caller, empty.
+// One producer, event or main thread, and one main thread
+// consumer per FIFO. Neither masks interrupts unless the
+// consumer has to block.
+// Inputs:  pointer to a FIFO
+//          storage for size entries
+//          size, a power of two
+// Outputs: 1 if successful, 0 if size is not a power of two
+int OS_FIFO_Create(fifo_t *fifoPt, uint32_t *storage, uint32_t size){
+	if ( (size == 0) || (size & (size - 1)) )
+		return 0;
+	fifoPt->Storage = storage;
+	fifoPt->Mask = size - 1;
+	fifoPt->PutIndex = fifoPt->GetIndex = EMPTY;
+	fifoPt->Want = 1;
+	OS_InitSemaphore(&fifoPt->DataReady, 0);
+	return 1;
+}
+
+// ******** OS_FIFO_PutN ************
+// Put up to n entries in a FIFO, as many as fit. The consumer
+// sees all of them at once, OS_Signal is only called when it
+// is blocked and now has the entries it waits for.
+// Inputs:  pointer to a FIFO
+//          entries to be stored
+//          number of entries
+// Outputs: number of entries put, less than n if the FIFO filled
+uint32_t OS_FIFO_PutN(fifo_t *fifoPt, const uint32_t *data, uint32_t n){
+	uint32_t put = fifoPt->PutIndex;
+	uint32_t room = fifoPt->Mask + 1 - (put - LOAD_ACQUIRE(fifoPt->GetIndex));
+	uint32_t i;
+	if ( n > room )
+		n = room;
+	for ( i = 0; i < n; i++ )
+		fifoPt->Storage[(put + i) & fifoPt->Mask] = data[i];
+	STORE_RELEASE(fifoPt->PutIndex, put + n);  // the entries are visible from here
+	TRACE(TRACE_FIFO_PUT, RunPt, n);
+	MEMORY_BARRIER();                          // PutIndex before DataReady
+	if ( (fifoPt->DataReady.Value < 0)         // the consumer is blocked
+	     && (put + n - fifoPt->GetIndex >= fifoPt->Want) )
+		OS_Signal(&fifoPt->DataReady);
+	return n;
+}
+
+// ******** OS_FIFO_GetN ************
+// Get n entries from a FIFO, block until there are n.
+// Inputs:  pointer to a FIFO
+//          where to store the entries
+//          number of entries, at most the size of the FIFO
+// Outputs: n, 0 if n is larger than the FIFO
+uint32_t OS_FIFO_GetN(fifo_t *fifoPt, uint32_t *data, uint32_t n){
+	uint32_t get = fifoPt->GetIndex;
+	uint32_t i;
+	if ( n > fifoPt->Mask + 1 )
+		return 0;
+	while ( LOAD_ACQUIRE(fifoPt->PutIndex) - get < n ) {
+		DisableInterrupts();
+		if ( fifoPt->PutIndex - get < n ) {   // a put in between would be missed
+			fifoPt->Want = n;
+			OS_Wait(&fifoPt->DataReady);
+		}
+		EnableInterrupts();
+	}
+	for ( i = 0; i < n; i++ )
+		data[i] = fifoPt->Storage[(get + i) & fifoPt->Mask];
+	STORE_RELEASE(fifoPt->GetIndex, get + n);  // the slots are free from here
+	TRACE(TRACE_FIFO_GET, RunPt, n);
+	return n;
+}
+
 // ******** OS_FIFO_Init ************
 // Initialize FIFO.  The "put" and "get" indices initially
-// are equal, which means that the FIFO is empty.  Also
-// initialize semaphores to track properties of the FIFO
-// such as size and busy status for Put and Get operations,
-// which is important if there are multiple data producers
-// or multiple data consumers.
+// are equal, which means that the FIFO is empty.
+// One producer, event or main thread, and one main thread
+// consumer. Neither masks interrupts unless the consumer
+// has to block on an empty FIFO.
 // Inputs:  none
 // Outputs: none
 void OS_FIFO_Init(void){
-	PutIndex = GetIndex = EMPTY;
-	OS_InitSemaphore(&CurrentSize, EMPTY);
+	OS_FIFO_Create(&Fifo, FIFO, FIFOSIZE);
 	LostData = NONE;
 }
 
 // ******** OS_FIFO_Put ************
-// Put an entry in the FIFO.  Consider using a unique
-// semaphore to wait on busy status if more than one thread
-// is putting data into the FIFO and there is a chance that
-// this function may interrupt itself.
+// Put an entry in the FIFO.  Exactly one thread puts,
+// it does not block or spin if full. OS_Signal is only
+// called when the consumer is blocked.
 // Inputs:  data to be stored
 // Outputs: 0 if successful, -1 if the FIFO is full
 int OS_FIFO_Put(uint32_t data){
-	if ( CurrentSize == FIFOSIZE ) {
+	if ( OS_FIFO_PutN(&Fifo, &data, 1) == 0 ) {
 		LostData++;
 		return -1;
 	}
-	else {
-		FIFO[PutIndex] = data;
-		PutIndex = (PutIndex + 1) % FIFOSIZE;
-		OS_Signal(&CurrentSize);
-	}
- return 0; // success
+	return 0;
 }
 
 // ******** OS_FIFO_Get ************
-// Get an entry from the FIFO.  Consider using a unique
-// semaphore to wait on busy status if more than one thread
-// is getting data from the FIFO and there is a chance that
-// this function may interrupt itself.
+// Get an entry from the FIFO.  Exactly one main thread
+// gets, it blocks if empty.
 // Inputs:  none
 // Outputs: data retrieved
 uint32_t OS_FIFO_Get(void){
 	uint32_t data;
-	OS_Wait(&CurrentSize);	  // Block if empty
-	data = FIFO[GetIndex];	  // Retreive data. 
-	GetIndex = (GetIndex + 1) % FIFOSIZE;
- return data;
+	OS_FIFO_GetN(&Fifo, &data, 1);
+	return data;
 }
 // *****periodic events****************
-int32_t *PeriodicSemaphore0;
+sema_t *PeriodicSemaphore0;
 uint32_t Period0; // time between signals
-int32_t *PeriodicSemaphore1;
+sema_t *PeriodicSemaphore1;
 uint32_t Period1; // time between signals
 
+// OS_Signal pends the scheduler only if it woke a thread of higher
+// priority than the one interrupted
 void RealTimeEvents(void){
-	int flag = 0;
     static int32_t realCount = -10; // let all the threads execute once
   // Note to students: we had to let the system run for a time so all user threads ran at least one
   // before signalling the periodic tasks
@@ -337,15 +1575,10 @@ void RealTimeEvents(void){
   if(realCount >= 0){
 	if((realCount % Period0) == 0){
 		OS_Signal(PeriodicSemaphore0);
-		flag = 1;
 	}
     if((realCount % Period1) == 0){
 	 	OS_Signal(PeriodicSemaphore1);
-	 	flag = 1;
 	 }
-    if(flag){
-	 	OS_Suspend();
-    }
   }
 }
 // ******** OS_PeriodTrigger0_Init ************
@@ -354,7 +1587,7 @@ void RealTimeEvents(void){
 //          period in ms
 // priority level at 0 (highest
 // Outputs: none
-void OS_PeriodTrigger0_Init(int32_t *semaPt, uint32_t period){
+void OS_PeriodTrigger0_Init(sema_t *semaPt, uint32_t period){
 	PeriodicSemaphore0 = semaPt;
 	Period0 = period;
 	BSP_PeriodicTask_InitC(&RealTimeEvents, 1000, 0);
@@ -365,25 +1598,125 @@ void OS_PeriodTrigger0_Init(int32_t *semaPt, uint32_t period){
 //          period in ms
 // priority level at 0 (highest
 // Outputs: none
-void OS_PeriodTrigger1_Init(int32_t *semaPt, uint32_t period){
+void OS_PeriodTrigger1_Init(sema_t *semaPt, uint32_t period){
 	PeriodicSemaphore1 = semaPt;
 	Period1 = period;
 	BSP_PeriodicTask_InitC(&RealTimeEvents, 1000, 0);
 }
 
+// **************** Tickless idle ***************
+// OS_Idle stops SysTick while its caller is the only ready thread, and
+// RunPeriodicEvents stretches its own period on the next tick: one
+// interrupt every TickStep ticks, the largest divisor of TIMER_FREQ
+// that does not pass the first sleeper. A thread made ready ends it,
+// on a tick in RunPeriodicEvents, or between ticks in Scheduler after
+// an ISR woke it up.
+// The timer restarts its period when it is programmed, the time from
+// when its interrupt was due adds up in TickLag and RunPeriodicEvents
+// counts it as whole ticks, so TickCount keeps up with the cycle count.
+#if TICKLESS
+
+// 1 if thread pt is the only one ready
+int static AloneReady(tcbType *pt){
+	return (ReadyMask == (0x80000000 >> pt->Priority)) && (pt->nextReady == pt);
+}
+
+// whole ticks out of TickLag, OS_Init sets TickCycles before the
+// timer starts, a tick can come while the threads are added
+uint32_t static TickLagged(void){
+	uint32_t ticks;
+	if ( TickLag < (int32_t)TickCycles )
+		return 0;
+	ticks = (uint32_t)TickLag / TickCycles;
+	TickLag -= ticks*TickCycles;
+	return ticks;
+}
+
+// restart the timer at one interrupt every step ticks
+void static TickRestart(uint32_t step){
+	uint32_t now = CYCLE_COUNT();
+	TickLag += (int32_t)(now - TickDue);
+	TickDue = now;
+	TickStep = step;
+	BSP_PeriodicTask_Init(&RunPeriodicEvents, TIMER_FREQ/step, TIMER_PRIORITY);
+}
+
+// program the longest step that wakes up the first sleeper on time,
+// TIMER_FREQ ticks at most
+void static TickStretch(void){
+	uint32_t step = TIMER_FREQ;
+	if ( (SleepList != NULL) && (SleepList->SleepDelta < step) )
+		step = SleepList->SleepDelta;
+	while ( TIMER_FREQ % step )
+		step--;
+	if ( step != TickStep )
+		TickRestart(step);
+}
+
+// count the whole ticks of the step gone by, between two interrupts.
+// They are fewer than TickStep so no sleeper is due yet.
+void static TickCatchUp(void){
+	int32_t gone = (int32_t)(CYCLE_COUNT() - TickDue);
+	uint32_t ticks;
+	if ( (TickStep == 1) || (gone < (int32_t)TickCycles) )
+		return;
+	ticks = (uint32_t)gone / TickCycles;
+	if ( ticks >= TickStep )
+		ticks = TickStep - 1;       // its interrupt is on the way
+	TickDue += ticks*TickCycles;
+	TickCount += ticks;
+	if ( SleepList != NULL )
+		SleepList->SleepDelta -= ticks;
+}
+
+// back to a tick every ms and the time slice, the time to the next
+// tick left over from the step goes to TickLag
+void static TickResume(void){
+	if ( TickStep > 1 )
+		TickRestart(1);
+	IdlePt = NULL;
+	STCURRENT = 0;
+	STCTRL = 0x00000007;
+	SYSTICK_UPDATE();
+}
+#endif
+
+// ******** OS_Idle ************
+// Wait for an interrupt, called over and over by the lowest priority
+// thread. With TICKLESS, while no other thread is ready and no
+// OS_PeriodTrigger runs, the time slice and the idle ticks stop until
+// the first sleeper is due or an ISR wakes a thread. OS_Ticks lags by
+// up to one step in the meantime.
+// Inputs:  none
+// Outputs: none
+void OS_Idle(void){
+	DisableInterrupts();
+#if TICKLESS
+	if ( (IdlePt == NULL) && AloneReady(RunPt)
+	     && (PeriodicSemaphore0 == NULL) && (PeriodicSemaphore1 == NULL) ) {
+		IdlePt = RunPt;
+		STCTRL = 0;                 // nobody to share the time slice with
+		SYSTICK_UPDATE();
+	}
+#endif
+	WaitForInterrupt();             // wakes up on an interrupt pending
+	EnableInterrupts();             // it runs here
+}
+
 //****edge-triggered event************
-int32_t *edgeSemaphore;
+sema_t *edgeSemaphore;
 #define PORTD_PIN6  0x40
 // ******** OS_EdgeTrigger_Init ************
 // Initialize button1, PD6, to signal on a falling edge interrupt
 // Inputs:  semaphore to signal
 //          priority
 // Outputs: none
-void OS_EdgeTrigger_Init(int32_t *semaPt, uint8_t priority){
+void OS_EdgeTrigger_Init(sema_t *semaPt, uint8_t priority){
 	volatile uint32_t delay;
 	edgeSemaphore = semaPt;
 	SYSCTL_RCGCGPIO_R = 0x08;      // 1) activate clock for Port D
 	delay = SYSCTL_RCGCGPIO_R;    // allow time for clock to stabilize
+	(void)delay;
 	GPIO_PORTD_AMSEL_R &= ~PORTD_PIN6;   // 3) disable analog on PD6
 	GPIO_PORTD_DIR_R &= ~PORTD_PIN6;      // 4) configure PD6 as GPIO
 	GPIO_PORTD_AFSEL_R &= ~PORTD_PIN6;    // 6) disable alt funct on PD6
@@ -395,7 +1728,7 @@ void OS_EdgeTrigger_Init(int32_t *semaPt, uint8_t priority){
 	GPIO_PORTD_ICR_R |= PORTD_PIN6;       // (e) clear PD6 flag
 	GPIO_PORTD_IM_R |= PORTD_PIN6;        // (f) arm interrupt on PD6
 	NVIC_PRI0_R = (NVIC_PRI0_R & 0x0FFFFFFF) | (priority << 29);      // priority on Port D edge trigger is NVIC_PRI0_R	31  29
-    NVIC_EN0_R |= 0x00000004;      // enable is bit 3 in NVIC_EN0_R
+    NVIC_EN0_R |= 0x00000008;      // enable is bit 3 in NVIC_EN0_R
  }
 
 // ******** OS_EdgeTrigger_Restart ************
@@ -407,17 +1740,17 @@ void OS_EdgeTrigger_Init(int32_t *semaPt, uint8_t priority){
 // Outputs: none
 void OS_EdgeTrigger_Restart(void){
 	GPIO_PORTD_ICR_R |= PORTD_PIN6;
-	NVIC_EN0_R |= 0x00000004;
+	NVIC_EN0_R |= 0x00000008;
 }
 
 // ************ GPIOPortD_Handler ************
 // step 1 acknowledge by clearing flag
-// step 2 signal semaphore (no need to run scheduler)
+// step 2 signal semaphore, it runs the scheduler if that is needed
 // step 3 disarm interrupt to prevent bouncing to create multiple signals
 void GPIOPortD_Handler(void){
 	GPIO_PORTD_ICR_R |= PORTD_PIN6;
 	OS_Signal(edgeSemaphore);
-	NVIC_EN0_R &= ~0x00000004;
+	NVIC_EN0_R &= ~0x00000008;
 }
 
 
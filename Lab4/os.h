@@ -28,6 +28,116 @@
 #ifndef __OS_H
 #define __OS_H  1
 
+// ******** Semaphore ************
+// Counting semaphore that owns the queue of the threads blocked on it,
+// a negative Value is minus the number of threads in the queue.
+// SEMA_FIFO wakes threads in the order they blocked, SEMA_PRIORITY
+// wakes the highest priority first (FIFO among equal priorities).
+#define SEMA_FIFO       0
+#define SEMA_PRIORITY   1
+struct tcb;
+typedef struct sema{
+  int32_t Value;       // semaphore count
+  struct tcb *Head;    // next thread to wake up, NULL if none blocked
+  struct tcb *Tail;    // last thread to wake up
+  uint32_t Order;      // SEMA_FIFO or SEMA_PRIORITY
+} sema_t;
+
+// ******** Mutex ************
+// Lock owned by the thread that took it, only the owner unlocks it.
+// Threads blocked on it wait in priority order. MUTEX_INHERIT raises
+// the owner to the priority of the highest thread blocked on it,
+// MUTEX_CEILING raises the owner to Ceiling as soon as it locks.
+#define MUTEX_INHERIT   0
+#define MUTEX_CEILING   1
+typedef struct mutex{
+  struct tcb *Owner;       // NULL if free
+  sema_t Wait;             // threads blocked on it, SEMA_PRIORITY
+  uint32_t Protocol;       // MUTEX_INHERIT or MUTEX_CEILING
+  int32_t Ceiling;         // priority of the owner under MUTEX_CEILING
+  struct mutex *nextHeld;  // other mutexes of the owner
+} mutex_t;
+
+// ******** Event flags ************
+// 32 flag bits, set by any thread, event thread or ISR. Threads wait
+// for any or all of a mask, in priority order. FLAGS_CLEAR clears the
+// bits a thread waited for as it wakes up, so it consumes them.
+#define FLAGS_ANY       0
+#define FLAGS_ALL       1
+#define FLAGS_CLEAR     2
+typedef struct flags{
+  uint32_t Bits;       // flags set
+  sema_t Wait;         // threads blocked on it, SEMA_PRIORITY
+} flags_t;
+
+// ******** FIFO ************
+// Ring of Mask+1 entries on storage owned by the caller, one producer
+// and one consumer. PutIndex and GetIndex count the entries put and
+// got, only the producer writes PutIndex and only the consumer GetIndex.
+typedef struct fifo{
+  uint32_t *Storage;   // Mask+1 entries
+  uint32_t Mask;       // size - 1, the size is a power of two
+  uint32_t PutIndex;   // entries put
+  uint32_t GetIndex;   // entries got
+  uint32_t Want;       // entries the blocked consumer waits for
+  sema_t DataReady;    // -1 while the consumer is blocked
+} fifo_t;
+
+// ******** Thread statistics ************
+// Filled in by OS_GetStats. Times are in bus cycles of the cycle
+// counter, stamped at every context switch. Releases are the wake ups
+// from OS_Sleep, OS_SleepUntil and OS_WaitPeriod, the release latency
+// is the time from the wake up until the thread runs. Jitter[0] counts
+// latencies under 1 us, Jitter[k] the ones from 2^(k-1) to 2^k us,
+// the last bin everything longer.
+#define JITTERBINS  16
+typedef struct threadStats{
+  uint32_t Priority;     // priority it runs at now
+  uint64_t RunCycles;    // time it was running
+  uint32_t Switches;     // times it was switched in
+  uint32_t MaxBlocked;   // longest time blocked on a semaphore or mutex
+  uint32_t Releases;     // wake ups from a sleep
+  uint32_t MaxLatency;   // longest release latency
+  uint32_t Jitter[JITTERBINS];  // release latency histogram
+} threadStats_t;
+
+
+// ******** Kernel trace ************
+// Built with TRACE_ENTRIES, a power of two, the kernel logs events into
+// the RAM ring Trace, 8 bytes each. Index counts the records written,
+// the last TRACE_ENTRIES of them are in the ring. A dump of Trace from
+// the debugger, or the file the host builds write, is turned into a
+// Chrome/Perfetto timeline by host/TraceJson.c.
+// Time:   cycle count, Clock cycles per second
+// Thread: TCB number, the interrupted thread for event threads,
+//         TRACE_NOTHREAD if none
+// Arg:    TRACE_SWITCH_IN/OUT  priority
+//         TRACE_WAIT/SIGNAL    low 16 bits of the semaphore address
+//         TRACE_FIFO_PUT/GET   entries moved
+//         TRACE_SLEEP          ms, at most 0xFFFF
+//         TRACE_RELEASE        0
+#define TRACE_SWITCH_IN   1
+#define TRACE_SWITCH_OUT  2
+#define TRACE_WAIT        3
+#define TRACE_SIGNAL      4
+#define TRACE_FIFO_PUT    5
+#define TRACE_FIFO_GET    6
+#define TRACE_SLEEP       7
+#define TRACE_RELEASE     8
+#define TRACE_NOTHREAD    0xFF
+#define TRACE_MAGIC       0x45435254    // "TRCE"
+typedef struct traceRecord{
+  uint32_t Time;
+  uint8_t Event;
+  uint8_t Thread;
+  uint16_t Arg;
+} traceRecord_t;
+typedef struct traceHeader{
+  uint32_t Magic;      // TRACE_MAGIC
+  uint32_t Entries;    // ring size in records
+  uint32_t Clock;      // cycles per second
+  uint32_t Index;      // records written
+} traceHeader_t;       // followed by Entries records
 
 // ******** OS_Init ************
 // Initialize operating system, disable interrupts
@@ -52,6 +162,90 @@ int OS_AddThreads(void(*thread0)(void), uint32_t p0,
                   void(*thread6)(void), uint32_t p6,
                   void(*thread7)(void), uint32_t p7);
 
+//******** OS_AddThread ***************
+// Add one main thread to the scheduler with the default stack size
+// Inputs: function pointer to a void/void main thread
+//         priority (0 highest, 31 lowest)
+// Outputs: 1 if successful, 0 if this thread can not be added
+int OS_AddThread(void(*thread)(void), uint32_t priority);
+
+//******** OS_CreateThread ***************
+// Create a main thread, before OS_Launch or at run time
+// TCBs come from a pool of NUMTHREADS, stacks from a shared pool
+// Inputs: function pointer to a void/void main thread
+//         priority (0 highest, 31 lowest)
+//         stack size in 32-bit words, at least 32 are given. A thread
+//         that uses the FPU needs 34 more for its switch frame.
+// Outputs: 1 if successful, 0 if no TCB or no stack is free
+// Not to be called by event threads
+int OS_CreateThread(void(*thread)(void), uint32_t priority, uint32_t stackWords);
+
+//******** OS_Kill ***************
+// Kill the running thread, its TCB and stack can be reused
+// Inputs: none
+// Outputs: none (does not return)
+void OS_Kill(void);
+
+// ******** OS_RealTimeMode ************
+// Select how real-time threads are scheduled, SCHED_RM (default)
+// gives them fixed priorities by period, SCHED_EDF runs the one with
+// the earliest absolute deadline
+// Inputs:  SCHED_RM or SCHED_EDF
+// Outputs: none
+// Called before the first OS_AddRealTimeThread
+#define SCHED_RM   0
+#define SCHED_EDF  1
+void OS_RealTimeMode(uint32_t mode);
+
+// ******** OS_AddRealTimeThread ************
+// Admit a periodic real-time thread, the set of real-time threads must
+// pass the response time test (SCHED_RM) or the utilization test
+// (SCHED_EDF). Its first job is released now.
+// Real-time threads take priorities 0 to 7, other threads should use
+// priorities 8 and up.
+// Inputs:  pointer to a void/void thread that runs one job and calls
+//          OS_WaitPeriod in a loop
+//          period in ms
+//          worst case execution time of a job in us
+//          relative deadline in ms, at most the period, 0 means the period
+//          stack size in 32-bit words
+// Outputs: real-time thread number, -1 if the set would not be
+//          schedulable or no TCB, stack or real-time entry is free
+int OS_AddRealTimeThread(void(*thread)(void), uint32_t period,
+                         uint32_t wcet, uint32_t deadline, uint32_t stackWords);
+
+// ******** OS_WaitPeriod ************
+// Called by a real-time thread at the end of each job, sleeps until
+// the next release
+// Inputs:  none
+// Outputs: none
+void OS_WaitPeriod(void);
+
+// ******** OS_GetStats ************
+// CPU time, switches, blocking and release latency of a thread,
+// collected since it was created, all 0 but the priority if os.c is
+// built with THREAD_STATS 0
+// Inputs:  thread, 0 to NUMTHREADS-1 in the TCB pool
+//          where to store the statistics
+// Outputs: 1 if successful, 0 if there is no such thread alive
+int OS_GetStats(uint32_t thread, threadStats_t *stats);
+
+// ******** OS_StackHighWater ************
+// Most stack words a thread has used since it was created, ISRs that
+// interrupted it included, to size its OS_CreateThread stack. The
+// lowest word of every stack is a guard checked on every switch, an
+// overwritten guard stops the system (StackOverflowPt in os.c).
+// On the host the threads run on host stacks and use none.
+// Inputs:  thread, 0 to NUMTHREADS-1 in the TCB pool
+// Outputs: words used, 0 if there is no such thread alive
+uint32_t OS_StackHighWater(uint32_t thread);
+
+// ******** OS_RealTimeStats ************
+// Jobs and deadline misses of a real-time thread
+// Inputs:  real-time thread number from OS_AddRealTimeThread
+//          where to store the jobs finished and the misses
+// Outputs: 1 if successful, 0 if there is no such thread
+int OS_RealTimeStats(uint32_t id, uint32_t *jobs, uint32_t *misses);
 
 //******** OS_Launch ***************
 // Start the scheduler, enable interrupts
@@ -74,12 +268,47 @@ void OS_Suspend(void);
 // OS_Sleep(0) implements cooperative multitasking
 void OS_Sleep(uint32_t sleepTime);
 
+// ******** OS_Ticks ************
+// Time since OS_Init in ms, 64 bits so it does not wrap
+// Inputs:  none
+// Outputs: ticks
+uint64_t OS_Ticks(void);
+
+// ******** OS_SleepUntil ************
+// Sleep until period ms after the last wake up, for a main thread
+// that runs every period ms. The wake up times do not depend on
+// how long the thread ran, so the rate does not drift.
+// Start with lastWake = OS_Ticks() before the loop.
+// Inputs:  pointer to the last wake up time, advanced by period
+//          period in ms
+// Outputs: 1 if it slept, 0 if the wake up time had passed already,
+//          then it returns at once and lastWake catches up on the
+//          next calls
+int OS_SleepUntil(uint64_t *lastWake, uint32_t period);
+
+// ******** OS_Idle ************
+// Wait for an interrupt, called over and over by the lowest priority
+// thread. With TICKLESS, while no other thread is ready and no
+// OS_PeriodTrigger runs, the time slice and the idle ticks stop until
+// the first sleeper is due or an ISR wakes a thread.
+// Inputs:  none
+// Outputs: none
+void OS_Idle(void);
+
 // ******** OS_InitSemaphore ************
-// Initialize counting semaphore
+// Initialize counting semaphore, blocked threads wake up in FIFO order
+// Inputs:  pointer to a semaphore
+//          initial value of semaphore
+// Outputs: none
+void OS_InitSemaphore(sema_t *semaPt, int32_t value);
+
+// ******** OS_InitSemaphoreOrder ************
+// Initialize counting semaphore with the order blocked threads wake up in
 // Inputs:  pointer to a semaphore
 //          initial value of semaphore
+//          SEMA_FIFO or SEMA_PRIORITY
 // Outputs: none
-void OS_InitSemaphore(int32_t *semaPt, int32_t value);
+void OS_InitSemaphoreOrder(sema_t *semaPt, int32_t value, uint32_t order);
 
 // ******** OS_Wait ************
 // Decrement semaphore and block if less than zero
@@ -87,41 +316,132 @@ void OS_InitSemaphore(int32_t *semaPt, int32_t value);
 // Lab3 block if less than zero
 // Inputs:  pointer to a counting semaphore
 // Outputs: none
-void OS_Wait(int32_t *semaPt);
+void OS_Wait(sema_t *semaPt);
 
 // ******** OS_Signal ************
 // Increment semaphore
 // Lab2 spinlock
 // Lab3 wakeup blocked thread if appropriate
+// Lab4 switch to it right away if it has a higher priority
 // Inputs:  pointer to a counting semaphore
 // Outputs: none
-void OS_Signal(int32_t *semaPt);
+void OS_Signal(sema_t *semaPt);
+
+// ******** OS_InitMutex ************
+// Initialize a mutex, free
+// Inputs:  pointer to a mutex
+//          MUTEX_INHERIT or MUTEX_CEILING
+//          ceiling priority for MUTEX_CEILING, the highest priority
+//          (smallest number) of the threads that lock it
+// Outputs: none
+void OS_InitMutex(mutex_t *mutexPt, uint32_t protocol, uint32_t ceiling);
+
+// ******** OS_Lock ************
+// Take a mutex, block until its owner unlocks it if it is taken.
+// Under MUTEX_INHERIT the owner runs at least at the priority of this
+// thread meanwhile, under MUTEX_CEILING this thread runs at the ceiling
+// while it holds the mutex.
+// Inputs:  pointer to a mutex, not held by this thread
+// Outputs: none
+// Called by main threads only
+void OS_Lock(mutex_t *mutexPt);
+
+// ******** OS_Unlock ************
+// Release a mutex held by this thread, the highest priority thread
+// blocked on it becomes the owner and runs now if it has a higher
+// priority than this thread has left.
+// Inputs:  pointer to a mutex
+// Outputs: none
+// Nothing happens if this thread is not the owner
+void OS_Unlock(mutex_t *mutexPt);
+
+// ******** OS_InitFlags ************
+// Initialize an event flag group
+// Inputs:  pointer to a flag group
+//          flags set to start with
+// Outputs: none
+void OS_InitFlags(flags_t *flagsPt, uint32_t bits);
+
+// ******** OS_WaitFlags ************
+// Wait until any (FLAGS_ANY) or all (FLAGS_ALL) of the flags in mask
+// are set, or until timeout ms went by. With FLAGS_CLEAR, or-ed into
+// the mode, the flags it waited for are cleared as it wakes up.
+// Inputs:  pointer to a flag group
+//          flags to wait for, not 0
+//          FLAGS_ANY or FLAGS_ALL, plus FLAGS_CLEAR
+//          timeout in ms, 0 waits forever
+// Outputs: the flags of mask that were set, 0 on timeout
+// Called by main threads only
+uint32_t OS_WaitFlags(flags_t *flagsPt, uint32_t mask, uint32_t mode, uint32_t timeout);
+
+// ******** OS_SetFlags ************
+// Set flags and wake up the threads waiting for them, highest priority
+// first. A woken thread with a higher priority than the running one
+// runs next.
+// Inputs:  pointer to a flag group
+//          flags to set
+// Outputs: none
+// Can be called by main threads, event threads and ISRs
+void OS_SetFlags(flags_t *flagsPt, uint32_t bits);
+
+// ******** OS_ClearFlags ************
+// Clear flags
+// Inputs:  pointer to a flag group
+//          flags to clear
+// Outputs: the flags set before
+// Can be called by main threads, event threads and ISRs
+uint32_t OS_ClearFlags(flags_t *flagsPt, uint32_t bits);
+
+// ******** OS_FIFO_Create ************
+// Initialize a FIFO object on storage owned by the caller, empty.
+// One producer, event or main thread, and one main thread
+// consumer per FIFO. Neither masks interrupts unless the
+// consumer has to block.
+// Inputs:  pointer to a FIFO
+//          storage for size entries
+//          size, a power of two
+// Outputs: 1 if successful, 0 if size is not a power of two
+int OS_FIFO_Create(fifo_t *fifoPt, uint32_t *storage, uint32_t size);
+
+// ******** OS_FIFO_PutN ************
+// Put up to n entries in a FIFO, as many as fit. The consumer
+// sees all of them at once, OS_Signal is only called when it
+// is blocked and now has the entries it waits for.
+// Inputs:  pointer to a FIFO
+//          entries to be stored
+//          number of entries
+// Outputs: number of entries put, less than n if the FIFO filled
+uint32_t OS_FIFO_PutN(fifo_t *fifoPt, const uint32_t *data, uint32_t n);
+
+// ******** OS_FIFO_GetN ************
+// Get n entries from a FIFO, block until there are n.
+// Inputs:  pointer to a FIFO
+//          where to store the entries
+//          number of entries, at most the size of the FIFO
+// Outputs: n, 0 if n is larger than the FIFO
+uint32_t OS_FIFO_GetN(fifo_t *fifoPt, uint32_t *data, uint32_t n);
 
 // ******** OS_FIFO_Init ************
 // Initialize FIFO.  The "put" and "get" indices initially
-// are equal, which means that the FIFO is empty.  Also
-// initialize semaphores to track properties of the FIFO
-// such as size and busy status for Put and Get operations,
-// which is important if there are multiple data producers
-// or multiple data consumers.
+// are equal, which means that the FIFO is empty.
+// One producer, event or main thread, and one main thread
+// consumer. Neither masks interrupts unless the consumer
+// has to block on an empty FIFO.
 // Inputs:  none
 // Outputs: none
 void OS_FIFO_Init(void);
 
 // ******** OS_FIFO_Put ************
-// Put an entry in the FIFO.  Consider using a unique
-// semaphore to wait on busy status if more than one thread
-// is putting data into the FIFO and there is a chance that
-// this function may interrupt itself.
+// Put an entry in the FIFO.  Exactly one thread puts,
+// it does not block or spin if full. OS_Signal is only
+// called when the consumer is blocked.
 // Inputs:  data to be stored
 // Outputs: 0 if successful, -1 if the FIFO is full
 int OS_FIFO_Put(uint32_t data);
 
 // ******** OS_FIFO_Get ************
-// Get an entry from the FIFO.  Consider using a unique
-// semaphore to wait on busy status if more than one thread
-// is getting data from the FIFO and there is a chance that
-// this function may interrupt itself.
+// Get an entry from the FIFO.  Exactly one main thread
+// gets, it blocks if empty.
 // Inputs:  none
 // Outputs: data retrieved
 uint32_t OS_FIFO_Get(void);
@@ -132,7 +452,7 @@ uint32_t OS_FIFO_Get(void);
 //          period in ms
 // priority level at 0 (highest)
 // Outputs: none
-void OS_PeriodTrigger0_Init(int32_t *semaPt, uint32_t period);
+void OS_PeriodTrigger0_Init(sema_t *semaPt, uint32_t period);
 
 // ******** OS_PeriodTrigger1_Init ************
 // Initialize periodic timer interrupt to signal 
@@ -140,14 +460,14 @@ void OS_PeriodTrigger0_Init(int32_t *semaPt, uint32_t period);
 //          period in ms
 // priority level at 0 (highest)
 // Outputs: none
-void OS_PeriodTrigger1_Init(int32_t *semaPt, uint32_t period);
+void OS_PeriodTrigger1_Init(sema_t *semaPt, uint32_t period);
 
 // ******** OS_EdgeTrigger_Init ************
 // Initialize button1, PD6, to signal on a falling edge interrupt
 // Inputs:  semaphore to signal
 //          priority
 // Outputs: none
-void OS_EdgeTrigger_Init(int32_t *semaPt, uint8_t priority);
+void OS_EdgeTrigger_Init(sema_t *semaPt, uint8_t priority);
 
 // ******** OS_EdgeTrigger_Restart ************
 // restart button1 to signal on a falling edge interrupt
@@ -15,21 +15,40 @@
         EXTERN  RunPt            ; currently running thread
         EXPORT  StartOS
         EXPORT  SysTick_Handler
+        EXPORT  PendSV_Handler
         IMPORT  Scheduler
 
 
+; PendSV_Handler runs the same switch, pended by OS_Suspend and by the
+; ISRs that make a thread ready. SysTick and PendSV both have priority 7,
+; neither one interrupts the other.
+; The EXC_RETURN in LR is saved with R4-R11, bit 4 clear means the thread
+; used the FPU and the core stacked S0-S15,FPSCR (lazily). Only then are
+; S16-S31 saved and restored, other threads pay for the test alone.
+PendSV_Handler
 SysTick_Handler                ; 1) Saves R0-R3,R12,LR,PC,PSR
     CPSID   I                  ; 2) Prevent interrupt during switching
+    IF {TARGET_FPU_VFP}
+    TST     LR, #0x10          ;    EXC_RETURN bit 4 clear, FPU thread
+    IT      EQ
+    VPUSHEQ {S16-S31}
+    ENDIF
 	PUSH    {R4-R11}
+	PUSH    {R0, LR}           ;    EXC_RETURN, R0 keeps 8 byte alignment
     LDR     R0, =RunPt         
 	LDR     R1, [R0]
 	STR     SP, [R1]
-	PUSH    {R0, LR}
 	BL      Scheduler
-	POP     {R0, LR}
+    LDR     R0, =RunPt
 	LDR     R1, [R0]
 	LDR     SP, [R1]
+	POP     {R0, LR}           ;    EXC_RETURN of the new thread
 	POP     {R4-R11}
+    IF {TARGET_FPU_VFP}
+    TST     LR, #0x10
+    IT      EQ
+    VPOPEQ  {S16-S31}
+    ENDIF
     CPSIE   I                  ; 9) tasks run with interrupts enabled
     BX      LR                 ; 10) restore R0-R3,R12,LR,PC,PSR
 
@@ -38,6 +57,7 @@ StartOS
 	LDR  	R0, =RunPt
 	LDR     R2, [R0]
 	LDR     SP, [R2]
+	ADD     SP, SP, #8        ; discard padding and EXC_RETURN, no FPU state yet
 	POP     {R4-R11}
 	POP     {R0-R3}
 	POP     {R12}
@@ -27,6 +27,14 @@
 #define ERROR                   1           // Value returned if failure
 #define NOERROR                 0           // Value returned if success
 
+// Flash is memory mapped on target, reads go through FLASH_PTR so
+// the host build can redirect them to its image file
+#ifdef HOST_PORT
+#define FLASH_PTR(addr)         Flash_Map(addr)
+#else
+#define FLASH_PTR(addr)         ((const uint8_t *)(addr))
+#endif
+
 //------------Flash_Init------------
 // This function was critical to the write and erase
 // operations of the flash memory on the LM3S811
@@ -76,3 +84,23 @@ int Flash_FastWrite(uint32_t *source, uint32_t addr, uint16_t count);
 // Output: 'NOERROR' if successful, 'ERROR' if fail (defined in FlashProgram.h)
 // Note: disables interrupts while erasing
 int Flash_Erase(uint32_t addr);
+
+#ifdef HOST_PORT
+//------------Flash_Map------------
+// Host only, see host/FlashProgram.c
+// Input: addr flash memory address inside the image
+// Output: pointer to the byte of the image holding addr
+const uint8_t *Flash_Map(uint32_t addr);
+
+//------------Flash_Time------------
+// Host only, target time charged for writes and erases so far
+// Input: none
+// Output: usec
+double Flash_Time(void);
+
+//------------Flash_Report------------
+// Host only, print write, erase and wear counts
+// Input: none
+// Output: none
+void Flash_Report(void);
+#endif
@@ -67,15 +67,16 @@ enum DRESULT eDisk_Init(uint32_t drive){
 enum DRESULT eDisk_ReadSector(
     uint8_t *buff,     // Pointer to a RAM buffer into which to store
     uint8_t sector){   // sector number to read from
-	uint32_t start_addr, *addressPt;
+	uint32_t start_addr;
+	const uint8_t *addressPt;
 	uint16_t i, sector_size = 512;
     start_addr = EDISK_ADDR_MIN + sector_size * sector; // starting ROM address of the sector is EDISK_ADDR_MIN + 512*sector
-	addressPt = start_addr;
+	addressPt = FLASH_PTR(start_addr);
 	if ( start_addr > EDISK_ADDR_MAX )		   // return RES_PARERR if EDISK_ADDR_MIN + 512*sector > EDISK_ADDR_MAX
 		return RES_PARERR;
 	else {									   // copy 512 bytes from ROM (disk) into RAM (buff)
 		for ( i = 0; i < sector_size; i++ ) {
-			buff[i] = (uint8_t)(*addressPt);
+			buff[i] = *addressPt;
 			addressPt++;
 		}
 	}				   
@@ -100,8 +101,8 @@ enum DRESULT eDisk_WriteSector(
 	start_addr = EDISK_ADDR_MIN + sector_size * sector;
 	if ( start_addr > EDISK_ADDR_MAX )       // return RES_PARERR if EDISK_ADDR_MIN + 512*sector > EDISK_ADDR_MAX
 		return RES_PARERR;
-	else                                     // write 512 bytes from RAM (buff) into ROM (disk)
-		Flash_WriteArray(buff, start_addr, sector_size);
+	else if ( Flash_WriteArray((uint32_t *)buff, start_addr, sector_size/4) != sector_size/4 )
+		return RES_ERROR;                    // write 512 bytes from RAM (buff) into ROM (disk), 128 words
     return RES_OK;
 }
 
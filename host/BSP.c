@@ -0,0 +1,610 @@
+/********************************************************************
+*	Filename:    BSP.c
+*
+*	Description: Host implementation of the BSP.h stand-in.
+*				 - The periodic tasks are interrupt sources of
+*				   host/CortexM.c fired by POSIX interval timers.
+*				 - Sensors replay streams of samples. A sample is picked
+*				   by target time, so a stream recorded at 1 kHz is
+*				   replayed at 1 kHz whatever the application polls at,
+*				   and HOST_SPEEDUP runs the streams and the timers
+*				   faster than real time together. Streams loop.
+*				 - A falling edge of button 1 runs GPIOPortD_Handler when
+*				   the application armed PD6, as OS_EdgeTrigger_Init does.
+*				 - LCD routines count calls and the pixels the ST7735
+*				   driver would send, the cost of a frame on target.
+*
+*				 Trace file (BSP_TRACE), one sample per line:
+*				   # comment
+*				   rate <stream> <samples per second>
+*				   mic <10-bit>
+*				   accel <x> <y> <z>            10-bit each
+*				   light <lux*100>
+*				   temp <sensorV> <localT>      156.25 nV, 0.00001 C
+*				   button1 <0 pressed, 1 released>
+*				   button2 <0 pressed, 1 released>
+*				 Streams missing from the trace use synthetic signals.
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <signal.h>
+#include "BSP.h"
+#include "CortexM.h"
+#include "Texas.h"
+#include "tm4c123gh6pm.h"
+
+#define BUS_CLOCK          80000000   // TM4C123 bus clock with the PLL at 80 MHz
+#define LIGHT_CONVERSION   800        // ms, OPT3001 conversion time
+#define TEMP_CONVERSION    1000       // ms, TMP006 with 4 samples averaged
+#define LCD_WIDTH          128
+#define LCD_HEIGHT         128
+#define CHAR_PIXELS        (6*8)      // 5x7 font with spacing
+#define PLOT_HEIGHT        100        // rows of the plot area under the text
+#define MAX_VALUES         3
+#define BUTTON_POLL        1000       // Hz, sampling of the button trace for edges
+#define PORTD_PIN6         0x40       // button 1
+
+// results of the application the report shows when they are linked in
+extern uint32_t LostTask1Data __attribute__((weak));
+extern uint32_t LostData __attribute__((weak));
+int OS_ThreadCycles(uint32_t thread, uint64_t *cycles) __attribute__((weak));
+int OS_PeriodicEventStats(uint32_t event, uint32_t *phase, uint32_t *runs, uint32_t *delay,
+                          uint32_t *jitter) __attribute__((weak));
+void GPIOPortD_Handler(void) __attribute__((weak));
+
+static uint32_t ClockFrequency = 16000000;   // PIOSC out of reset
+static uint64_t StartTime;                   // host nsec at program start
+static int Used;                             // a sensor or the LCD is in use
+
+//------------ sensor streams ------------
+enum streams { MIC, ACCEL, LIGHT, TEMP, BUTTON1, BUTTON2, STREAMS };
+
+typedef struct {
+	const char *name;
+	int width;              // values per sample
+	uint32_t rate;          // samples per second of target time
+	int32_t *samples;       // width values per sample, NULL for synthetic
+	uint32_t count;
+	uint32_t size;          // allocated samples
+	uint32_t reads;         // samples taken by the application
+} stream_t;
+
+static stream_t Streams[STREAMS] = {
+	{ "mic",     1, 1000 },
+	{ "accel",   3, 100 },
+	{ "light",   1, 10 },
+	{ "temp",    2, 10 },
+	{ "button1", 1, 100 },
+	{ "button2", 1, 100 },
+};
+
+//------------ LCD counters ------------
+enum lcdCalls { FILLSCREEN, FILLRECT, PIXEL, LINE, BITMAP, CHAR, STRING,
+	NUMBER, DRAWAXES, PLOTPOINT, PLOTINCREMENT, LCDCALLS };
+
+static const char *LCDNames[LCDCALLS] = { "FillScreen", "FillRect", "DrawPixel",
+	"DrawFastLine", "DrawBitmap", "DrawChar", "DrawString", "OutNumber",
+	"Drawaxes", "PlotPoint", "PlotIncrement" };
+static uint32_t LCDCount[LCDCALLS];
+static uint64_t LCDPixels[LCDCALLS];
+
+static uint32_t RGBCount, BuzzerCount;
+static uint64_t LightStart, TempStart;        // target nsec of a conversion start
+static int32_t LastButton1 = 1;
+
+static uint64_t HostTime(void){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec*1000000000u + (uint64_t)now.tv_nsec;
+}
+
+// target nsec since start
+static uint64_t TargetTime(void){
+	return (uint64_t)((HostTime() - StartTime) * Host_Speedup());
+}
+
+// synthetic signals used when the trace has no such stream
+static void Synthesize(int stream, double t, int32_t *values){
+	switch ( stream ) {
+	case MIC:      // 50 Hz tone
+		values[0] = 512 + (int32_t)(300*sin(2*M_PI*50*t));
+		break;
+	case ACCEL:    // walking at 2 steps per second
+		values[0] = 512;
+		values[1] = 512;
+		values[2] = 700 + (int32_t)(150*sin(2*M_PI*2*t));
+		break;
+	case LIGHT:    // slow daylight drift around 400 lux
+		values[0] = 40000 + (int32_t)(20000*sin(2*M_PI*t/60));
+		break;
+	case TEMP:     // 25 C drifting by half a degree
+		values[0] = 0;
+		values[1] = 2500000 + (int32_t)(50000*sin(2*M_PI*t/120));
+		break;
+	case BUTTON1:  // pressed for 200 ms every 5 s
+		values[0] = (fmod(t, 5.0) < 0.2) ? 0 : 1;
+		break;
+	case BUTTON2:  // pressed for 200 ms every 7 s
+		values[0] = (fmod(t, 7.0) < 0.2) ? 0 : 1;
+		break;
+	}
+}
+
+// sample of a stream at target time t in nsec, not counted
+static void StreamPeek(int stream, uint64_t t, int32_t *values){
+	stream_t *s = &Streams[stream];
+	uint64_t index;
+	if ( s->count == 0 ) {
+		Synthesize(stream, t/1e9, values);
+		return;
+	}
+	index = (t / 1000) * s->rate / 1000000 % s->count;
+	memcpy(values, &s->samples[index*s->width], s->width*sizeof(int32_t));
+}
+
+// sample of a stream read by the application
+static void StreamSample(int stream, uint64_t t, int32_t *values){
+	Streams[stream].reads++;
+	StreamPeek(stream, t, values);
+}
+
+static stream_t *StreamFind(const char *name){
+	int i;
+	for ( i = 0; i < STREAMS; i++ ) {
+		if ( strcmp(Streams[i].name, name) == 0 ) {
+			return &Streams[i];
+		}
+	}
+	return NULL;
+}
+
+static void TraceLoad(const char *path){
+	FILE *file = fopen(path, "r");
+	char line[256], name[32];
+	int32_t values[MAX_VALUES];
+	unsigned rate, number = 0;
+	int fields;
+	stream_t *s;
+	if ( file == NULL ) {
+		perror(path);
+		exit(1);
+	}
+	while ( fgets(line, sizeof(line), file) ) {
+		number++;
+		if ( (line[0] == '#') || (sscanf(line, "%31s", name) != 1) ) {
+			continue;
+		}
+		if ( strcmp(name, "rate") == 0 ) {
+			if ( (sscanf(line, "rate %31s %u", name, &rate) != 2) ||
+			     ((s = StreamFind(name)) == NULL) || (rate == 0) ) {
+				fprintf(stderr, "%s:%u: bad rate\n", path, number);
+				exit(1);
+			}
+			s->rate = rate;
+			continue;
+		}
+		s = StreamFind(name);
+		fields = sscanf(line, "%*s %d %d %d", &values[0], &values[1], &values[2]);
+		if ( (s == NULL) || (fields < s->width) ) {
+			fprintf(stderr, "%s:%u: bad sample\n", path, number);
+			exit(1);
+		}
+		if ( s->count == s->size ) {
+			s->size = s->size ? 2*s->size : 1024;
+			s->samples = realloc(s->samples, s->size*s->width*sizeof(int32_t));
+			if ( s->samples == NULL ) {
+				fprintf(stderr, "BSP: out of memory\n");
+				exit(1);
+			}
+		}
+		memcpy(&s->samples[s->count*s->width], values, s->width*sizeof(int32_t));
+		s->count++;
+	}
+	fclose(file);
+}
+
+// edge detector of PD6, the NVIC enable and priority are the ones
+// the application wrote to NVIC_EN0_R and NVIC_PRI0_R (Port D is IRQ 3)
+static void ButtonPoll(void){
+	int32_t button1;
+	StreamPeek(BUTTON1, TargetTime(), &button1);
+	if ( LastButton1 && !button1 ) {
+		GPIO_PORTD_RIS_R |= PORTD_PIN6;
+	}
+	LastButton1 = button1;
+	if ( (GPIO_PORTD_RIS_R & PORTD_PIN6) && (GPIO_PORTD_IM_R & PORTD_PIN6) &&
+	     (NVIC_EN0_R & 0x08) ) {
+		GPIO_PORTD_RIS_R &= ~PORTD_PIN6;
+		Host_InterruptInit(HOST_GPIO_D, &GPIOPortD_Handler, NVIC_PRI0_R >> 29);
+		Host_InterruptTrigger(HOST_GPIO_D);   // taken after this handler returns
+	}
+}
+
+static void StopRun(void){
+	exit(0);              // BSP_Report runs from atexit
+}
+
+// Ctrl-C ends the run like HOST_SECONDS does
+static void Interrupt(int sig){
+	(void)sig;
+	Host_InterruptTrigger(HOST_STOP);
+}
+
+__attribute__((constructor)) static void HostInit(void){
+	const char *env;
+	double seconds;
+	StartTime = HostTime();
+	env = getenv("BSP_TRACE");
+	if ( env && *env ) {
+		TraceLoad(env);
+	}
+	if ( GPIOPortD_Handler ) {
+		Host_InterruptInit(HOST_BUTTONS, &ButtonPoll, 0);
+		Host_InterruptPeriod(HOST_BUTTONS, 1000000000u / BUTTON_POLL);
+	}
+	Host_InterruptInit(HOST_STOP, &StopRun, 0);
+	signal(SIGINT, &Interrupt);
+	env = getenv("HOST_SECONDS");
+	if ( env && ((seconds = strtod(env, NULL)) > 0) ) {
+		Host_InterruptPeriod(HOST_STOP, (uint64_t)(seconds*1e9*Host_Speedup()));
+	}
+}
+
+static void Use(void){
+	if ( !Used ) {
+		Used = 1;
+		atexit(&BSP_Report);
+	}
+}
+
+//------------ clock and timers ------------
+void BSP_Clock_InitFastest(void){
+	ClockFrequency = BUS_CLOCK;
+}
+
+uint32_t BSP_Clock_GetFreq(void){
+	return ClockFrequency;
+}
+
+static void PeriodicTaskInit(int source, void(*task)(void), uint32_t freq, uint8_t priority){
+	if ( (freq == 0) || (freq > 10000) ) {
+		return;           // same range as the target timers
+	}
+	Host_InterruptInit(source, task, priority);
+	Host_InterruptPeriod(source, 1000000000u / freq);
+}
+
+void BSP_PeriodicTask_Init(void(*task)(void), uint32_t freq, uint8_t priority){
+	PeriodicTaskInit(HOST_TIMER_A, task, freq, priority);
+}
+
+void BSP_PeriodicTask_Stop(void){
+	Host_InterruptPeriod(HOST_TIMER_A, 0);
+}
+
+void BSP_PeriodicTask_InitB(void(*task)(void), uint32_t freq, uint8_t priority){
+	PeriodicTaskInit(HOST_TIMER_B, task, freq, priority);
+}
+
+void BSP_PeriodicTask_StopB(void){
+	Host_InterruptPeriod(HOST_TIMER_B, 0);
+}
+
+void BSP_PeriodicTask_InitC(void(*task)(void), uint32_t freq, uint8_t priority){
+	PeriodicTaskInit(HOST_TIMER_C, task, freq, priority);
+}
+
+void BSP_PeriodicTask_StopC(void){
+	Host_InterruptPeriod(HOST_TIMER_C, 0);
+}
+
+void BSP_Delay1ms(uint32_t n){
+	uint64_t end = TargetTime() + (uint64_t)n*1000000u;
+	while ( TargetTime() < end ) {
+	}
+}
+
+//------------ buttons, LED and buzzer ------------
+void BSP_Button1_Init(void){
+	Use();
+}
+
+uint8_t BSP_Button1_Input(void){
+	int32_t value;
+	StreamSample(BUTTON1, TargetTime(), &value);
+	return value ? 0x40 : 0;     // PD6 on target
+}
+
+void BSP_Button2_Init(void){
+	Use();
+}
+
+uint8_t BSP_Button2_Input(void){
+	int32_t value;
+	StreamSample(BUTTON2, TargetTime(), &value);
+	return value ? 0x80 : 0;     // PD7 on target
+}
+
+void BSP_RGB_Init(uint16_t red, uint16_t green, uint16_t blue){
+	BSP_RGB_Set(red, green, blue);
+}
+
+void BSP_RGB_Set(uint16_t red, uint16_t green, uint16_t blue){
+	(void)red;
+	(void)green;
+	(void)blue;
+	RGBCount++;
+}
+
+void BSP_Buzzer_Init(uint16_t duty){
+	BSP_Buzzer_Set(duty);
+}
+
+void BSP_Buzzer_Set(uint16_t duty){
+	(void)duty;
+	BuzzerCount++;
+}
+
+//------------ sensors ------------
+void BSP_Accelerometer_Init(void){
+	Use();
+}
+
+void BSP_Accelerometer_Input(uint16_t *x, uint16_t *y, uint16_t *z){
+	int32_t values[MAX_VALUES];
+	StreamSample(ACCEL, TargetTime(), values);
+	*x = values[0];
+	*y = values[1];
+	*z = values[2];
+}
+
+void BSP_Microphone_Init(void){
+	Use();
+}
+
+void BSP_Microphone_Input(uint16_t *mic){
+	int32_t value;
+	StreamSample(MIC, TargetTime(), &value);
+	*mic = value;
+}
+
+void BSP_LightSensor_Init(void){
+	Use();
+}
+
+void BSP_LightSensor_Start(void){
+	LightStart = TargetTime();
+}
+
+int BSP_LightSensor_End(uint32_t *light){
+	int32_t value;
+	uint64_t now = TargetTime();
+	if ( now - LightStart < (uint64_t)LIGHT_CONVERSION*1000000u ) {
+		return 0;
+	}
+	StreamSample(LIGHT, now, &value);
+	*light = value;
+	return 1;
+}
+
+uint32_t BSP_LightSensor_Input(void){
+	uint32_t light;
+	BSP_LightSensor_Start();
+	while ( BSP_LightSensor_End(&light) == 0 ) {
+	}
+	return light;
+}
+
+void BSP_TempSensor_Init(void){
+	Use();
+}
+
+void BSP_TempSensor_Start(void){
+	TempStart = TargetTime();
+}
+
+int BSP_TempSensor_End(int32_t *sensorV, int32_t *localT){
+	int32_t values[MAX_VALUES];
+	uint64_t now = TargetTime();
+	if ( now - TempStart < (uint64_t)TEMP_CONVERSION*1000000u ) {
+		return 0;
+	}
+	StreamSample(TEMP, now, values);
+	*sensorV = values[0];
+	*localT = values[1];
+	return 1;
+}
+
+void BSP_TempSensor_Input(int32_t *sensorV, int32_t *localT){
+	BSP_TempSensor_Start();
+	while ( BSP_TempSensor_End(sensorV, localT) == 0 ) {
+	}
+}
+
+//------------ LCD ------------
+static void Draw(int call, uint64_t pixels){
+	LCDCount[call]++;
+	LCDPixels[call] += pixels;
+}
+
+static uint32_t Digits(uint32_t n){
+	uint32_t digits = 1;
+	while ( n >= 10 ) {
+		n /= 10;
+		digits++;
+	}
+	return digits;
+}
+
+void BSP_LCD_Init(void){
+	Use();
+}
+
+uint16_t BSP_LCD_Color565(uint8_t r, uint8_t g, uint8_t b){
+	return ((b & 0xF8) << 8) | ((g & 0xFC) << 3) | (r >> 3);
+}
+
+uint16_t BSP_LCD_SwapColor(uint16_t x){
+	return (x << 11) | (x & 0x07E0) | (x >> 11);
+}
+
+void BSP_LCD_DrawPixel(int16_t x, int16_t y, uint16_t color){
+	(void)x; (void)y; (void)color;
+	Draw(PIXEL, 1);
+}
+
+void BSP_LCD_DrawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color){
+	(void)x; (void)y; (void)color;
+	Draw(LINE, h > 0 ? h : 0);
+}
+
+void BSP_LCD_DrawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color){
+	(void)x; (void)y; (void)color;
+	Draw(LINE, w > 0 ? w : 0);
+}
+
+void BSP_LCD_FillScreen(uint16_t color){
+	(void)color;
+	Draw(FILLSCREEN, LCD_WIDTH*LCD_HEIGHT);
+}
+
+void BSP_LCD_FillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color){
+	(void)x; (void)y; (void)color;
+	Draw(FILLRECT, (w > 0 && h > 0) ? (uint64_t)w*h : 0);
+}
+
+void BSP_LCD_DrawBitmap(int16_t x, int16_t y, const uint16_t *image, int16_t w, int16_t h){
+	(void)x; (void)y; (void)image;
+	Draw(BITMAP, (w > 0 && h > 0) ? (uint64_t)w*h : 0);
+}
+
+void BSP_LCD_DrawCharS(int16_t x, int16_t y, char c, int16_t textColor, int16_t bgColor, uint8_t size){
+	(void)x; (void)y; (void)c; (void)textColor; (void)bgColor;
+	Draw(CHAR, CHAR_PIXELS*size*size);
+}
+
+void BSP_LCD_DrawChar(int16_t x, int16_t y, char c, int16_t textColor, int16_t bgColor, uint8_t size){
+	(void)x; (void)y; (void)c; (void)textColor; (void)bgColor;
+	Draw(CHAR, CHAR_PIXELS*size*size);
+}
+
+uint32_t BSP_LCD_DrawString(uint16_t x, uint16_t y, char *pt, int16_t textColor){
+	uint32_t length = strlen(pt);
+	(void)x; (void)y; (void)textColor;
+	Draw(STRING, (uint64_t)CHAR_PIXELS*length);
+	return length;
+}
+
+void BSP_LCD_SetCursor(uint32_t newX, uint32_t newY){
+	(void)newX; (void)newY;
+}
+
+void BSP_LCD_OutUDec(uint32_t n, int16_t textColor){
+	(void)textColor;
+	Draw(NUMBER, CHAR_PIXELS*Digits(n));
+}
+
+void BSP_LCD_OutUDec4(uint32_t n, int16_t textColor){
+	(void)n; (void)textColor;
+	Draw(NUMBER, CHAR_PIXELS*4);
+}
+
+void BSP_LCD_OutUDec5(uint32_t n, int16_t textColor){
+	(void)n; (void)textColor;
+	Draw(NUMBER, CHAR_PIXELS*5);
+}
+
+void BSP_LCD_OutUFix2_1(uint32_t n, int16_t textColor){
+	(void)n; (void)textColor;
+	Draw(NUMBER, CHAR_PIXELS*4);
+}
+
+void BSP_LCD_OutUHex2(uint32_t n, int16_t textColor){
+	(void)n; (void)textColor;
+	Draw(NUMBER, CHAR_PIXELS*2);
+}
+
+void BSP_LCD_Drawaxes(uint16_t axisColor, uint16_t bgColor, char *xLabel,
+  char *yLabel1, uint16_t label1Color, char *yLabel2, uint16_t label2Color,
+  int32_t ymax, int32_t ymin){
+	(void)axisColor; (void)bgColor; (void)label1Color; (void)label2Color;
+	(void)ymax; (void)ymin;
+	// clear the plot area, two axis lines and the labels
+	Draw(DRAWAXES, LCD_WIDTH*PLOT_HEIGHT + LCD_WIDTH + PLOT_HEIGHT +
+	     (uint64_t)CHAR_PIXELS*(strlen(xLabel) + strlen(yLabel1) + strlen(yLabel2)));
+}
+
+void BSP_LCD_PlotPoint(int32_t data1, uint16_t color1){
+	(void)data1; (void)color1;
+	Draw(PLOTPOINT, 4);          // 2x2 dot
+}
+
+void BSP_LCD_PlotIncrement(void){
+	Draw(PLOTINCREMENT, PLOT_HEIGHT);   // clear the next column
+}
+
+//------------ report ------------
+void BSP_Report(void){
+	double host = (HostTime() - StartTime)/1e9;
+	double target = host*Host_Speedup();
+	uint64_t calls = 0, pixels = 0;
+	int i;
+	printf("BSP report: %.2f s host, %.2f s target (speedup %g)\n", host, target, Host_Speedup());
+	printf("%-14s %10s %12s\n", "sensor", "samples", "per s");
+	for ( i = 0; i < STREAMS; i++ ) {
+		if ( Streams[i].reads ) {
+			printf("%-14s %10u %12.1f%s\n", Streams[i].name, (unsigned)Streams[i].reads,
+			       Streams[i].reads/target, Streams[i].count ? "" : "  (synthetic)");
+		}
+	}
+	printf("%-14s %10s %12s\n", "TExaS task", "calls", "per s");
+	for ( i = 0; i < TEXAS_TASKS; i++ ) {
+		if ( TExaS_Count[i] ) {
+			printf("Task%-10d %10u %12.1f\n", i, (unsigned)TExaS_Count[i], TExaS_Count[i]/target);
+		}
+	}
+	printf("%-14s %10s %12s %12s\n", "LCD call", "calls", "pixels", "pixels/s");
+	for ( i = 0; i < LCDCALLS; i++ ) {
+		if ( LCDCount[i] ) {
+			printf("%-14s %10u %12llu %12.0f\n", LCDNames[i], (unsigned)LCDCount[i],
+			       (unsigned long long)LCDPixels[i], LCDPixels[i]/target);
+			calls += LCDCount[i];
+			pixels += LCDPixels[i];
+		}
+	}
+	printf("%-14s %10llu %12llu %12.0f\n", "total", (unsigned long long)calls,
+	       (unsigned long long)pixels, pixels/target);
+	printf("RGB sets %u, buzzer sets %u\n", (unsigned)RGBCount, (unsigned)BuzzerCount);
+	if ( &LostTask1Data ) {
+		printf("LostTask1Data %u\n", (unsigned)LostTask1Data);
+	}
+	if ( &LostData ) {
+		printf("FIFO LostData %u\n", (unsigned)LostData);
+	}
+	if ( OS_PeriodicEventStats ) {
+		uint32_t phase, runs, delay, jitter;
+		printf("%-14s %10s %12s %12s %12s\n", "periodic event", "phase", "runs", "delay us", "jitter us");
+		for ( i = 0; OS_PeriodicEventStats(i, &phase, &runs, &delay, &jitter); i++ ) {
+			printf("%-14d %10u %12u %12.1f %12.1f\n", i, (unsigned)phase, (unsigned)runs,
+			       delay * 1e6 / BSP_Clock_GetFreq(), jitter * 1e6 / BSP_Clock_GetFreq());
+		}
+	}
+	if ( OS_ThreadCycles ) {
+		uint64_t cycles, total = 0;
+		for ( i = 0; OS_ThreadCycles(i, &cycles); i++ ) {
+			total += cycles;
+		}
+		printf("%-14s %10s %12s\n", "thread, idle last", "CPU ms", "CPU %");
+		for ( i = 0; OS_ThreadCycles(i, &cycles); i++ ) {
+			printf("%-14d %10.1f %12.1f\n", i, cycles * 1e3 / BSP_Clock_GetFreq(),
+			       total ? 100.0*cycles/total : 0.0);
+		}
+	}
+}
@@ -0,0 +1,301 @@
+/********************************************************************
+*	Filename:    CortexM.c
+*
+*	Description: Host emulation of the Cortex-M interrupt model for the
+*				 Lab kernels. Each interrupt source has a handler, an NVIC
+*				 priority and an optional POSIX interval timer delivering
+*				 SIGRTMIN. A signal only sets the pending bit of its
+*				 source, the handlers run when PRIMASK is clear and no
+*				 other handler is active, highest priority first. Handlers
+*				 do not nest, a source raised by a handler is taken after
+*				 it returns, like a tail-chained exception.
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include "CortexM.h"
+#include "BSP.h"
+
+#define PENDSTSET   0x04000000  // INTCTRL bit pending SysTick
+#define PENDSVSET   0x10000000  // INTCTRL bit pending PendSV
+#define PENDSET     (PENDSTSET | PENDSVSET)
+#define COUNTFLAG   0x00010000  // STCTRL bit SysTick counted down to 0
+
+volatile uint32_t STCTRL;
+volatile uint32_t STRELOAD;
+volatile uint32_t STCURRENT;
+volatile uint32_t INTCTRL;
+volatile uint32_t SYSPRI1;
+volatile uint32_t SYSPRI2;
+volatile uint32_t SYSPRI3;
+
+typedef struct {
+	void (*handler)(void);
+	uint8_t priority;
+	int hasTimer;
+	timer_t timer;
+	uint64_t period;        // host nsec, 0 stopped
+} hostSource_t;
+
+static hostSource_t Sources[HOST_SOURCES];
+static volatile sig_atomic_t Primask;        // interrupts enabled out of reset
+static volatile sig_atomic_t InHandler;      // a handler is running
+static volatile uint32_t Pending;            // one bit per source
+static int SignalReady;
+static double Speedup;
+static int MaskTiming;
+static uint64_t MaskStart;                   // 0 when no section is timed
+volatile uint32_t Host_MaskCount;
+volatile uint64_t Host_MaskNs;
+volatile uint32_t Host_MaskMaxNs;
+volatile uint32_t Host_InterruptCount[HOST_SOURCES];
+volatile uint64_t Host_SleepNs;
+volatile uint32_t Host_SignalLateMaxNs[HOST_SOURCES];
+
+#define barrier()   __asm volatile("" ::: "memory")
+
+// atomic with respect to the signal handler
+static void SetPending(uint32_t bits){
+	__atomic_or_fetch(&Pending, bits, __ATOMIC_SEQ_CST);
+}
+
+// highest priority pending source, -1 if none
+static int NextSource(void){
+	uint32_t pending = Pending;
+	int source, best = -1;
+	if ( INTCTRL & PENDSTSET ) {
+		INTCTRL &= ~PENDSTSET;
+		SetPending(1u << HOST_SYSTICK);
+		pending = Pending;
+	}
+	if ( INTCTRL & PENDSVSET ) {
+		INTCTRL &= ~PENDSVSET;
+		SetPending(1u << HOST_PENDSV);
+		pending = Pending;
+	}
+	for ( source = 0; source < HOST_SOURCES; source++ ) {
+		if ( (pending & (1u << source)) &&
+		     ((best < 0) || (Sources[source].priority < Sources[best].priority)) ) {
+			best = source;
+		}
+	}
+	return best;
+}
+
+void Host_TakePending(void){
+	int source;
+	do {
+		if ( Primask || InHandler ) {
+			return;
+		}
+		InHandler = 1;
+		barrier();
+		while ( !Primask && ((source = NextSource()) >= 0) ) {
+			__atomic_and_fetch(&Pending, ~(1u << source), __ATOMIC_SEQ_CST);
+			Host_InterruptCount[source]++;
+			if ( Sources[source].handler ) {
+				Sources[source].handler();   // SysTick_Handler may switch threads here
+			}
+		}
+		barrier();
+		InHandler = 0;
+		barrier();
+	} while ( !Primask && (Pending || (INTCTRL & PENDSET)) );  // a signal may land after the scan
+}
+
+void Host_ExceptionReturn(void){
+	InHandler = 0;
+	EnableInterrupts();
+}
+
+// time since the expiry that sent this signal: the interval timer is
+// due again in it_value, a period after it, plus the expiries merged
+static void SignalLate(int source, int overrun){
+	struct itimerspec spec;
+	uint64_t period = Sources[source].period, left, late;
+	if ( (period == 0) || timer_gettime(Sources[source].timer, &spec) ) {
+		return;
+	}
+	left = (uint64_t)spec.it_value.tv_sec * 1000000000u + (uint64_t)spec.it_value.tv_nsec;
+	if ( (left == 0) || (left > period) ) {
+		return;                   // stopped or restarted since
+	}
+	late = (uint64_t)((period - left + (uint64_t)overrun * period) * Host_Speedup());
+	if ( late > Host_SignalLateMaxNs[source] ) {
+		Host_SignalLateMaxNs[source] = (late > 0xFFFFFFFF) ? 0xFFFFFFFF : (uint32_t)late;
+	}
+}
+
+static void SignalHandler(int sig, siginfo_t *info, void *context){
+	int saved = errno;
+	(void)sig;
+	(void)context;
+	if ( info->si_code == SI_TIMER ) {
+		SignalLate(info->si_value.sival_int, info->si_overrun);
+	}
+	if ( info->si_value.sival_int == HOST_SYSTICK ) {
+		__atomic_or_fetch(&STCTRL, COUNTFLAG, __ATOMIC_SEQ_CST);
+	}
+	SetPending(1u << info->si_value.sival_int);
+	Host_TakePending();
+	errno = saved;
+}
+
+static void SignalInit(void){
+	struct sigaction action;
+	if ( SignalReady ) {
+		return;
+	}
+	action.sa_sigaction = SignalHandler;
+	action.sa_flags = SA_SIGINFO | SA_RESTART;
+	sigemptyset(&action.sa_mask);
+	if ( sigaction(SIGRTMIN, &action, NULL) ) {
+		perror("sigaction");
+		exit(1);
+	}
+	SignalReady = 1;
+}
+
+void Host_InterruptInit(int source, void(*handler)(void), uint8_t priority){
+	Sources[source].handler = handler;
+	Sources[source].priority = priority & 0x07;
+}
+
+double Host_Speedup(void){
+	const char *env;
+	if ( Speedup == 0 ) {
+		env = getenv("HOST_SPEEDUP");
+		Speedup = env ? strtod(env, NULL) : 1.0;
+		if ( !(Speedup > 0) ) {
+			Speedup = 1.0;
+		}
+	}
+	return Speedup;
+}
+
+void Host_InterruptPeriod(int source, uint64_t period){
+	struct sigevent event;
+	struct itimerspec spec;
+	SignalInit();
+	if ( period ) {
+		period = (uint64_t)(period / Host_Speedup());
+		if ( period < 1000 ) {
+			period = 1000;        // sped up too far, 1 usec is the host floor
+		}
+	}
+	if ( !Sources[source].hasTimer ) {
+		event.sigev_notify = SIGEV_SIGNAL;
+		event.sigev_signo = SIGRTMIN;
+		event.sigev_value.sival_int = source;
+		if ( timer_create(CLOCK_MONOTONIC, &event, &Sources[source].timer) ) {
+			perror("timer_create");
+			exit(1);
+		}
+		Sources[source].hasTimer = 1;
+	}
+	Sources[source].period = period;
+	spec.it_interval.tv_sec = period / 1000000000u;
+	spec.it_interval.tv_nsec = period % 1000000000u;
+	spec.it_value = spec.it_interval;
+	timer_settime(Sources[source].timer, 0, &spec, NULL);
+	__atomic_and_fetch(&Pending, ~(1u << source), __ATOMIC_SEQ_CST);  // an expiry of the old period is dropped, as the timer init on the target clears its flag
+}
+
+void Host_SysTickControl(void){
+	uint64_t period = 0;
+	if ( STCTRL & 0x01 ) {
+		period = (uint64_t)(STRELOAD + 1) * 1000000000u / BSP_Clock_GetFreq();
+	}
+	Host_InterruptPeriod(HOST_SYSTICK, period);
+}
+
+void Host_InterruptTrigger(int source){
+	SetPending(1u << source);
+	Host_TakePending();
+}
+
+uint32_t Host_CycleCount(void){
+	struct timespec now;
+	double ns;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ns = ((double)now.tv_sec * 1e9 + now.tv_nsec) * Host_Speedup();
+	return (uint32_t)(uint64_t)(ns * (BSP_Clock_GetFreq() / 1e9));
+}
+
+static uint64_t MaskNow(void){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+void Host_MaskTiming(int on){
+	MaskStart = 0;
+	if ( on ) {
+		Host_MaskCount = 0;
+		Host_MaskNs = 0;
+		Host_MaskMaxNs = 0;
+	}
+	MaskTiming = on;
+}
+
+void DisableInterrupts(void){
+	int start = MaskTiming && !Primask && !InHandler;
+	Primask = 1;
+	barrier();
+	if ( start ) {
+		MaskStart = MaskNow();    // no handler can run from here on
+	}
+}
+
+void EnableInterrupts(void){
+	uint64_t masked;
+	barrier();
+	if ( MaskStart ) {
+		masked = MaskNow() - MaskStart;
+		MaskStart = 0;
+		Host_MaskCount++;
+		Host_MaskNs += masked;
+		if ( masked > Host_MaskMaxNs ) {
+			Host_MaskMaxNs = (uint32_t)masked;
+		}
+	}
+	Primask = 0;
+	barrier();
+	if ( Pending || (INTCTRL & PENDSET) ) {
+		Host_TakePending();
+	}
+}
+
+long StartCritical(void){
+	long sr = Primask;
+	DisableInterrupts();
+	return sr;
+}
+
+void EndCritical(long sr){
+	if ( !sr ) {
+		EnableInterrupts();
+	}
+}
+
+void WaitForInterrupt(void){
+	sigset_t block, old, wait;
+	sigemptyset(&block);
+	sigaddset(&block, SIGRTMIN);
+	sigprocmask(SIG_BLOCK, &block, &old);
+	if ( !Pending ) {
+		uint64_t start = MaskNow();
+		wait = old;
+		sigdelset(&wait, SIGRTMIN);
+		sigsuspend(&wait);         // the handler runs in here
+		Host_SleepNs += MaskNow() - start;
+	}
+	sigprocmask(SIG_SETMASK, &old, NULL);
+}
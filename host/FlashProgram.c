@@ -0,0 +1,222 @@
+/********************************************************************
+*	Filename:    FlashProgram.c
+*
+*	Description: Host backend of Lab5/FlashProgram.h. Flash Bank1
+*				 (0x00020000 to 0x0003FFFF, the eDisk range) is a 128 KB
+*				 image file mapped with mmap(), so the disk survives the
+*				 process like flash survives a reset. NOR rules apply:
+*				 - a write only clears bits, the stored word is the AND of
+*				   the old and the new data, as on the TM4C123,
+*				 - only a 1 KB block erase sets bits back to 1.
+*				 Each operation is charged a target time cost, the totals
+*				 and the erase count of every block are kept for
+*				 Flash_Report(). Environment variables:
+*				 FLASH_IMAGE     image file, default build/flash.img, as make
+*				 FLASH_WORD_US   cost of Flash_Write per word, default
+*				                 67.8 (678 usec to write 10 words)
+*				 FLASH_FAST_US   cost of Flash_FastWrite per word, 33.5
+*				 FLASH_ERASE_US  cost of a 1 KB block erase, 15000
+*				 FLASH_STALL     1 to also spend the cost in target time
+*				                 with interrupts disabled, as on target
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include "FlashProgram.h"
+#include "CortexM.h"
+
+#define FLASH_BASE      0x00020000  // first address of the image
+#define FLASH_SIZE      0x00020000  // 128 KB, Flash Bank1
+#define FLASH_BLOCK     1024        // erase block
+#define FLASH_BLOCKS    (FLASH_SIZE/FLASH_BLOCK)
+
+static uint8_t *Image;             // mmap of the image file
+static double WordCost = 67.8;     // usec, Flash_Write and Flash_WriteArray
+static double FastCost = 33.5;     // usec per word, Flash_FastWrite
+static double EraseCost = 15000;   // usec per 1 KB block
+static int Stall;
+
+static struct {
+	uint32_t writes;               // words written
+	uint32_t fastWrites;           // words written by Flash_FastWrite
+	uint32_t lostBits;             // writes that tried to set a cleared bit
+	uint32_t erases;
+	uint32_t blockErases[FLASH_BLOCKS];
+	double time;                   // usec of target time charged
+} Stats;
+
+static double EnvCost(const char *name, double value){
+	const char *env = getenv(name);
+	return (env && *env) ? strtod(env, NULL) : value;
+}
+
+// Spend the cost of an operation. On target the CPU waits for the
+// flash controller with interrupts disabled.
+static void Charge(double usec){
+	struct timespec now;
+	double end;
+	Stats.time += usec;
+	if ( Stall ) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		end = now.tv_sec*1e6 + now.tv_nsec/1e3 + usec/Host_Speedup();
+		do {
+			clock_gettime(CLOCK_MONOTONIC, &now);
+		} while ( now.tv_sec*1e6 + now.tv_nsec/1e3 < end );
+	}
+}
+
+static void ImageOpen(void){
+	const char *path = getenv("FLASH_IMAGE");
+	struct stat st;
+	int fd;
+	if ( (path == NULL) || (*path == 0) ) {
+		path = "build/flash.img";
+	}
+	fd = open(path, O_RDWR | O_CREAT, 0644);
+	if ( (fd < 0) || fstat(fd, &st) ) {
+		perror(path);
+		exit(1);
+	}
+	if ( st.st_size != FLASH_SIZE ) {      // new image, erased flash is all 1's
+		uint8_t erased[FLASH_BLOCK];
+		uint32_t i;
+		memset(erased, 0xFF, sizeof(erased));
+		if ( ftruncate(fd, 0) ) {
+			perror(path);
+			exit(1);
+		}
+		for ( i = 0; i < FLASH_BLOCKS; i++ ) {
+			if ( write(fd, erased, sizeof(erased)) != sizeof(erased) ) {
+				perror(path);
+				exit(1);
+			}
+		}
+	}
+	Image = mmap(NULL, FLASH_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if ( Image == MAP_FAILED ) {
+		perror(path);
+		exit(1);
+	}
+	close(fd);
+	WordCost = EnvCost("FLASH_WORD_US", WordCost);
+	FastCost = EnvCost("FLASH_FAST_US", FastCost);
+	EraseCost = EnvCost("FLASH_ERASE_US", EraseCost);
+	Stall = (int)EnvCost("FLASH_STALL", 0);
+}
+
+static int InImage(uint32_t addr, uint32_t size){
+	if ( Image == NULL ) {
+		ImageOpen();
+	}
+	return (addr >= FLASH_BASE) && (addr + size <= FLASH_BASE + FLASH_SIZE);
+}
+
+const uint8_t *Flash_Map(uint32_t addr){
+	if ( !InImage(addr, 1) ) {
+		fprintf(stderr, "FlashProgram: read of 0x%08X outside the image\n", (unsigned)addr);
+		abort();
+	}
+	return &Image[addr - FLASH_BASE];
+}
+
+// program one word, NOR flash can only clear bits
+static void Program(uint32_t addr, uint32_t data){
+	uint32_t *word = (uint32_t *)&Image[addr - FLASH_BASE];
+	if ( data & ~*word ) {
+		Stats.lostBits++;
+	}
+	*word &= data;
+}
+
+void Flash_Init(uint8_t systemClockFreqMHz){
+	(void)systemClockFreqMHz;
+	if ( Image == NULL ) {
+		ImageOpen();
+	}
+}
+
+int Flash_Write(uint32_t addr, uint32_t data){
+	long sr;
+	if ( ((addr % 4) != 0) || !InImage(addr, 4) ) {
+		return ERROR;
+	}
+	sr = StartCritical();
+	Program(addr, data);
+	Stats.writes++;
+	Charge(WordCost);
+	EndCritical(sr);
+	return NOERROR;
+}
+
+int Flash_WriteArray(uint32_t *source, uint32_t addr, uint16_t count){
+	uint16_t successfulWrites = 0;
+	while((successfulWrites < count) && (Flash_Write(addr + 4*successfulWrites, source[successfulWrites]) == NOERROR)){
+		successfulWrites = successfulWrites + 1;
+	}
+	return successfulWrites;
+}
+
+int Flash_FastWrite(uint32_t *source, uint32_t addr, uint16_t count){
+	int writes = 0;
+	long sr;
+	if ( ((addr % 128) != 0) || !InImage(addr, 128) ) {
+		return 0;
+	}
+	sr = StartCritical();
+	while ( (writes < 32) && (writes < count) ) {
+		Program(addr + 4*writes, source[writes]);
+		writes = writes + 1;
+	}
+	Stats.writes += writes;
+	Stats.fastWrites += writes;
+	Charge(FastCost*writes);
+	EndCritical(sr);
+	return writes;
+}
+
+int Flash_Erase(uint32_t addr){
+	long sr;
+	if ( ((addr % FLASH_BLOCK) != 0) || !InImage(addr, FLASH_BLOCK) ) {
+		return ERROR;
+	}
+	sr = StartCritical();
+	memset(&Image[addr - FLASH_BASE], 0xFF, FLASH_BLOCK);
+	Stats.erases++;
+	Stats.blockErases[(addr - FLASH_BASE)/FLASH_BLOCK]++;
+	Charge(EraseCost);
+	EndCritical(sr);
+	return NOERROR;
+}
+
+double Flash_Time(void){
+	return Stats.time;
+}
+
+void Flash_Report(void){
+	uint32_t i, most = 0, least = UINT32_MAX, used = 0;
+	for ( i = 0; i < FLASH_BLOCKS; i++ ) {
+		if ( Stats.blockErases[i] > most ) {
+			most = Stats.blockErases[i];
+		}
+		if ( Stats.blockErases[i] < least ) {
+			least = Stats.blockErases[i];
+		}
+		if ( Stats.blockErases[i] ) {
+			used++;
+		}
+	}
+	printf("flash: %u words written (%u fast), %u writes tried to set bits\n",
+	       (unsigned)Stats.writes, (unsigned)Stats.fastWrites, (unsigned)Stats.lostBits);
+	printf("flash: %u block erases, %u of %u blocks erased, erases per block min %u max %u\n",
+	       (unsigned)Stats.erases, (unsigned)used, (unsigned)FLASH_BLOCKS, (unsigned)least, (unsigned)most);
+	printf("flash: %.1f ms of target time charged\n", Stats.time/1000);
+}
@@ -0,0 +1,98 @@
+/********************************************************************
+*	Filename:    Lab2Events.c
+*
+*	Description: Phase staggering of the Lab2 periodic event threads,
+*				 built and run by "make -C host lab2-events". Four heavy
+*				 event threads with periods of 4, 8, 8 and 16 ms each
+*				 run for HEAVY_US. A last event thread ends the run.
+*				 Lab2Events uses the phases OS_AddPeriodicEventThread
+*				 picks, no time slice runs more than one heavy event.
+*				 Lab2EventsFixed is built with EVENT_STAGGER 0, every
+*				 phase is 0 and all four meet every 16 ms. The delay from
+*				 the start of the time slice to the start of each event
+*				 is printed from OS_PeriodicEventStats.
+*
+*	Usage:       Lab2Events [seconds], default DEFAULT_SECONDS.
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "BSP.h"
+#include "CortexM.h"
+#include "../Lab2/os.h"
+
+#define THREADFREQ       1000   // frequency in Hz of round robin scheduler
+#define DEFAULT_SECONDS  3
+#define HEAVY_EVENTS     4
+#define HEAVY_US         300    // run time of each heavy event
+#ifndef EVENT_STAGGER
+#define EVENT_STAGGER    1      // as in Lab2/os.c
+#endif
+
+const uint32_t Periods[HEAVY_EVENTS] = { 4, 8, 8, 16 };
+uint32_t Seconds = DEFAULT_SECONDS;
+int32_t Done;
+
+static uint64_t NowNs(void){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+// busy work for us microseconds of target time
+static void Spin(uint32_t us){
+	uint64_t end = NowNs() + (uint64_t)(us * 1000.0 / Host_Speedup());
+	while ( NowNs() < end ) {
+	}
+}
+
+void Heavy(void){
+	Spin(HEAVY_US);
+}
+
+void Stop(void){
+	OS_Signal(&Done);
+}
+
+void Idle(void){
+	for(;;){
+	}
+}
+
+void Reporter(void){
+	uint32_t i, phase, runs, delay, jitter;
+	double us = 1e6 / BSP_Clock_GetFreq();
+	OS_Wait(&Done);
+	printf("%s, %u s\n", EVENT_STAGGER ? "staggered phases" : "every phase 0", (unsigned)Seconds);
+	printf("event  period ms  phase  runs  max delay us  jitter us\n");
+	for ( i = 0; i < HEAVY_EVENTS; i++ ) {
+		OS_PeriodicEventStats(i, &phase, &runs, &delay, &jitter);
+		printf("%5u  %9u  %5u  %4u  %12.1f  %9.1f\n", (unsigned)i, (unsigned)Periods[i],
+		       (unsigned)phase, (unsigned)runs, delay*us, jitter*us);
+	}
+	fflush(stdout);
+	exit(0);
+}
+
+int main(int argc, char *argv[]){
+	uint32_t i;
+	if ( argc > 1 ) {
+		Seconds = (uint32_t)strtoul(argv[1], NULL, 0);
+	}
+	if ( Seconds == 0 ) {
+		Seconds = DEFAULT_SECONDS;
+	}
+	OS_Init();
+	OS_InitSemaphore(&Done, 0);
+	for ( i = 0; i < HEAVY_EVENTS; i++ ) {
+		OS_AddPeriodicEventThread(&Heavy, Periods[i]);
+	}
+	OS_AddPeriodicEventThread(&Stop, Seconds*THREADFREQ);
+	OS_AddThreads(&Reporter, &Idle, &Idle, &Idle);
+	OS_Launch(BSP_Clock_GetFreq()/THREADFREQ);
+	return 0;             // this never executes
+}
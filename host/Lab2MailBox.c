@@ -0,0 +1,112 @@
+/********************************************************************
+*	Filename:    Lab2MailBox.c
+*
+*	Description: Full pointer mailboxes of the Lab2 kernel, built and run
+*				 by "make -C host lab2-mailbox". For each mode a Consumer
+*				 blocks in OS_MailBox_Get on an empty mailbox of SLOTS
+*				 slots. The Tester puts the first buffer, which wakes the
+*				 Consumer: it has claimed a buffer but not taken it yet.
+*				 Before the Consumer runs again the Tester puts PUTS-1
+*				 more. Then the Consumer gets SLOTS buffers. Checked:
+*				 - MAILBOX_QUEUE: the puts past SLOTS are refused, Put
+*				   returns the buffer itself, buffers 0-2 are received.
+*				 - MAILBOX_LATEST: each put past SLOTS drops the oldest
+*				   buffer, Put returns buffers 0 and 1, and buffers 2-4
+*				   are received although buffer 0 was claimed.
+*				 - The mailbox is empty after, no pointer and no count.
+*				 The exit status is 0 if both modes pass.
+*
+*	Usage:       Lab2MailBox
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "BSP.h"
+#include "CortexM.h"
+#include "../Lab2/os.h"
+
+#define THREADFREQ       1000   // frequency in Hz of round robin scheduler
+#define SLOTS            3
+#define PUTS             5
+
+MailBoxType Box;
+void *Slots[SLOTS];
+char Buffers[PUTS];
+void *Back[PUTS];               // returned by each OS_MailBox_Put
+void *Got[SLOTS];               // received by the Consumer
+int32_t Go, Done;
+
+// buffer number of a pointer, - for none
+static char Name(void *buffer){
+	return (buffer == NULL_PTR) ? '-' : (char)('0' + ((char *)buffer - Buffers));
+}
+
+// run one mode, the buffers Put returns and the ones received must
+// match back[] and got[], buffer numbers and - for none
+static int Scenario(uint32_t mode, const char *name, const char *back, const char *got){
+	int i, claimed, ok = 1;
+	long sr;
+	OS_MailBox_Create(&Box, Slots, SLOTS, mode);
+	OS_Signal(&Go);
+	while ( Box.Count >= 0 ) {     // until the Consumer blocks in OS_MailBox_Get
+		OS_Suspend();
+	}
+	sr = StartCritical();          // the Consumer does not run in here
+	Back[0] = OS_MailBox_Put(&Box, &Buffers[0]);
+	claimed = (Box.Count == 0) && (Box.Used == 1);   // woken, not taken
+	for ( i = 1; i < PUTS; i++ ) {
+		Back[i] = OS_MailBox_Put(&Box, &Buffers[i]);
+	}
+	EndCritical(sr);
+	OS_Wait(&Done);
+	printf("%-15s  returned ", name);
+	for ( i = 0; i < PUTS; i++ ) {
+		putchar(Name(Back[i]));
+		ok = ok && (Name(Back[i]) == back[i]);
+	}
+	printf("  received ");
+	for ( i = 0; i < SLOTS; i++ ) {
+		putchar(Name(Got[i]));
+		ok = ok && (Name(Got[i]) == got[i]);
+	}
+	ok = ok && claimed && (Box.Used == 0) && (Box.Count == 0);
+	printf("  left %u/%d  %s\n", (unsigned)Box.Used, (int)Box.Count,
+	       !claimed ? "NOT CLAIMED" : ok ? "ok" : "FAILED");
+	return ok;
+}
+
+void Tester(void){
+	int ok;
+	ok = Scenario(MAILBOX_QUEUE, "MAILBOX_QUEUE", "---34", "012");
+	ok = Scenario(MAILBOX_LATEST, "MAILBOX_LATEST", "---01", "234") && ok;
+	fflush(stdout);
+	exit(ok ? 0 : 1);
+}
+
+void Consumer(void){
+	int i;
+	for(;;){
+		OS_Wait(&Go);
+		for ( i = 0; i < SLOTS; i++ ) {
+			Got[i] = OS_MailBox_Get(&Box);
+		}
+		OS_Signal(&Done);
+	}
+}
+
+void Idle(void){
+	for(;;){
+	}
+}
+
+int main(void){
+	OS_Init();
+	OS_InitSemaphore(&Go, 0);
+	OS_InitSemaphore(&Done, 0);
+	OS_AddThreads(&Tester, &Consumer, &Idle, &Idle);
+	OS_Launch(BSP_Clock_GetFreq()/THREADFREQ);
+	return 0;             // this never executes
+}
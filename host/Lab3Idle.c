@@ -0,0 +1,121 @@
+/********************************************************************
+*	Filename:    Lab3Idle.c
+*
+*	Description: Kernel idle thread of Lab3, built and run by
+*				 "make -C host lab3-idle". Three Sleepers loop on
+*				 OS_SleepUntil of 10, 20 and 50 ms, so that the rate
+*				 does not drift, two Waiters on OS_Wait of a semaphore
+*				 an event thread signals every 25 ms, and the Reporter
+*				 sleeps for the run, so that all six main
+*				 threads sleep or are blocked most of the time. Before
+*				 the idle thread Scheduler spun in SysTick_Handler with
+*				 interrupts disabled then and the run hung, the watchdog
+*				 alarm stops it after WATCHDOG seconds. The Reporter
+*				 prints the loops of every thread against the expected
+*				 count and the share of the run OS_IdleCycles counted.
+*				 The exit status is 0 if every thread kept its rate and
+*				 the idle share is over MIN_IDLE percent.
+*
+*	Usage:       Lab3Idle [seconds], default DEFAULT_SECONDS, less
+*				 than 50 so that the cycle counter does not wrap.
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "BSP.h"
+#include "CortexM.h"
+#include "../Lab3/os.h"
+
+#define THREADFREQ       1000   // frequency in Hz of round robin scheduler
+#define DEFAULT_SECONDS  2
+#define WATCHDOG         10     // host seconds past the run
+#define SLEEPERS         3
+#define WAITERS          2
+#define SIGNAL_MS        25     // period of the event thread
+#define MIN_IDLE         99.0   // percent
+
+const uint32_t Periods[SLEEPERS] = { 10, 20, 50 };
+uint32_t Seconds = DEFAULT_SECONDS;
+sema_t Ready[WAITERS];
+volatile uint32_t SleepLoops[SLEEPERS], WaitLoops[WAITERS];
+
+// 1 if loops is the count expected from period ms over the run, one
+// loop either way and 1 % for the loops on the edges of the run
+static int Expected(uint32_t loops, uint32_t period){
+	uint32_t want = Seconds*1000/period;
+	int32_t off = (int32_t)loops - (int32_t)want;
+	if ( off < 0 )
+		off = -off;
+	return (uint32_t)off <= 1 + want/100;
+}
+
+static void Sleeper(uint32_t i){
+	uint64_t lastWake = OS_Ticks();
+	for(;;){
+		OS_SleepUntil(&lastWake, Periods[i]);
+		SleepLoops[i]++;
+	}
+}
+void Sleeper0(void){ Sleeper(0); }
+void Sleeper1(void){ Sleeper(1); }
+void Sleeper2(void){ Sleeper(2); }
+
+static void Waiter(uint32_t i){
+	for(;;){
+		OS_Wait(&Ready[i]);
+		WaitLoops[i]++;
+	}
+}
+void Waiter0(void){ Waiter(0); }
+void Waiter1(void){ Waiter(1); }
+
+void Signaler(void){            // event thread
+	OS_Signal(&Ready[0]);
+	OS_Signal(&Ready[1]);
+}
+
+void Reporter(void){
+	uint32_t start = Host_CycleCount(), cycles, i;
+	uint64_t idle = OS_IdleCycles();
+	double share;
+	int ok = 1;
+	OS_Sleep(Seconds*1000);
+	cycles = Host_CycleCount() - start;
+	idle = OS_IdleCycles() - idle;
+	share = 100.0 * idle / cycles;
+	for ( i = 0; i < SLEEPERS; i++ ) {
+		printf("sleeper %2u ms  %5u loops, %5u expected\n", (unsigned)Periods[i],
+		       (unsigned)SleepLoops[i], (unsigned)(Seconds*1000/Periods[i]));
+		ok = ok && Expected(SleepLoops[i], Periods[i]);
+	}
+	for ( i = 0; i < WAITERS; i++ ) {
+		printf("waiter  %2u ms  %5u loops, %5u expected\n", SIGNAL_MS,
+		       (unsigned)WaitLoops[i], (unsigned)(Seconds*1000/SIGNAL_MS));
+		ok = ok && Expected(WaitLoops[i], SIGNAL_MS);
+	}
+	printf("idle %.1f %% of %u s, %s\n", share, (unsigned)Seconds,
+	       !ok ? "RATE LOST" : (share < MIN_IDLE) ? "NOT IDLE" : "ok");
+	fflush(stdout);
+	exit((ok && (share >= MIN_IDLE)) ? 0 : 1);
+}
+
+int main(int argc, char *argv[]){
+	if ( argc > 1 ) {
+		Seconds = (uint32_t)strtoul(argv[1], NULL, 0);
+	}
+	if ( (Seconds == 0) || (Seconds >= 50) ) {
+		Seconds = DEFAULT_SECONDS;
+	}
+	alarm((unsigned)(Seconds / Host_Speedup()) + WATCHDOG);   // a hang ends on SIGALRM
+	OS_Init();
+	OS_InitSemaphore(&Ready[0], 0);
+	OS_InitSemaphore(&Ready[1], 0);
+	OS_AddThreads(&Reporter, &Sleeper0, &Sleeper1, &Sleeper2, &Waiter0, &Waiter1);
+	OS_AddPeriodicEventThread(&Signaler, SIGNAL_MS);
+	OS_Launch(BSP_Clock_GetFreq()/THREADFREQ);
+	return 0;             // this never executes
+}
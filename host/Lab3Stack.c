@@ -0,0 +1,104 @@
+/********************************************************************
+*	Filename:    Lab3Stack.c
+*
+*	Description: Stack pool, paint and guard of the Lab3 kernel, built
+*				 and run by "make -C host lab3-stack". With the default
+*				 STACK_WORDS, STACKSIZE for every thread, the stacks
+*				 are carved out of StackPool in OS_AddThreads order, so
+*				 the check finds them there. Checked before OS_Launch:
+*				 - OS_AddThreads takes the six threads and Idle.
+*				 - every fresh stack reports FRESH_WORDS used.
+*				 - a word planted PLANT words below the top of thread 1
+*				   reports PLANT words used.
+*				 - thread 2 with its guard word overwritten reports its
+*				   whole stack.
+*				 Then the guard of thread 0 is overwritten and the
+*				 kernel launched: the first Scheduler must stop in
+*				 StackOverflow, which the alarm after HALT_SECONDS
+*				 finds in StackOverflowPt. Lab3StackShort builds os.c
+*				 with STACK_WORDS past STACKPOOL, OS_AddThreads must
+*				 refuse them. The exit status is 0 if every check
+*				 passes.
+*
+*	Usage:       Lab3Stack
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include "BSP.h"
+#include "CortexM.h"
+#include "../Lab3/os.h"
+
+#define THREADFREQ       1000   // frequency in Hz of round robin scheduler
+#define NUMTHREADS       6      // as in Lab3/os.c
+#define IDLE             NUMTHREADS
+#define STACKSIZE        100    // words, as in Lab3/os.c
+#define FRESH_WORDS      0      // the host builds no frame there, 18 on the target
+#define PLANT            60
+#define HALT_SECONDS     1
+#define STACK_PAINT      0xA5A5A5A5  // as in Lab3/os.c
+
+extern int32_t StackPool[];
+extern struct tcb *StackOverflowPt;
+int Failed;
+
+void Thread(void){
+	for(;;){
+	}
+}
+
+#ifdef STACK_WORDS
+int main(void){
+	int added;
+	OS_Init();
+	added = OS_AddThreads(&Thread, &Thread, &Thread, &Thread, &Thread, &Thread);
+	printf("stacks past STACKPOOL %s\n", added ? "TAKEN" : "refused, ok");
+	return added ? 1 : 0;
+}
+#else
+static void Check(const char *what, uint32_t got, uint32_t want){
+	printf("%-34s %3u words, %3u expected  %s\n", what, (unsigned)got, (unsigned)want,
+	       (got == want) ? "ok" : "FAILED");
+	if ( got != want )
+		Failed = 1;
+}
+
+// the alarm lands while the kernel spins in StackOverflow
+static void Halted(int sig){
+	(void)sig;
+	printf("guard of thread 0 lost, %s\n", (StackOverflowPt != NULL) ? "stopped in StackOverflow" : "NOT STOPPED");
+	fflush(stdout);
+	_exit((!Failed && (StackOverflowPt != NULL)) ? 0 : 1);
+}
+
+int main(void){
+	uint32_t i;
+	int added;
+	OS_Init();
+	added = OS_AddThreads(&Thread, &Thread, &Thread, &Thread, &Thread, &Thread);
+	if ( !added ) {
+		printf("OS_AddThreads FAILED\n");
+		return 1;
+	}
+	for ( i = 0; i <= IDLE; i++ ) {
+		Check((i == IDLE) ? "fresh stack of Idle" : "fresh stack", OS_StackHighWater(i), FRESH_WORDS);
+	}
+	StackPool[STACKSIZE + STACKSIZE - PLANT] = 0;   // thread 1
+	Check("thread 1 with a word planted", OS_StackHighWater(1), PLANT);
+	StackPool[STACKSIZE + STACKSIZE - PLANT] = (int32_t)STACK_PAINT;
+	StackPool[2*STACKSIZE] = 0;                      // guard of thread 2
+	Check("thread 2 without its guard word", OS_StackHighWater(2), STACKSIZE);
+	Check("thread 1 left alone", OS_StackHighWater(1), FRESH_WORDS);
+	fflush(stdout);
+	StackPool[0] = 0;                                // guard of thread 0, runs first
+	signal(SIGALRM, &Halted);
+	alarm(HALT_SECONDS);
+	OS_Launch(BSP_Clock_GetFreq()/THREADFREQ);
+	return 1;             // this never executes
+}
+#endif
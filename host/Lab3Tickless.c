@@ -0,0 +1,221 @@
+/********************************************************************
+*	Filename:    Lab3Tickless.c
+*
+*	Description: Periodic event threads of a tickless Lab3, built and
+*				 run by "make -C host lab3-tickless". Four event threads
+*				 run every 4, 7, 40 and 250 ms. The Reporter sleeps for
+*				 the run and the five other main threads wait on a
+*				 semaphore nobody signals, so the kernel idle thread
+*				 stretches the tick over most of it: RunPeriodicEvents
+*				 counts the events down by several ticks at once. Half
+*				 way the Reporter wakes up and disables interrupts for
+*				 STALL_MS, the ticks of the stall come back through
+*				 TickLag on the next timer restart, all at once, and
+*				 count the 4 and 7 ms events past zero, by more than a
+*				 period. The Reporter prints the interrupts per second
+*				 and per event thread the runs against the expected
+*				 count, the shortest and longest ticks between two runs,
+*				 the late runs (more ticks than the period), the skipped
+*				 ones (two periods or more, run once), the longest gap
+*				 from the stall until its ticks are counted, which the
+*				 other columns leave out, and the mean period in ms of
+*				 the cycle counter.
+*				 Lab3Tickless uses the default TICKLESS of Lab3/os.c,
+*				 Lab3Ticking is built with TICKLESS 0. The exit status
+*				 is 0 if every event thread ran the expected count and
+*				 - tickless: kept its mean period to MAX_DRIFT percent,
+*				   skipped no run and ran at most one tick late, more
+*				   by the whole ticks the host delivered a timer signal
+*				   late, the 4 ms event got the STALL_MS ticks of the
+*				   stall in one gap and the timer took fewer than
+*				   MAX_STRETCHED interrupts per second.
+*				 - ticking: ran every period ticks exactly, across the
+*				   stall too, its ticks are lost.
+*				 On the target the stall holds the timer interrupt back
+*				 the same way.
+*				 The tickless late runs are one tick late: a step change
+*				 restarts the timer from the end of RunPeriodicEvents,
+*				 so every restart moves the ticks later by the time the
+*				 interrupt took, and TickLag counts that back as one
+*				 more tick once it adds up to a whole one. The event due
+*				 on that interrupt ran less than a tick late in real
+*				 time and the next one is a tick early, the mean period
+*				 keeps. The host adds the time it takes to deliver the
+*				 timer signal to each restart, and now and then delivers
+*				 one late by a good part of a ms or more, which the
+*				 restart keeps as well, Host_SignalLateMaxNs tells how
+*				 late. The make target runs at TICKLESS_SPEEDUP of real
+*				 time so that those stay rare.
+*
+*	Usage:       Lab3Tickless [seconds], default DEFAULT_SECONDS, less
+*				 than 50 so that the cycle counter does not wrap.
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "BSP.h"
+#include "CortexM.h"
+#include "../Lab3/os.h"
+
+#define THREADFREQ       1000   // frequency in Hz of round robin scheduler
+#define DEFAULT_SECONDS  2
+#define WATCHDOG         10     // host seconds past the run
+#define EVENTS           4
+#define MAX_STRETCHED    500    // timer interrupts/s, tickless
+#define MAX_DRIFT        1.0    // percent of the period, tickless
+#define STALL_MS         10     // interrupts disabled half way
+#define TICK_NS          1000000  // Lab3 TIMER_FREQ, 1 kHz
+#ifndef TICKLESS
+#define TICKLESS         1      // as in Lab3/os.c
+#endif
+
+const uint32_t Periods[EVENTS] = { 4, 7, 40, 250 };
+uint32_t Seconds = DEFAULT_SECONDS;
+sema_t Never;
+volatile uint32_t Runs[EVENTS];
+uint32_t Late[EVENTS], Skipped[EVENTS];
+uint32_t Stalled[EVENTS], StallGap[EVENTS];   // runs across the stall
+uint64_t StallTick;
+uint64_t LastTick[EVENTS];
+uint32_t MinGap[EVENTS], MaxGap[EVENTS];    // ticks between two runs
+uint32_t FirstCycle[EVENTS], LastCycle[EVENTS];
+
+static void Event(uint32_t i){
+	uint64_t now = OS_Ticks();
+	uint32_t gap;
+	LastCycle[i] = Host_CycleCount();
+	if ( Runs[i] == 0 ) {
+		FirstCycle[i] = LastCycle[i];
+		MinGap[i] = 0xFFFFFFFF;
+	} else if ( Stalled[i] ) {     // until the ticks of the stall are counted
+		gap = (uint32_t)(now - LastTick[i]);
+		if ( gap > StallGap[i] )
+			StallGap[i] = gap;
+		if ( now >= StallTick + STALL_MS )
+			Stalled[i] = 0;
+	} else {
+		gap = (uint32_t)(now - LastTick[i]);
+		if ( gap < MinGap[i] )
+			MinGap[i] = gap;
+		if ( gap > MaxGap[i] )
+			MaxGap[i] = gap;
+		if ( gap > Periods[i] )
+			Late[i]++;
+		if ( gap >= 2*Periods[i] )
+			Skipped[i]++;
+	}
+	LastTick[i] = now;
+	Runs[i]++;
+}
+void Event0(void){ Event(0); }
+void Event1(void){ Event(1); }
+void Event2(void){ Event(2); }
+void Event3(void){ Event(3); }
+
+void Blocked(void){
+	for(;;){
+		OS_Wait(&Never);
+	}
+}
+
+// interrupts disabled for ms, the timer interrupts wait. Tickless, the
+// ticks come back on the next timer restart, the runs until then are
+// the ones across the stall.
+static void Stall(uint32_t ms){
+	uint32_t start = Host_CycleCount();
+	uint32_t i;
+	DisableInterrupts();
+	StallTick = OS_Ticks();
+	for ( i = 0; i < EVENTS; i++ ) {
+		Stalled[i] = 1;
+	}
+	while ( (Host_CycleCount() - start) < ms*(BSP_Clock_GetFreq()/1000) ) {
+	}
+	EnableInterrupts();
+}
+
+// a tick before OS_Launch, interrupts are enabled while the threads are
+// added, must count as one and nothing else. Before OS_Init set
+// TickCycles it divided by zero.
+static int EarlyTick(void){
+	uint32_t fired = Host_InterruptCount[HOST_TIMER_A];
+	uint64_t ticks = OS_Ticks();
+	EnableInterrupts();
+	while ( Host_InterruptCount[HOST_TIMER_A] == fired ) {
+		WaitForInterrupt();
+	}
+	DisableInterrupts();
+	printf("tick before OS_Launch %s\n", (OS_Ticks() > ticks) ? "ok" : "NOT COUNTED");
+	return OS_Ticks() > ticks;
+}
+
+void Reporter(void){
+	uint32_t sysTickStart = Host_InterruptCount[HOST_SYSTICK];
+	uint32_t timerStart = Host_InterruptCount[HOST_TIMER_A];
+	uint32_t sysTick, timer, want, hostLate, limit, i;
+	double ms = 1000.0 / BSP_Clock_GetFreq(), mean, drift;
+	int ok = 1, kept;
+	OS_Sleep(Seconds*500);
+	Stall(STALL_MS);
+	OS_Sleep(Seconds*500);
+	sysTick = Host_InterruptCount[HOST_SYSTICK] - sysTickStart;
+	timer = Host_InterruptCount[HOST_TIMER_A] - timerStart;
+	hostLate = Host_SignalLateMaxNs[HOST_TIMER_A] / TICK_NS;
+	printf("%s, %.1f SysTick/s, %.1f timer/s, timer signal up to %.2f ms late\n",
+	       TICKLESS ? "tickless" : "ticking", (double)sysTick / Seconds, (double)timer / Seconds,
+	       Host_SignalLateMaxNs[HOST_TIMER_A] / 1e6);
+	printf("period   runs  expected  min gap  max gap  late  skipped  stall  mean ms\n");
+	for ( i = 0; i < EVENTS; i++ ) {
+		want = Seconds*1000/Periods[i];
+		mean = (Runs[i] > 1) ? (LastCycle[i] - FirstCycle[i]) * ms / (Runs[i] - 1) : 0.0;
+		drift = 100.0 * (mean - Periods[i]) / Periods[i];
+		kept = (Runs[i] + 1 + want/100 >= want) && (Runs[i] <= want + 1 + want/100);
+		limit = Periods[i] + 1 + hostLate;
+		if ( TICKLESS )
+			kept = kept && (drift <= MAX_DRIFT) && (drift >= -MAX_DRIFT) && (MaxGap[i] <= limit)
+			       && ((Skipped[i] == 0) || (limit >= 2*Periods[i]));
+		else
+			kept = kept && (MinGap[i] == Periods[i]) && (MaxGap[i] == Periods[i])
+			       && (StallGap[i] == Periods[i]);
+		printf("%6u  %5u  %8u  %7u  %7u  %4u  %7u  %5u  %7.2f  %s\n", (unsigned)Periods[i],
+		       (unsigned)Runs[i], (unsigned)want, (unsigned)MinGap[i], (unsigned)MaxGap[i],
+		       (unsigned)Late[i], (unsigned)Skipped[i], (unsigned)StallGap[i], mean,
+		       kept ? "ok" : "OFF PERIOD");
+		ok = ok && kept;
+	}
+	if ( TICKLESS && (StallGap[0] < STALL_MS) ) {
+		printf("stall not counted back\n");
+		ok = 0;
+	}
+	if ( TICKLESS && (timer >= MAX_STRETCHED*Seconds) ) {
+		printf("ticks not stretched\n");
+		ok = 0;
+	}
+	fflush(stdout);
+	exit(ok ? 0 : 1);
+}
+
+int main(int argc, char *argv[]){
+	if ( argc > 1 ) {
+		Seconds = (uint32_t)strtoul(argv[1], NULL, 0);
+	}
+	if ( (Seconds == 0) || (Seconds >= 50) ) {
+		Seconds = DEFAULT_SECONDS;
+	}
+	alarm((unsigned)(Seconds / Host_Speedup()) + WATCHDOG);   // a hang ends on SIGALRM
+	OS_Init();
+	if ( !EarlyTick() )
+		return 1;
+	OS_InitSemaphore(&Never, 0);
+	OS_AddThreads(&Reporter, &Blocked, &Blocked, &Blocked, &Blocked, &Blocked);
+	OS_AddPeriodicEventThread(&Event0, Periods[0]);
+	OS_AddPeriodicEventThread(&Event1, Periods[1]);
+	OS_AddPeriodicEventThread(&Event2, Periods[2]);
+	OS_AddPeriodicEventThread(&Event3, Periods[3]);
+	OS_Launch(BSP_Clock_GetFreq()/THREADFREQ);
+	return 0;             // this never executes
+}
@@ -0,0 +1,156 @@
+/********************************************************************
+*	Filename:    Lab4Churn.c
+*
+*	Description: Thread create and kill churn on the Lab4 TCB and stack
+*				 pools, built and run by "make -C host lab4-churn".
+*				 A Spawner (priority 1) keeps up to NUMTHREADS-2 Workers
+*				 alive, each with a random priority (0 or 2) and a random
+*				 stack size from STACKMIN to MAX_WORDS, so that the pool
+*				 fragments and creates fail for want of a stack. A Worker
+*				 runs a few rounds of OS_Sleep, OS_Suspend and a shared
+*				 MUTEX_INHERIT lock, and calls OS_Kill, a third of them
+*				 with the lock still held. After the run the Spawner
+*				 waits for the Workers to die and walks the free list of
+*				 the stack pool: it must be one block from the bottom of
+*				 StackPool up to the stacks of the Spawner and Idle,
+*				 which were taken first from the top. The exit status is
+*				 0 if it is.
+*
+*	Usage:       Lab4Churn [seconds], default DEFAULT_SECONDS.
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "BSP.h"
+#include "CortexM.h"
+#include "../Lab4/os.h"
+
+#define THREADFREQ       1000   // frequency in Hz of round robin scheduler
+#define DEFAULT_SECONDS  2
+#define NUMTHREADS       8      // as in Lab4/os.c
+#define STACKPOOL        (NUMTHREADS*100)  // words, as in Lab4/os.c
+#define STACKMIN         32
+#define MAX_WORDS        300
+#define SPAWNER_WORDS    128
+#define IDLE_WORDS       64
+
+// a free block of the stack pool, as stackBlock_t in Lab4/os.c
+typedef struct freeBlock{
+	uint32_t Words;
+	struct freeBlock *next;
+} freeBlock_t;
+extern freeBlock_t *StackFreeList;
+extern int32_t StackPool[];
+
+uint32_t Seconds = DEFAULT_SECONDS;
+mutex_t Shared;
+uint32_t Seed = 1;
+volatile uint32_t Creates, NoTcbOrStack, Kills, KilledHolding;
+
+// LCG shared by all threads
+static uint32_t Random(uint32_t n){
+	long sr = StartCritical();
+	Seed = Seed*1664525 + 1013904223;
+	EndCritical(sr);
+	return (Seed >> 8) % n;
+}
+
+static void Count(volatile uint32_t *counter){
+	long sr = StartCritical();
+	(*counter)++;
+	EndCritical(sr);
+}
+
+static uint32_t Alive(void){
+	threadStats_t stats;
+	uint32_t i, n = 0;
+	for ( i = 0; i < NUMTHREADS; i++ ) {
+		n += OS_GetStats(i, &stats);
+	}
+	return n;
+}
+
+void Worker(void){
+	uint32_t rounds = 1 + Random(8);
+	while ( rounds-- ) {
+		switch ( Random(3) ) {
+		case 0:
+			OS_Sleep(Random(3));
+			break;
+		case 1:
+			OS_Suspend();
+			break;
+		default:
+			OS_Lock(&Shared);
+			OS_Suspend();
+			OS_Unlock(&Shared);
+			break;
+		}
+	}
+	Count(&Kills);
+	if ( Random(3) == 0 ) {
+		Count(&KilledHolding);
+		OS_Lock(&Shared);           // OS_Kill unlocks it
+	}
+	OS_Kill();
+}
+
+void Spawner(void){
+	uint64_t end = OS_Ticks() + Seconds*THREADFREQ;
+	freeBlock_t *block;
+	uint32_t blocks = 0, words = 0;
+	int ok;
+	long sr;
+	while ( OS_Ticks() < end ) {
+		if ( Alive() < NUMTHREADS ) {
+			if ( OS_CreateThread(&Worker, 2*Random(2), STACKMIN + Random(MAX_WORDS - STACKMIN + 1)) )
+				Count(&Creates);
+			else
+				Count(&NoTcbOrStack);
+		}
+		OS_Sleep(Random(2));
+	}
+	while ( Alive() > 2 ) {        // the Spawner and Idle
+		OS_Sleep(1);
+	}
+	sr = StartCritical();
+	for ( block = StackFreeList; block != NULL; block = block->next ) {
+		blocks++;
+		words += block->Words;
+	}
+	ok = (blocks == 1) && ((int32_t *)StackFreeList == StackPool)
+	     && (words == STACKPOOL - SPAWNER_WORDS - IDLE_WORDS);
+	EndCritical(sr);
+	printf("%u s: %u creates, %u refused, %u kills, %u holding the mutex\n", (unsigned)Seconds,
+	       (unsigned)Creates, (unsigned)NoTcbOrStack, (unsigned)Kills, (unsigned)KilledHolding);
+	printf("stack pool: %u free block%s, %u words free of %u, %s\n", (unsigned)blocks,
+	       (blocks == 1) ? "" : "s", (unsigned)words, (unsigned)(STACKPOOL - SPAWNER_WORDS - IDLE_WORDS),
+	       ok ? "coalesced" : "FRAGMENTED");
+	printf("mutex owner %s\n", (Shared.Owner == NULL) ? "none" : "LEFT SET");
+	fflush(stdout);
+	exit((ok && (Shared.Owner == NULL)) ? 0 : 1);
+}
+
+void Idle(void){
+	for(;;){
+		OS_Idle();
+	}
+}
+
+int main(int argc, char *argv[]){
+	if ( argc > 1 ) {
+		Seconds = (uint32_t)strtoul(argv[1], NULL, 0);
+	}
+	if ( Seconds == 0 ) {
+		Seconds = DEFAULT_SECONDS;
+	}
+	OS_Init();
+	OS_InitMutex(&Shared, MUTEX_INHERIT, 0);
+	OS_CreateThread(&Spawner, 1, SPAWNER_WORDS);   // from the top of the pool
+	OS_CreateThread(&Idle, 31, IDLE_WORDS);
+	OS_Launch(BSP_Clock_GetFreq()/THREADFREQ);
+	return 0;             // this never executes
+}
@@ -0,0 +1,143 @@
+/********************************************************************
+*	Filename:    Lab4Fifo.c
+*
+*	Description: Cost of the Lab4 OS_FIFO, built and run by
+*				 "make -C host lab4-fifo". Threads:
+*				 - Reporter (priority 0) sleeps for the run and prints.
+*				 - Producer (priority 1) puts sequence numbers, then
+*				   yields.
+*				 - Consumers (priority 1) get them and check the
+*				   sequence, they block when there is not enough.
+*				 Modes:
+*				 - one: BURST single entries through OS_FIFO_Put and
+*				   OS_FIFO_Get, one consumer.
+*				 - block: two fifo_t of FIFO_ENTRIES, blocks of BLOCK
+*				   through OS_FIFO_PutN and OS_FIFO_GetN, one consumer
+*				   on each.
+*				 The time spent with interrupts disabled at thread level
+*				 is measured with Host_MaskTiming and reported per item
+*				 moved.
+*
+*	Usage:       Lab4Fifo one|block [seconds], default DEFAULT_SECONDS.
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "BSP.h"
+#include "CortexM.h"
+#include "../Lab4/os.h"
+
+#define THREADFREQ       1000   // frequency in Hz of round robin scheduler
+#define DEFAULT_SECONDS  2
+#define BURST            8      // puts between yields, fits in the FIFO
+#define FIFO_ENTRIES     256    // size of each fifo_t in block mode
+#define BLOCK            64     // entries per OS_FIFO_PutN and OS_FIFO_GetN
+
+enum { ONE, BLOCKS } Mode;
+fifo_t Fifos[2];
+uint32_t Storage[2][FIFO_ENTRIES];
+volatile uint32_t Items, Full, Errors;
+uint32_t Seconds = DEFAULT_SECONDS;
+
+void Producer(void){
+	uint32_t sequence = 0;
+	uint32_t i;
+	for(;;){
+		for ( i = 0; i < BURST; i++ ) {
+			if ( OS_FIFO_Put(sequence) == 0 )
+				sequence++;
+			else
+				Full++;
+		}
+		OS_Suspend();
+	}
+}
+
+void Consumer(void){
+	uint32_t expected = 0;
+	for(;;){
+		if ( OS_FIFO_Get() != expected )
+			Errors++;
+		expected++;
+		Items++;
+	}
+}
+
+void BlockProducer(void){
+	uint32_t sequence[2] = { 0, 0 };
+	uint32_t block[BLOCK];
+	uint32_t f, i, put;
+	for(;;){
+		for ( f = 0; f < 2; f++ ) {
+			for ( i = 0; i < BLOCK; i++ )
+				block[i] = sequence[f] + i;
+			put = OS_FIFO_PutN(&Fifos[f], block, BLOCK);
+			sequence[f] += put;
+			Full += BLOCK - put;
+		}
+		OS_Suspend();
+	}
+}
+
+static void BlockConsumer(fifo_t *fifoPt){
+	uint32_t expected = 0;
+	uint32_t block[BLOCK];
+	uint32_t i;
+	for(;;){
+		OS_FIFO_GetN(fifoPt, block, BLOCK);
+		for ( i = 0; i < BLOCK; i++ ) {
+			if ( block[i] != expected )
+				Errors++;
+			expected++;
+		}
+		Items += BLOCK;
+	}
+}
+void Consumer0(void){ BlockConsumer(&Fifos[0]); }
+void Consumer1(void){ BlockConsumer(&Fifos[1]); }
+
+void Reporter(void){
+	Host_MaskTiming(1);
+	OS_Sleep(Seconds*1000);
+	Host_MaskTiming(0);
+	printf("%-5s  items/s %.0f, full %u, errors %u, masked sections per item %.2f, mean %.1f ns\n",
+	       (Mode == ONE) ? "one" : "block", (double)Items/Seconds, (unsigned)Full, (unsigned)Errors,
+	       Items ? (double)Host_MaskCount/Items : 0.0,
+	       Host_MaskCount ? (double)Host_MaskNs/Host_MaskCount : 0.0);
+	fflush(stdout);
+	exit(0);
+}
+
+int main(int argc, char *argv[]){
+	if ( (argc < 2) || (strcmp(argv[1], "one") && strcmp(argv[1], "block")) ) {
+		fprintf(stderr, "usage: Lab4Fifo one|block [seconds]\n");
+		return 1;
+	}
+	Mode = strcmp(argv[1], "one") ? BLOCKS : ONE;
+	if ( argc > 2 ) {
+		Seconds = (uint32_t)strtoul(argv[2], NULL, 0);
+	}
+	if ( Seconds == 0 ) {
+		Seconds = DEFAULT_SECONDS;
+	}
+	OS_Init();
+	OS_AddThread(&Reporter, 0);
+	if ( Mode == ONE ) {
+		OS_FIFO_Init();
+		OS_AddThread(&Producer, 1);
+		OS_AddThread(&Consumer, 1);
+	}
+	else {
+		OS_FIFO_Create(&Fifos[0], Storage[0], FIFO_ENTRIES);
+		OS_FIFO_Create(&Fifos[1], Storage[1], FIFO_ENTRIES);
+		OS_AddThread(&BlockProducer, 1);
+		OS_AddThread(&Consumer0, 1);
+		OS_AddThread(&Consumer1, 1);
+	}
+	OS_Launch(BSP_Clock_GetFreq()/THREADFREQ);
+	return 0;             // this never executes
+}
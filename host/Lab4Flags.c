@@ -0,0 +1,135 @@
+/********************************************************************
+*	Filename:    Lab4Flags.c
+*
+*	Description: Lab4 event flags against a poll and sleep loop, built
+*				 and run by "make -C host lab4-flags". Two timer ISRs,
+*				 at FREQ_A and FREQ_B Hz, each set one flag of a group.
+*				 Consumer (priority 1) handles a pair when both are set:
+*				 - wait: OS_WaitFlags with FLAGS_ALL | FLAGS_CLEAR.
+*				 - poll: checks the flags and OS_Sleep(1) until both
+*				   are set, then clears them.
+*				 In wait mode a Watchdog (priority 2) waits for a flag
+*				 nobody sets with a TIMEOUT ms timeout and counts the
+*				 timeouts. A Reporter (priority 0) sleeps for the run
+*				 and prints the pairs handled, the times Consumer ran
+*				 and the latency from the second flag set to Consumer
+*				 seeing it, an idle thread (priority 31) fills the rest.
+*
+*	Usage:       Lab4Flags wait|poll [seconds]
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "BSP.h"
+#include "CortexM.h"
+#include "../Lab4/os.h"
+
+#define THREADFREQ       1000   // frequency in Hz of round robin scheduler
+#define DEFAULT_SECONDS  3
+#define STACK_WORDS      128
+#define FREQ_A           100    // Hz
+#define FREQ_B           70     // Hz
+#define FLAG_A           0x01
+#define FLAG_B           0x02
+#define FLAG_NEVER       0x80
+#define TIMEOUT          50     // ms
+
+int Poll;
+uint32_t Seconds = DEFAULT_SECONDS;
+flags_t Flags;
+volatile uint32_t StampA, StampB;   // cycle count of the last set
+volatile uint32_t Pairs, Timeouts;
+uint64_t LatencySum;
+uint32_t LatencyMax;
+int32_t ConsumerTcb;
+
+void SetA(void){
+	StampA = Host_CycleCount();
+	OS_SetFlags(&Flags, FLAG_A);
+}
+
+void SetB(void){
+	StampB = Host_CycleCount();
+	OS_SetFlags(&Flags, FLAG_B);
+}
+
+// latency from the later of the two sets to now
+static void Handled(void){
+	uint32_t now = Host_CycleCount();
+	uint32_t a = now - StampA;
+	uint32_t b = now - StampB;
+	uint32_t latency = (a < b) ? a : b;
+	LatencySum += latency;
+	if ( latency > LatencyMax )
+		LatencyMax = latency;
+	Pairs++;
+}
+
+void Consumer(void){
+	for(;;){
+		if ( Poll ) {
+			while ( (OS_ClearFlags(&Flags, 0) & (FLAG_A | FLAG_B)) != (FLAG_A | FLAG_B) )
+				OS_Sleep(1);
+			OS_ClearFlags(&Flags, FLAG_A | FLAG_B);
+		}
+		else {
+			OS_WaitFlags(&Flags, FLAG_A | FLAG_B, FLAGS_ALL | FLAGS_CLEAR, 0);
+		}
+		Handled();
+	}
+}
+
+void Watchdog(void){
+	for(;;){
+		if ( OS_WaitFlags(&Flags, FLAG_NEVER, FLAGS_ANY, TIMEOUT) == 0 )
+			Timeouts++;
+	}
+}
+
+void Idle(void){
+	for(;;){
+	}
+}
+
+void Reporter(void){
+	threadStats_t stats;
+	double us = 1e6 / BSP_Clock_GetFreq();
+	OS_Sleep(Seconds*1000);
+	OS_GetStats(ConsumerTcb, &stats);
+	printf("%-4s  %5u  %8u  %10.1f  %9.1f  %8u\n", Poll ? "poll" : "wait", (unsigned)Pairs,
+	       (unsigned)stats.Switches, Pairs ? LatencySum * us / Pairs : 0.0, LatencyMax * us,
+	       (unsigned)Timeouts);
+	fflush(stdout);
+	exit(0);
+}
+
+int main(int argc, char *argv[]){
+	if ( (argc < 2) || (strcmp(argv[1], "wait") && strcmp(argv[1], "poll")) ) {
+		fprintf(stderr, "usage: Lab4Flags wait|poll [seconds]\n");
+		return 1;
+	}
+	Poll = !strcmp(argv[1], "poll");
+	if ( argc > 2 ) {
+		Seconds = (uint32_t)strtoul(argv[2], NULL, 0);
+	}
+	if ( Seconds == 0 ) {
+		Seconds = DEFAULT_SECONDS;
+	}
+	OS_Init();
+	OS_InitFlags(&Flags, 0);
+	OS_CreateThread(&Reporter, 0, STACK_WORDS);
+	ConsumerTcb = 1;      // TCBs in the order created
+	OS_CreateThread(&Consumer, 1, STACK_WORDS);
+	if ( !Poll ) {
+		OS_CreateThread(&Watchdog, 2, STACK_WORDS);
+	}
+	OS_CreateThread(&Idle, 31, STACK_WORDS);
+	BSP_PeriodicTask_InitB(&SetA, FREQ_A, 1);
+	BSP_PeriodicTask_InitC(&SetB, FREQ_B, 2);
+	OS_Launch(BSP_Clock_GetFreq()/THREADFREQ);
+	return 0;             // this never executes
+}
@@ -0,0 +1,130 @@
+/********************************************************************
+*	Filename:    Lab4Load.c
+*
+*	Description: Load test of the Lab4 priority kernel on the Linux host,
+*				 built and run by "make -C host lab4-load". Eight threads:
+*				 - Reporter (priority 0) sleeps one second at a time and
+*				   prints the rates of the last second.
+*				 - Event0/Event1 (priority 0) wait on the semaphores of
+*				   OS_PeriodTrigger0_Init/OS_PeriodTrigger1_Init.
+*				 - Two ping-pong pairs (priority 1) block on each other's
+*				   semaphore, every round is two blocking switches.
+*				 - Spinner (priority 2) never blocks, it only runs when
+*				   all the higher priority threads are blocked or asleep.
+*
+*	Usage:       Lab4Load [seconds], default is DEFAULT_SECONDS.
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "BSP.h"
+#include "CortexM.h"
+#include "../Lab4/os.h"
+
+#define THREADFREQ       1000   // frequency in Hz of round robin scheduler
+#define DEFAULT_SECONDS  5
+#define EVENT0_PERIOD    1      // ms
+#define EVENT1_PERIOD    5      // ms
+
+sema_t Ping0, Pong0, Ping1, Pong1;
+sema_t Event0Sema, Event1Sema;
+volatile uint32_t Rounds0, Rounds1, Event0Count, Event1Count, SpinCount;
+uint32_t Seconds = DEFAULT_SECONDS;
+
+void PingA(void){
+	for(;;){
+		OS_Signal(&Ping0);
+		OS_Wait(&Pong0);
+		Rounds0++;
+	}
+}
+void PongA(void){
+	for(;;){
+		OS_Wait(&Ping0);
+		OS_Signal(&Pong0);
+	}
+}
+void PingB(void){
+	for(;;){
+		OS_Signal(&Ping1);
+		OS_Wait(&Pong1);
+		Rounds1++;
+	}
+}
+void PongB(void){
+	for(;;){
+		OS_Wait(&Ping1);
+		OS_Signal(&Pong1);
+	}
+}
+void Event0(void){
+	for(;;){
+		OS_Wait(&Event0Sema);
+		Event0Count++;
+	}
+}
+void Event1(void){
+	for(;;){
+		OS_Wait(&Event1Sema);
+		Event1Count++;
+	}
+}
+void Spinner(void){
+	for(;;){
+		SpinCount++;
+	}
+}
+
+void Reporter(void){
+	uint32_t second, switches, ticks, rounds, events, spins;
+	uint32_t lastSwitches = 0, lastTicks = 0, lastRounds = 0, lastEvents = 0, lastSpins = 0;
+	printf("Lab4 host load test, %u s, %u Hz SysTick\n", (unsigned)Seconds, (unsigned)THREADFREQ);
+	printf("second  switches/s  systick/s  rounds/s  events/s  spins/s\n");
+	for ( second = 1; second <= Seconds; second++ ) {
+		OS_Sleep(1000);
+		switches = Host_SwitchCount;
+		ticks = Host_SysTickCount;
+		rounds = Rounds0 + Rounds1;
+		events = Event0Count + Event1Count;
+		spins = SpinCount;
+		printf("%6u  %10u  %9u  %8u  %8u  %7u\n", (unsigned)second,
+		       (unsigned)(switches - lastSwitches), (unsigned)(ticks - lastTicks),
+		       (unsigned)(rounds - lastRounds), (unsigned)(events - lastEvents),
+		       (unsigned)(spins - lastSpins));
+		lastSwitches = switches;
+		lastTicks = ticks;
+		lastRounds = rounds;
+		lastEvents = events;
+		lastSpins = spins;
+	}
+	printf("total switches %u, events %u (expected about %u)\n", (unsigned)Host_SwitchCount,
+	       (unsigned)(Event0Count + Event1Count),
+	       (unsigned)(Seconds*1000/EVENT0_PERIOD + Seconds*1000/EVENT1_PERIOD));
+	fflush(stdout);
+	exit(0);
+}
+
+int main(int argc, char *argv[]){
+	if ( argc > 1 ) {
+		Seconds = (uint32_t)strtoul(argv[1], NULL, 0);
+	}
+	if ( Seconds == 0 ) {
+		Seconds = DEFAULT_SECONDS;
+	}
+	OS_Init();
+	OS_InitSemaphore(&Ping0, 0);
+	OS_InitSemaphore(&Pong0, 0);
+	OS_InitSemaphore(&Ping1, 0);
+	OS_InitSemaphore(&Pong1, 0);
+	OS_InitSemaphore(&Event0Sema, 0);
+	OS_InitSemaphore(&Event1Sema, 0);
+	OS_PeriodTrigger0_Init(&Event0Sema, EVENT0_PERIOD);
+	OS_PeriodTrigger1_Init(&Event1Sema, EVENT1_PERIOD);
+	OS_AddThreads(&Reporter, 0, &Event0, 0, &Event1, 0,
+	              &PingA, 1, &PongA, 1, &PingB, 1, &PongB, 1, &Spinner, 2);
+	OS_Launch(BSP_Clock_GetFreq()/THREADFREQ);
+	return 0;             // this never executes
+}
@@ -0,0 +1,158 @@
+/********************************************************************
+*	Filename:    Lab4Mutex.c
+*
+*	Description: Priority inversion on a Lab4 bus lock, built and run by
+*				 "make -C host lab4-mutex". Threads:
+*				 - Reporter (priority 0) sleeps for the run and prints.
+*				 - High (priority 1) takes the lock every HIGH_PERIOD ms
+*				   and holds it for HIGH_HOLD us, like Task0 and the ADC.
+*				 - Medium (priority 2) never takes the lock, it runs for
+*				   MEDIUM_BURST ms every MEDIUM_PERIOD ms.
+*				 - Low (priority 3) holds the lock for LOW_HOLD us every
+*				   LOW_PERIOD ms, like a display thread and the LCD.
+*				 - Idle (priority 31).
+*				 High measures the time from the lock call until it owns
+*				 the lock. With a semaphore, Medium can preempt Low while
+*				 Low holds the lock and High waits for the whole burst.
+*				 With MUTEX_INHERIT or MUTEX_CEILING, Low runs at priority
+*				 1 meanwhile and High waits for one LOW_HOLD at most.
+*
+*	Usage:       Lab4Mutex sema|inherit|ceiling [seconds]
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "BSP.h"
+#include "CortexM.h"
+#include "../Lab4/os.h"
+
+#define THREADFREQ       1000   // frequency in Hz of round robin scheduler
+#define DEFAULT_SECONDS  3
+#define STACK_WORDS      128
+#define SPIN_GAP         20000  // ns, longer gaps in Spin are time switched out
+#define HIGH_PERIOD      5      // ms
+#define HIGH_HOLD        100    // us
+#define MEDIUM_PERIOD    40     // ms
+#define MEDIUM_BURST     15     // ms
+#define LOW_PERIOD       3      // ms
+#define LOW_HOLD         1000   // us
+
+enum { SEMA, INHERIT, CEILING } Mode;
+sema_t BusSema;
+mutex_t BusMutex;
+uint32_t Seconds = DEFAULT_SECONDS;
+volatile uint32_t Locks;       // taken by High
+volatile uint64_t BlockedNs, MaxBlockedNs;
+
+static uint64_t NowNs(void){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+// busy work for us microseconds of target time spent running, gaps
+// longer than SPIN_GAP are time switched out and not counted
+static void Spin(uint32_t us){
+	uint64_t want = (uint64_t)(us * 1000.0 / Host_Speedup());
+	uint64_t done = 0;
+	uint64_t last = NowNs();
+	uint64_t now;
+	while ( done < want ) {
+		now = NowNs();
+		if ( now - last < SPIN_GAP ) {
+			done += now - last;
+		}
+		last = now;
+	}
+}
+
+static void Lock(void){
+	if ( Mode == SEMA )
+		OS_Wait(&BusSema);
+	else
+		OS_Lock(&BusMutex);
+}
+static void Unlock(void){
+	if ( Mode == SEMA )
+		OS_Signal(&BusSema);
+	else
+		OS_Unlock(&BusMutex);
+}
+
+void High(void){
+	uint64_t start, blocked;
+	for(;;){
+		OS_Sleep(HIGH_PERIOD);
+		start = NowNs();
+		Lock();
+		blocked = NowNs() - start;
+		Spin(HIGH_HOLD);
+		Unlock();
+		Locks++;
+		BlockedNs += blocked;
+		if ( blocked > MaxBlockedNs )
+			MaxBlockedNs = blocked;
+	}
+}
+
+void Medium(void){
+	for(;;){
+		OS_Sleep(MEDIUM_PERIOD - MEDIUM_BURST);
+		Spin(MEDIUM_BURST*1000);
+	}
+}
+
+void Low(void){
+	for(;;){
+		Lock();
+		Spin(LOW_HOLD);
+		Unlock();
+		OS_Sleep(LOW_PERIOD);
+	}
+}
+
+void Idle(void){
+	for(;;){
+	}
+}
+
+void Reporter(void){
+	const char *names[] = { "semaphore", "MUTEX_INHERIT", "MUTEX_CEILING" };
+	double speedup = Host_Speedup();
+	OS_Sleep(Seconds*1000);
+	printf("%-13s  %5u  %14.0f  %13.0f\n", names[Mode], (unsigned)Locks,
+	       Locks ? BlockedNs * speedup / Locks / 1000 : 0.0,
+	       MaxBlockedNs * speedup / 1000);
+	fflush(stdout);
+	exit(0);
+}
+
+int main(int argc, char *argv[]){
+	if ( (argc < 2) || (strcmp(argv[1], "sema") && strcmp(argv[1], "inherit")
+	                    && strcmp(argv[1], "ceiling")) ) {
+		fprintf(stderr, "usage: Lab4Mutex sema|inherit|ceiling [seconds]\n");
+		return 1;
+	}
+	Mode = !strcmp(argv[1], "sema") ? SEMA : !strcmp(argv[1], "inherit") ? INHERIT : CEILING;
+	if ( argc > 2 ) {
+		Seconds = (uint32_t)strtoul(argv[2], NULL, 0);
+	}
+	if ( Seconds == 0 ) {
+		Seconds = DEFAULT_SECONDS;
+	}
+	OS_Init();
+	OS_InitSemaphore(&BusSema, 1);
+	OS_InitMutex(&BusMutex, (Mode == CEILING) ? MUTEX_CEILING : MUTEX_INHERIT, 1);
+	OS_CreateThread(&Reporter, 0, STACK_WORDS);
+	OS_CreateThread(&High, 1, STACK_WORDS);
+	OS_CreateThread(&Medium, 2, STACK_WORDS);
+	OS_CreateThread(&Low, 3, STACK_WORDS);
+	OS_CreateThread(&Idle, 31, STACK_WORDS);
+	OS_Launch(BSP_Clock_GetFreq()/THREADFREQ);
+	return 0;             // this never executes
+}
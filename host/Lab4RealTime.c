@@ -0,0 +1,142 @@
+/********************************************************************
+*	Filename:    Lab4RealTime.c
+*
+*	Description: Rate monotonic and EDF modes of the Lab4 kernel on the
+*				 Linux host, built and run by "make -C host lab4-rt".
+*				 Three periodic threads are offered for admission:
+*				 - A  5 ms period, 2000 us WCET
+*				 - B 10 ms period, 4000 us WCET
+*				 - C 14 ms period, 2100 us WCET
+*				 A and B (U = 0.80) pass both tests. With C (U = 0.95)
+*				 the response time of C is 16.1 ms, RM rejects it and
+*				 EDF admits it. Every job spins for JOB_LOAD percent of
+*				 its WCET. With "overrun" every fourth job of B runs for
+*				 twice its WCET, which shows up as misses.
+*				 A Reporter (priority 8) prints jobs and misses per thread
+*				 at the end, an idle thread (priority 31) fills the rest.
+*
+*	Usage:       Lab4RealTime rm|edf [seconds] [overrun]
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "BSP.h"
+#include "CortexM.h"
+#include "../Lab4/os.h"
+
+#define THREADFREQ       1000   // frequency in Hz of round robin scheduler
+#define DEFAULT_SECONDS  3
+#define JOB_LOAD         80     // percent of the WCET a job spins for
+#define STACK_WORDS      128
+#define SPIN_GAP         20000  // ns, longer gaps in Spin are time switched out
+
+typedef struct {
+	const char *name;
+	uint32_t period, wcet;    // ms, us
+	int id;                   // from OS_AddRealTimeThread
+	volatile uint32_t jobs;
+} job_t;
+
+job_t Jobs[3] = {
+	{ "A",  5, 2000, -1, 0 },
+	{ "B", 10, 4000, -1, 0 },
+	{ "C", 14, 2100, -1, 0 },
+};
+uint32_t Seconds = DEFAULT_SECONDS;
+int Overrun;
+
+static uint64_t NowNs(void){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+// busy work for us microseconds of target time spent running. The clock is
+// read in a tight loop, a gap longer than SPIN_GAP means the thread was
+// switched out and is not counted, so the job uses the CPU time it asks for
+// whatever the loop speed of the host.
+static void Spin(uint32_t us){
+	uint64_t want = (uint64_t)(us * 1000.0 / Host_Speedup());
+	uint64_t done = 0;
+	uint64_t last = NowNs();
+	uint64_t now;
+	while ( done < want ) {
+		now = NowNs();
+		if ( now - last < SPIN_GAP ) {
+			done += now - last;
+		}
+		last = now;
+	}
+}
+
+static void RunJobs(job_t *job){
+	uint32_t us;
+	for(;;){
+		us = job->wcet * JOB_LOAD / 100;
+		if ( Overrun && (job == &Jobs[1]) && ((job->jobs % 4) == 3) ) {
+			us = job->wcet * 2;
+		}
+		Spin(us);
+		job->jobs++;
+		OS_WaitPeriod();
+	}
+}
+void ThreadA(void){ RunJobs(&Jobs[0]); }
+void ThreadB(void){ RunJobs(&Jobs[1]); }
+void ThreadC(void){ RunJobs(&Jobs[2]); }
+
+void Idle(void){
+	for(;;){
+	}
+}
+
+void Reporter(void){
+	uint32_t i, jobs, misses;
+	OS_Sleep(Seconds*1000);
+	printf("thread  period ms  wcet us  jobs  misses\n");
+	for ( i = 0; i < 3; i++ ) {
+		if ( OS_RealTimeStats(Jobs[i].id, &jobs, &misses) ) {
+			printf("%-6s  %9u  %7u  %4u  %6u\n", Jobs[i].name, (unsigned)Jobs[i].period,
+			       (unsigned)Jobs[i].wcet, (unsigned)jobs, (unsigned)misses);
+		}
+		else {
+			printf("%-6s  %9u  %7u  rejected\n", Jobs[i].name, (unsigned)Jobs[i].period,
+			       (unsigned)Jobs[i].wcet);
+		}
+	}
+	fflush(stdout);
+	exit(0);
+}
+
+int main(int argc, char *argv[]){
+	void (*threads[3])(void) = { &ThreadA, &ThreadB, &ThreadC };
+	uint32_t mode, i;
+	if ( (argc < 2) || (strcmp(argv[1], "rm") && strcmp(argv[1], "edf")) ) {
+		fprintf(stderr, "usage: Lab4RealTime rm|edf [seconds] [overrun]\n");
+		return 1;
+	}
+	mode = strcmp(argv[1], "edf") ? SCHED_RM : SCHED_EDF;
+	if ( argc > 2 ) {
+		Seconds = (uint32_t)strtoul(argv[2], NULL, 0);
+	}
+	if ( Seconds == 0 ) {
+		Seconds = DEFAULT_SECONDS;
+	}
+	Overrun = (argc > 3) && !strcmp(argv[3], "overrun");
+	OS_Init();
+	OS_RealTimeMode(mode);
+	printf("Lab4 %s, %u s%s\n", (mode == SCHED_EDF) ? "EDF" : "rate monotonic",
+	       (unsigned)Seconds, Overrun ? ", B overruns every fourth job" : "");
+	for ( i = 0; i < 3; i++ ) {
+		Jobs[i].id = OS_AddRealTimeThread(threads[i], Jobs[i].period, Jobs[i].wcet, 0, STACK_WORDS);
+	}
+	OS_CreateThread(&Reporter, 8, STACK_WORDS);
+	OS_CreateThread(&Idle, 31, STACK_WORDS);
+	OS_Launch(BSP_Clock_GetFreq()/THREADFREQ);
+	return 0;             // this never executes
+}
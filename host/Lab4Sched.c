@@ -0,0 +1,116 @@
+/********************************************************************
+*	Filename:    Lab4Sched.c
+*
+*	Description: Cost of the Lab4 Scheduler() against the number of
+*				 threads, built and run by "make -C host lab4-sched".
+*				 Lab4/os.c is compiled with NUMTHREADS=SCHED_THREADS and
+*				 threads are added one at a time, spread over
+*				 SCHED_PRIORITIES priorities. At every power of two the
+*				 SysTick selection is timed:
+*				 - bitmap: Scheduler() of Lab4/os.c, ready lists found
+*				   with the leading zeros of the ready bitmap.
+*				 - linear: the walk of the whole circular TCB list that
+*				   Scheduler() did before, over a copy of the same
+*				   threads, as a reference.
+*				 The linear walk always visits every thread, the bitmap
+*				 cost should not depend on the count. The kernel is never
+*				 launched, interrupts stay disabled.
+*
+*	Usage:       Lab4Sched [calls], default is DEFAULT_CALLS per size.
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "BSP.h"
+#include "CortexM.h"
+#include "../Lab4/os.h"
+
+#ifndef SCHED_THREADS
+#define SCHED_THREADS    256
+#endif
+#define SCHED_PRIORITIES 4
+#define DEFAULT_CALLS    2000000
+
+void Scheduler(void);   // Lab4/os.c, called by SysTick_Handler
+
+// TCB list as walked by the previous Scheduler()
+struct linearTcb{
+	int32_t Sleep;
+	int32_t *Blocked;
+	int32_t Priority;
+	struct linearTcb *next;
+};
+struct linearTcb Linear[SCHED_THREADS];
+struct linearTcb *LinearPt;
+
+void LinearScheduler(void){
+	uint8_t Max = 255;
+	struct linearTcb *pt = LinearPt;
+	struct linearTcb *bestPt = LinearPt;
+	do {
+		pt = pt->next;
+		if ( (pt->Blocked == 0) && (pt->Sleep == 0) && (pt->Priority < Max) ) {
+			Max = pt->Priority;
+			bestPt = pt;
+		}
+	} while ( pt != LinearPt);
+	LinearPt = bestPt;
+}
+
+void Idle(void){
+	for(;;){
+	}
+}
+
+static uint64_t NowNs(void){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+// mean ns per call of scheduler over calls calls
+static double TimeCalls(void (*scheduler)(void), uint32_t calls){
+	uint64_t start;
+	uint32_t i;
+	start = NowNs();
+	for ( i = 0; i < calls; i++ )
+		scheduler();
+	return (double)(NowNs() - start) / calls;
+}
+
+int main(int argc, char *argv[]){
+	uint32_t calls = DEFAULT_CALLS;
+	uint32_t n, size;
+	if ( argc > 1 )
+		calls = (uint32_t)strtoul(argv[1], NULL, 0);
+	if ( calls == 0 )
+		calls = DEFAULT_CALLS;
+
+	OS_Init();            // leaves interrupts disabled
+	printf("Lab4 Scheduler() cost, %u calls per size\n", calls);
+	printf("threads  bitmap ns  linear ns\n");
+	size = 1;
+	for ( n = 0; n < SCHED_THREADS; n++ ) {
+		Linear[n].Priority = n % SCHED_PRIORITIES;   // priority 0 round robin
+		Linear[n].Sleep = 0;
+		Linear[n].Blocked = NULL;
+		Linear[n].next = &Linear[0];
+		if ( n > 0 )
+			Linear[n - 1].next = &Linear[n];
+		LinearPt = &Linear[0];
+		if ( OS_AddThread(&Idle, Linear[n].Priority) == 0 ) {
+			fprintf(stderr, "Lab4Sched: OS_AddThread failed at %u\n", n);
+			return 1;
+		}
+		if ( n + 1 == size ) {
+			printf("%7u  %9.1f  %9.1f\n", size,
+				TimeCalls(&Scheduler, calls), TimeCalls(&LinearScheduler, calls));
+			size *= 2;
+		}
+	}
+	return 0;
+}
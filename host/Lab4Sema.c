@@ -0,0 +1,104 @@
+/********************************************************************
+*	Filename:    Lab4Sema.c
+*
+*	Description: Cost of the Lab4 semaphores against the number of
+*				 threads, built and run by "make -C host lab4-sema".
+*				 Lab4/os.c is compiled with NUMTHREADS=SCHED_THREADS.
+*				 Threads, in the order they are added:
+*				 - Reporter (priority 0) sleeps for the run and prints.
+*				 - Ping (priority 1) signals Pong and waits for it.
+*				 - Waiters (priority 0) block for good on a semaphore
+*				   each, they fill the TCB list up to the thread count.
+*				 - Pong (priority 1) waits for Ping and signals it.
+*				 The time spent with interrupts disabled at thread level
+*				 is measured with Host_MaskTiming, OS_Wait and OS_Signal
+*				 make up nearly all of it.
+*
+*	Usage:       Lab4Sema [threads] [seconds], default DEFAULT_THREADS
+*				 and DEFAULT_SECONDS.
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "BSP.h"
+#include "CortexM.h"
+#include "../Lab4/os.h"
+
+#ifndef SCHED_THREADS
+#define SCHED_THREADS    256
+#endif
+#define THREADFREQ       1000   // frequency in Hz of round robin scheduler
+#define DEFAULT_THREADS  8
+#define DEFAULT_SECONDS  2
+
+sema_t PingSema, PongSema;
+sema_t WaitSema[SCHED_THREADS];
+volatile uint32_t Rounds, Waiting;
+uint32_t Threads = DEFAULT_THREADS;
+uint32_t Seconds = DEFAULT_SECONDS;
+
+void Ping(void){
+	for(;;){
+		OS_Signal(&PingSema);
+		OS_Wait(&PongSema);
+		Rounds++;
+	}
+}
+void Pong(void){
+	for(;;){
+		OS_Wait(&PingSema);
+		OS_Signal(&PongSema);
+	}
+}
+void Waiter(void){
+	OS_Wait(&WaitSema[Waiting++]);   // never signaled
+	for(;;){
+	}
+}
+
+void Reporter(void){
+	Host_MaskTiming(1);
+	OS_Sleep(Seconds*1000);
+	Host_MaskTiming(0);
+	printf("%7u  %10.0f  %10.0f  %7.1f  %7u\n", (unsigned)Threads,
+	       (double)Rounds/Seconds, (double)Host_MaskCount/Seconds,
+	       Host_MaskCount ? (double)Host_MaskNs/Host_MaskCount : 0.0,
+	       (unsigned)Host_MaskMaxNs);
+	fflush(stdout);
+	exit(0);
+}
+
+int main(int argc, char *argv[]){
+	uint32_t i;
+	int added;
+	if ( argc > 1 ) {
+		Threads = (uint32_t)strtoul(argv[1], NULL, 0);
+	}
+	if ( argc > 2 ) {
+		Seconds = (uint32_t)strtoul(argv[2], NULL, 0);
+	}
+	if ( (Threads < 3) || (Threads > SCHED_THREADS) ) {
+		fprintf(stderr, "Lab4Sema: 3 to %u threads\n", (unsigned)SCHED_THREADS);
+		return 1;
+	}
+	if ( Seconds == 0 ) {
+		Seconds = DEFAULT_SECONDS;
+	}
+	OS_Init();
+	OS_InitSemaphore(&PingSema, 0);
+	OS_InitSemaphore(&PongSema, 0);
+	added = OS_AddThread(&Reporter, 0) && OS_AddThread(&Ping, 1);
+	for ( i = 0; added && (i < Threads - 3); i++ ) {
+		OS_InitSemaphore(&WaitSema[i], 0);
+		added = OS_AddThread(&Waiter, 0);
+	}
+	if ( !added || !OS_AddThread(&Pong, 1) ) {
+		fprintf(stderr, "Lab4Sema: no room for %u threads\n", (unsigned)Threads);
+		return 1;
+	}
+	OS_Launch(BSP_Clock_GetFreq()/THREADFREQ);
+	return 0;             // this never executes
+}
@@ -0,0 +1,109 @@
+/********************************************************************
+*	Filename:    Lab4Sleep.c
+*
+*	Description: Period drift of a Lab4 periodic main thread, built and
+*				 run by "make -C host lab4-sleep". Periodic (priority 1)
+*				 does WORK_US of work every PERIOD ms, once with
+*				 OS_Sleep(PERIOD) and once with OS_SleepUntil. With
+*				 OS_Sleep the work adds to every period. A Reporter
+*				 (priority 0) sleeps for the run and prints the loops,
+*				 the mean period from OS_Ticks and the drift from the
+*				 rate asked for, an idle thread (priority 31) fills the
+*				 rest.
+*
+*	Usage:       Lab4Sleep sleep|until [seconds]
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "BSP.h"
+#include "CortexM.h"
+#include "../Lab4/os.h"
+
+#define THREADFREQ       1000   // frequency in Hz of round robin scheduler
+#define DEFAULT_SECONDS  3
+#define STACK_WORDS      128
+#define SPIN_GAP         20000  // ns, longer gaps in Spin are time switched out
+#define PERIOD           10     // ms
+#define WORK_US          3000
+
+int Until;
+uint32_t Seconds = DEFAULT_SECONDS;
+volatile uint32_t Loops;
+volatile uint64_t FirstTick, LastTick;
+
+static uint64_t NowNs(void){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+// busy work for us microseconds of target time spent running, gaps
+// longer than SPIN_GAP are time switched out and not counted
+static void Spin(uint32_t us){
+	uint64_t want = (uint64_t)(us * 1000.0 / Host_Speedup());
+	uint64_t done = 0;
+	uint64_t last = NowNs();
+	uint64_t now;
+	while ( done < want ) {
+		now = NowNs();
+		if ( now - last < SPIN_GAP ) {
+			done += now - last;
+		}
+		last = now;
+	}
+}
+
+void Periodic(void){
+	uint64_t lastWake = OS_Ticks();
+	FirstTick = lastWake;
+	for(;;){
+		Spin(WORK_US);
+		Loops++;
+		LastTick = OS_Ticks();
+		if ( Until )
+			OS_SleepUntil(&lastWake, PERIOD);
+		else
+			OS_Sleep(PERIOD);
+	}
+}
+
+void Idle(void){
+	for(;;){
+	}
+}
+
+void Reporter(void){
+	double period;
+	OS_Sleep(Seconds*1000);
+	period = (Loops > 1) ? (double)(LastTick - FirstTick) / (Loops - 1) : 0.0;
+	printf("%-13s  %5u  %9.2f  %8.1f %%\n", Until ? "OS_SleepUntil" : "OS_Sleep",
+	       (unsigned)Loops, period, 100.0 * (period - PERIOD) / PERIOD);
+	fflush(stdout);
+	exit(0);
+}
+
+int main(int argc, char *argv[]){
+	if ( (argc < 2) || (strcmp(argv[1], "sleep") && strcmp(argv[1], "until")) ) {
+		fprintf(stderr, "usage: Lab4Sleep sleep|until [seconds]\n");
+		return 1;
+	}
+	Until = !strcmp(argv[1], "until");
+	if ( argc > 2 ) {
+		Seconds = (uint32_t)strtoul(argv[2], NULL, 0);
+	}
+	if ( Seconds == 0 ) {
+		Seconds = DEFAULT_SECONDS;
+	}
+	OS_Init();
+	OS_CreateThread(&Reporter, 0, STACK_WORDS);
+	OS_CreateThread(&Periodic, 1, STACK_WORDS);
+	OS_CreateThread(&Idle, 31, STACK_WORDS);
+	OS_Launch(BSP_Clock_GetFreq()/THREADFREQ);
+	return 0;             // this never executes
+}
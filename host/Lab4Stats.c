@@ -0,0 +1,78 @@
+/********************************************************************
+*	Filename:    Lab4Stats.c
+*
+*	Description: Thread statistics of the Lab4 kernel, linked into the
+*				 host builds of the Lab4 application and load test. At
+*				 exit it prints OS_GetStats for every thread alive: CPU
+*				 share, switches, longest blocking, releases and the
+*				 release latency histogram. TCB numbers follow the
+*				 order the threads were created in. With Lab4/os.c
+*				 built with TRACE_ENTRIES, the trace ring is written to
+*				 TRACE_FILE (lab4-trace.bin by default) for TraceJson.
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "BSP.h"
+#include "../Lab4/os.h"
+
+#define MAXTHREADS   256    // largest NUMTHREADS the host builds use
+
+extern traceHeader_t Trace __attribute__((weak));   // header of the ring
+
+static void TraceDump(void){
+	const char *name = getenv("TRACE_FILE");
+	FILE *out;
+	if ( (name == NULL) || (*name == 0) ) {
+		name = "lab4-trace.bin";
+	}
+	out = fopen(name, "wb");
+	if ( out == NULL ) {
+		perror(name);
+		return;
+	}
+	fwrite(&Trace, sizeof(traceHeader_t) + Trace.Entries*sizeof(traceRecord_t), 1, out);
+	fclose(out);
+	printf("trace: %u records written, %u kept in %s\n", (unsigned)Trace.Index,
+	       (unsigned)((Trace.Index < Trace.Entries) ? Trace.Index : Trace.Entries), name);
+}
+
+static void Report(void){
+	threadStats_t stats;
+	uint64_t total = 0;
+	double us = 1e6 / BSP_Clock_GetFreq();
+	uint32_t i, bin;
+	for ( i = 0; i < MAXTHREADS; i++ ) {
+		if ( OS_GetStats(i, &stats) ) {
+			total += stats.RunCycles;
+		}
+	}
+	printf("tcb  pri  CPU %%  switches  max blocked us  releases  max latency us  latency us:count\n");
+	for ( i = 0; i < MAXTHREADS; i++ ) {
+		if ( OS_GetStats(i, &stats) ) {
+			printf("%3u  %3u  %5.1f  %8u  %14.0f  %8u  %14.0f ", (unsigned)i,
+			       (unsigned)stats.Priority, total ? 100.0 * stats.RunCycles / total : 0.0,
+			       (unsigned)stats.Switches, stats.MaxBlocked * us, (unsigned)stats.Releases,
+			       stats.MaxLatency * us);
+			for ( bin = 0; bin < JITTERBINS; bin++ ) {
+				if ( stats.Jitter[bin] == 0 )
+					continue;
+				if ( bin + 1 < JITTERBINS )
+					printf(" <%u:%u", 1u << bin, (unsigned)stats.Jitter[bin]);
+				else
+					printf(" more:%u", (unsigned)stats.Jitter[bin]);
+			}
+			printf("\n");
+		}
+	}
+	if ( &Trace ) {
+		TraceDump();
+	}
+}
+
+__attribute__((constructor)) static void StatsInit(void){
+	atexit(&Report);
+}
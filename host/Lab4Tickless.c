@@ -0,0 +1,130 @@
+/********************************************************************
+*	Filename:    Lab4Tickless.c
+*
+*	Description: Interrupt rate and sleep time of a mostly idle Lab4
+*				 system, built and run by "make -C host lab4-tickless".
+*				 Three workers (priority 1) do WORK_US of work every
+*				 10, 25 and 100 ms with OS_SleepUntil, an idle thread
+*				 (priority 31) calls OS_Idle. A Reporter (priority 0)
+*				 sleeps for the run and prints the interrupts taken per
+*				 second, SysTick and the RunPeriodicEvents timer, the
+*				 share of the run spent asleep in WaitForInterrupt and
+*				 the mean period of every worker. Lab4Tickless uses
+*				 the default TICKLESS of Lab4/os.c, Lab4Ticking is built
+*				 with TICKLESS 0 and takes every tick.
+*
+*	Usage:       Lab4Tickless [seconds], default DEFAULT_SECONDS.
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "BSP.h"
+#include "CortexM.h"
+#include "../Lab4/os.h"
+
+#define THREADFREQ       1000   // frequency in Hz of round robin scheduler
+#define DEFAULT_SECONDS  3
+#define STACK_WORDS      128
+#define WORKERS          3
+#define WORK_US          200
+#ifndef TICKLESS
+#define TICKLESS         1      // as in Lab4/os.c
+#endif
+
+const uint32_t Periods[WORKERS] = { 10, 25, 100 };
+uint32_t Seconds = DEFAULT_SECONDS;
+volatile uint32_t Loops[WORKERS];
+uint64_t FirstTick[WORKERS], LastTick[WORKERS];
+
+static uint64_t NowNs(void){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+// busy work for us microseconds of target time
+static void Spin(uint32_t us){
+	uint64_t end = NowNs() + (uint64_t)(us * 1000.0 / Host_Speedup());
+	while ( NowNs() < end ) {
+	}
+}
+
+static void Worker(uint32_t i){
+	uint64_t lastWake = OS_Ticks();
+	FirstTick[i] = lastWake;
+	for(;;){
+		Spin(WORK_US);
+		Loops[i]++;
+		LastTick[i] = OS_Ticks();
+		OS_SleepUntil(&lastWake, Periods[i]);
+	}
+}
+void Worker0(void){ Worker(0); }
+void Worker1(void){ Worker(1); }
+void Worker2(void){ Worker(2); }
+
+void Idle(void){
+	for(;;){
+		OS_Idle();
+	}
+}
+
+// a tick before OS_Launch, interrupts are enabled while the threads are
+// added, must count as one and nothing else. Before OS_Init set
+// TickCycles it divided by zero.
+static int EarlyTick(void){
+	uint32_t fired = Host_InterruptCount[HOST_TIMER_A];
+	uint64_t ticks = OS_Ticks();
+	EnableInterrupts();
+	while ( Host_InterruptCount[HOST_TIMER_A] == fired ) {
+		WaitForInterrupt();
+	}
+	DisableInterrupts();
+	printf("tick before OS_Launch %s\n", (OS_Ticks() > ticks) ? "ok" : "NOT COUNTED");
+	return OS_Ticks() > ticks;
+}
+
+void Reporter(void){
+	uint32_t sysTick, timer, i;
+	uint64_t start = NowNs();
+	uint64_t sleepStart = Host_SleepNs;
+	uint32_t sysTickStart = Host_InterruptCount[HOST_SYSTICK];
+	uint32_t timerStart = Host_InterruptCount[HOST_TIMER_A];
+	double seconds;
+	OS_Sleep(Seconds*1000);
+	seconds = (NowNs() - start) / 1e9;
+	sysTick = Host_InterruptCount[HOST_SYSTICK] - sysTickStart;
+	timer = Host_InterruptCount[HOST_TIMER_A] - timerStart;
+	printf("%-8s  %7.1f  %7.1f  %7.1f  %7.1f %%", TICKLESS ? "tickless" : "ticking",
+	       sysTick / seconds, timer / seconds, (sysTick + timer) / seconds,
+	       100.0 * (Host_SleepNs - sleepStart) / (seconds * 1e9));
+	for ( i = 0; i < WORKERS; i++ ) {
+		printf("  %6.2f", (Loops[i] > 1) ? (double)(LastTick[i] - FirstTick[i]) / (Loops[i] - 1) : 0.0);
+	}
+	printf("\n");
+	fflush(stdout);
+	exit(0);
+}
+
+int main(int argc, char *argv[]){
+	if ( argc > 1 ) {
+		Seconds = (uint32_t)strtoul(argv[1], NULL, 0);
+	}
+	if ( Seconds == 0 ) {
+		Seconds = DEFAULT_SECONDS;
+	}
+	OS_Init();
+	if ( !EarlyTick() )
+		return 1;
+	OS_CreateThread(&Reporter, 0, STACK_WORDS);
+	OS_CreateThread(&Worker0, 1, STACK_WORDS);
+	OS_CreateThread(&Worker1, 1, STACK_WORDS);
+	OS_CreateThread(&Worker2, 1, STACK_WORDS);
+	OS_CreateThread(&Idle, 31, STACK_WORDS);
+	OS_Launch(BSP_Clock_GetFreq()/THREADFREQ);
+	return 0;             // this never executes
+}
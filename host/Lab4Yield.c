@@ -0,0 +1,91 @@
+/********************************************************************
+*	Filename:    Lab4Yield.c
+*
+*	Description: Cost of a Lab4 OS_Suspend, built and run by
+*				 "make -C host lab4-yield". Two Yielders (priority 1)
+*				 hand the CPU to each other with OS_Suspend, each one
+*				 stamps the cycle count before it yields and the other
+*				 one takes the time to its own return from OS_Suspend.
+*				 A Reporter (priority 0) sleeps for the run and prints
+*				 the yields per second, the mean and longest yield
+*				 latency and how often SysTick_Handler and
+*				 PendSV_Handler ran. Lab4Yield uses the default
+*				 PENDSV_SWITCH of Lab4/os.c, Lab4YieldSysTick is built
+*				 with PENDSV_SWITCH 0 and yields through SysTick.
+*
+*	Usage:       Lab4Yield [seconds], default DEFAULT_SECONDS.
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "BSP.h"
+#include "CortexM.h"
+#include "../Lab4/os.h"
+
+#define THREADFREQ       1000   // frequency in Hz of round robin scheduler
+#define DEFAULT_SECONDS  2
+#define STACK_WORDS      128
+#ifndef PENDSV_SWITCH
+#define PENDSV_SWITCH    1      // as in Lab4/os.c
+#endif
+
+uint32_t Seconds = DEFAULT_SECONDS;
+volatile uint32_t Stamp;        // cycle count of the last OS_Suspend call
+volatile uint32_t Yields, MaxLatency;
+volatile uint64_t SumLatency;
+
+// a stamp the other Yielder overwrote after this one read the cycle
+// count, when the time slice ran out in between, is not counted
+void Yielder(void){
+	uint32_t latency;
+	long sr;
+	for(;;){
+		Stamp = Host_CycleCount();
+		OS_Suspend();
+		sr = StartCritical();
+		latency = Host_CycleCount() - Stamp;
+		EndCritical(sr);
+		if ( (int32_t)latency < 0 )
+			continue;
+		Yields++;
+		SumLatency += latency;
+		if ( latency > MaxLatency )
+			MaxLatency = latency;
+	}
+}
+
+void Reporter(void){
+	double us = 1e6 / BSP_Clock_GetFreq();
+	uint32_t sysTickStart, pendSVStart;
+	OS_Sleep(100);                  // both Yielders running
+	Yields = 0;
+	SumLatency = 0;
+	MaxLatency = 0;
+	sysTickStart = Host_SysTickCount;
+	pendSVStart = Host_PendSVCount;
+	OS_Sleep(Seconds*1000);
+	printf("%-7s  %9.0f  %7.2f  %7.1f  %9.0f  %8.0f\n", PENDSV_SWITCH ? "PendSV" : "SysTick",
+	       (double)Yields/Seconds, Yields ? SumLatency*us/Yields : 0.0, MaxLatency*us,
+	       (double)(Host_SysTickCount - sysTickStart)/Seconds,
+	       (double)(Host_PendSVCount - pendSVStart)/Seconds);
+	fflush(stdout);
+	exit(0);
+}
+
+int main(int argc, char *argv[]){
+	if ( argc > 1 ) {
+		Seconds = (uint32_t)strtoul(argv[1], NULL, 0);
+	}
+	if ( Seconds == 0 ) {
+		Seconds = DEFAULT_SECONDS;
+	}
+	OS_Init();
+	OS_CreateThread(&Reporter, 0, STACK_WORDS);
+	OS_CreateThread(&Yielder, 1, STACK_WORDS);
+	OS_CreateThread(&Yielder, 1, STACK_WORDS);
+	OS_Launch(BSP_Clock_GetFreq()/THREADFREQ);
+	return 0;             // this never executes
+}
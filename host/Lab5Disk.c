@@ -0,0 +1,103 @@
+/********************************************************************
+*	Filename:    Lab5Disk.c
+*
+*	Description: Benchmark of the Lab5 eDisk on the host flash image,
+*				 built and run by "make -C host lab5-disk". Each cycle
+*				 formats the disk, writes all 256 sectors and reads them
+*				 back. The target time comes from the cost model of
+*				 host/FlashProgram.c, so the numbers are the same on
+*				 every run and every workstation. A last pass rewrites a
+*				 sector without an erase to show the NOR rule at work.
+*
+*	Usage:       Lab5Disk [cycles], default is DEFAULT_CYCLES.
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../Lab5/eDisk.h"
+#include "../Lab5/FlashProgram.h"
+
+#define DEFAULT_CYCLES   10
+#define SECTORS          256
+#define SECTOR_SIZE      512
+
+uint8_t Buff[SECTOR_SIZE] __attribute__((aligned(4)));
+
+static double HostTime(void){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec/1e9;
+}
+
+static void Fill(uint8_t sector, uint32_t cycle){
+	uint32_t i;
+	for ( i = 0; i < SECTOR_SIZE; i++ ) {
+		Buff[i] = (uint8_t)(sector*7 + i + cycle);
+	}
+}
+
+// number of bytes of the sector that differ from Fill(sector, cycle)
+static uint32_t Check(uint8_t sector, uint32_t cycle){
+	uint32_t i, bad = 0;
+	eDisk_ReadSector(Buff, sector);
+	for ( i = 0; i < SECTOR_SIZE; i++ ) {
+		if ( Buff[i] != (uint8_t)(sector*7 + i + cycle) ) {
+			bad++;
+		}
+	}
+	return bad;
+}
+
+int main(int argc, char *argv[]){
+	uint32_t cycles = DEFAULT_CYCLES, cycle, sector, bad = 0;
+	double formatTime = 0, writeTime = 0, start, host = 0;
+	if ( argc > 1 ) {
+		cycles = (uint32_t)strtoul(argv[1], NULL, 0);
+	}
+	if ( cycles == 0 ) {
+		cycles = DEFAULT_CYCLES;
+	}
+	if ( eDisk_Init(0) != RES_OK ) {
+		fprintf(stderr, "Lab5Disk: eDisk_Init failed\n");
+		return 1;
+	}
+	for ( cycle = 0; cycle < cycles; cycle++ ) {
+		start = Flash_Time();
+		host -= HostTime();
+		if ( eDisk_Format() != RES_OK ) {
+			fprintf(stderr, "Lab5Disk: eDisk_Format failed\n");
+			return 1;
+		}
+		formatTime += Flash_Time() - start;
+		start = Flash_Time();
+		for ( sector = 0; sector < SECTORS; sector++ ) {
+			Fill(sector, cycle);
+			if ( eDisk_WriteSector(Buff, sector) != RES_OK ) {
+				fprintf(stderr, "Lab5Disk: eDisk_WriteSector %u failed\n", (unsigned)sector);
+				return 1;
+			}
+		}
+		writeTime += Flash_Time() - start;
+		for ( sector = 0; sector < SECTORS; sector++ ) {
+			bad += Check(sector, cycle);
+		}
+		host += HostTime();
+	}
+	printf("Lab5 eDisk on the host flash image, %u cycles of format, write and read\n", (unsigned)cycles);
+	printf("format %8.1f ms target per disk\n", formatTime/1000/cycles);
+	printf("write  %8.2f ms target per sector, %.1f KB/s\n", writeTime/1000/cycles/SECTORS,
+	       SECTORS*SECTOR_SIZE/1024.0*cycles/(writeTime/1e6));
+	printf("host   %8.1f MB/s written and read back, %u bad bytes\n",
+	       2.0*SECTORS*SECTOR_SIZE*cycles/host/1e6, (unsigned)bad);
+
+	// rewrite the first sector with the next pattern and no erase
+	Fill(0, cycles);
+	eDisk_WriteSector(Buff, 0);
+	printf("rewrite without erase: %u of %u bytes differ\n", (unsigned)Check(0, cycles), SECTOR_SIZE);
+	Flash_Report();
+	return 0;
+}
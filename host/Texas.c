@@ -0,0 +1,29 @@
+/********************************************************************
+*	Filename:    Texas.c
+*
+*	Description: Host implementation of the TExaS stand-in, see
+*				 inc/Texas.h.
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#include <stdint.h>
+#include "Texas.h"
+
+volatile uint32_t TExaS_Count[TEXAS_TASKS];
+
+void TExaS_Init(enum TExaSmode mode, uint32_t edXcode){
+	(void)mode;
+	(void)edXcode;
+}
+
+void TExaS_Stop(void){
+}
+
+void TExaS_Task0(void){ TExaS_Count[0]++; }
+void TExaS_Task1(void){ TExaS_Count[1]++; }
+void TExaS_Task2(void){ TExaS_Count[2]++; }
+void TExaS_Task3(void){ TExaS_Count[3]++; }
+void TExaS_Task4(void){ TExaS_Count[4]++; }
+void TExaS_Task5(void){ TExaS_Count[5]++; }
+void TExaS_Task6(void){ TExaS_Count[6]++; }
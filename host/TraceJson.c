@@ -0,0 +1,150 @@
+/********************************************************************
+*	Filename:    TraceJson.c
+*
+*	Description: Converts a Lab4 kernel trace to the Chrome trace event
+*				 JSON that chrome://tracing and ui.perfetto.dev open.
+*				 The input is a dump of the Trace ring of Lab4/os.c
+*				 built with TRACE_ENTRIES: a traceHeader_t and its
+*				 records, as written by the host builds at exit or
+*				 saved from the debugger. Every thread becomes a track:
+*				 - its runs, from TRACE_SWITCH_IN to TRACE_SWITCH_OUT,
+*				   as slices named by the priority.
+*				 - waits, signals, FIFO puts and gets, sleeps and
+*				   releases as instant events.
+*				 Cycle counts are unwrapped in record order and given
+*				 in us from the oldest record kept. A writer claims its
+*				 record before it reads the cycle counter, so a record
+*				 can be stamped a little before the one ahead of it in
+*				 the ring: its time is clamped to that one's, it never
+*				 wraps the clock forward by 2^32 cycles.
+*
+*	Usage:       TraceJson trace.bin [trace.json], stdout by default.
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../Lab4/os.h"
+
+#define THREADS   256        // one track per Thread byte
+
+static FILE *Out;
+static int First = 1;
+
+static void Event(const char *fmt, double ts, uint32_t thread, const char *args){
+	fprintf(Out, "%s\n  {\"name\":\"", First ? "" : ",");
+	fprintf(Out, fmt, args);
+	fprintf(Out, "\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}", ts, (unsigned)thread);
+	First = 0;
+}
+
+int main(int argc, char *argv[]){
+	traceHeader_t header;
+	traceRecord_t *records, *rec;
+	FILE *in;
+	uint32_t kept, start, i, last = 0;
+	int32_t delta;
+	uint64_t now = 0;
+	double us, ts;
+	double runStart[THREADS];
+	int running[THREADS] = { 0 };
+	int seen[THREADS] = { 0 };
+	char arg[32];
+
+	if ( argc < 2 ) {
+		fprintf(stderr, "usage: TraceJson trace.bin [trace.json]\n");
+		return 1;
+	}
+	in = fopen(argv[1], "rb");
+	if ( in == NULL ) {
+		perror(argv[1]);
+		return 1;
+	}
+	if ( (fread(&header, sizeof(header), 1, in) != 1) || (header.Magic != TRACE_MAGIC)
+	     || (header.Entries == 0) || (header.Entries & (header.Entries - 1)) || (header.Clock == 0) ) {
+		fprintf(stderr, "TraceJson: %s is not a Lab4 trace\n", argv[1]);
+		return 1;
+	}
+	records = malloc(header.Entries * sizeof(traceRecord_t));
+	if ( (records == NULL) || (fread(records, sizeof(traceRecord_t), header.Entries, in) != header.Entries) ) {
+		fprintf(stderr, "TraceJson: %s is cut short\n", argv[1]);
+		return 1;
+	}
+	fclose(in);
+	Out = stdout;
+	if ( (argc > 2) && ((Out = fopen(argv[2], "w")) == NULL) ) {
+		perror(argv[2]);
+		return 1;
+	}
+
+	us = 1e6 / header.Clock;
+	kept = (header.Index < header.Entries) ? header.Index : header.Entries;
+	start = header.Index - kept;
+	fprintf(Out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+	for ( i = 0; i < kept; i++ ) {
+		rec = &records[(start + i) & (header.Entries - 1)];
+		delta = (int32_t)(rec->Time - last);
+		if ( i == 0 ) {
+			last = rec->Time;
+		} else if ( delta > 0 ) {          // stamped before the one ahead of it, keeps its time
+			now += delta;
+			last = rec->Time;
+		}
+		ts = now * us;
+		seen[rec->Thread] = 1;
+		switch ( rec->Event ) {
+		case TRACE_SWITCH_IN:
+			runStart[rec->Thread] = ts;
+			running[rec->Thread] = 1;
+			break;
+		case TRACE_SWITCH_OUT:
+			if ( running[rec->Thread] ) {       // runs cut by the ring start are left out
+				fprintf(Out, "%s\n  {\"name\":\"priority %u\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+				        First ? "" : ",", (unsigned)rec->Arg, runStart[rec->Thread],
+				        ts - runStart[rec->Thread], (unsigned)rec->Thread);
+				First = 0;
+				running[rec->Thread] = 0;
+			}
+			break;
+		case TRACE_WAIT:
+		case TRACE_SIGNAL:
+			snprintf(arg, sizeof(arg), "%04x", (unsigned)rec->Arg);
+			Event((rec->Event == TRACE_WAIT) ? "wait %s" : "signal %s", ts, rec->Thread, arg);
+			break;
+		case TRACE_FIFO_PUT:
+		case TRACE_FIFO_GET:
+			snprintf(arg, sizeof(arg), "%u", (unsigned)rec->Arg);
+			Event((rec->Event == TRACE_FIFO_PUT) ? "FIFO put %s" : "FIFO get %s", ts, rec->Thread, arg);
+			break;
+		case TRACE_SLEEP:
+			snprintf(arg, sizeof(arg), "%u", (unsigned)rec->Arg);
+			Event("sleep %s ms", ts, rec->Thread, arg);
+			break;
+		case TRACE_RELEASE:
+			Event("release%s", ts, rec->Thread, "");
+			break;
+		default:
+			break;
+		}
+	}
+	for ( i = 0; i < THREADS; i++ ) {
+		if ( seen[i] ) {
+			if ( i == TRACE_NOTHREAD )
+				snprintf(arg, sizeof(arg), "no thread");
+			else
+				snprintf(arg, sizeof(arg), "tcb %u", (unsigned)i);
+			fprintf(Out, "%s\n  {\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+			        First ? "" : ",", (unsigned)i, arg);
+			First = 0;
+		}
+	}
+	fprintf(Out, "\n]}\n");
+	if ( Out != stdout ) {
+		fclose(Out);
+	}
+	fprintf(stderr, "TraceJson: %u of %u records, %.3f ms\n", (unsigned)kept,
+	        (unsigned)header.Index, now * us / 1000);
+	return 0;
+}
@@ -0,0 +1,247 @@
+/********************************************************************
+*	Filename:    BSP.h
+*
+*	Description: Host stand-in for the BoosterPack BSP.h, used when the
+*				 Lab kernels are built for Linux with -DHOST_PORT. The
+*				 prototypes match the course BSP so the Lab sources build
+*				 unchanged, the implementation is host/BSP.c.
+*
+*				 Sensors replay a recorded trace, LCD routines only count
+*				 calls and pixels. Environment variables:
+*				 BSP_TRACE     trace file, see host/BSP.c for the format,
+*				               synthetic signals are used without one
+*				 HOST_SPEEDUP  target time per host time, 100 runs the
+*				               timers and the trace 100 times faster
+*				 HOST_SECONDS  host seconds to run before the report
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#ifndef __BSP_H
+#define __BSP_H  1
+
+#include <stdint.h>
+
+// color constants, 16-bit color as sent to the ST7735
+#define LCD_BLACK      0x0000
+#define LCD_BLUE       0x001F
+#define LCD_DARKBLUE   0x34BF
+#define LCD_RED        0xF800
+#define LCD_GREEN      0x07E0
+#define LCD_LIGHTGREEN 0x07EF
+#define LCD_ORANGE     0xFD60
+#define LCD_CYAN       0x07FF
+#define LCD_MAGENTA    0xF81F
+#define LCD_YELLOW     0xFFE0
+#define LCD_WHITE      0xFFFF
+#define LCD_GREY       0x8410
+#define LCD_GRAY       LCD_GREY
+
+// ------------BSP_Button1_Init------------
+// Initialize button 1, replayed from the trace stream "button1"
+// Input: none
+// Output: none
+void BSP_Button1_Init(void);
+
+// ------------BSP_Button1_Input------------
+// Read button 1
+// Input: none
+// Output: 0 if button 1 is pressed
+//         non-zero if button 1 is not pressed
+uint8_t BSP_Button1_Input(void);
+
+// ------------BSP_Button2_Init------------
+// Initialize button 2, replayed from the trace stream "button2"
+// Input: none
+// Output: none
+void BSP_Button2_Init(void);
+
+// ------------BSP_Button2_Input------------
+// Read button 2
+// Input: none
+// Output: 0 if button 2 is pressed
+//         non-zero if button 2 is not pressed
+uint8_t BSP_Button2_Input(void);
+
+// ------------BSP_RGB_Init------------
+// Initialize the RGB LED, the duty cycles are only recorded
+// Input: red, green, blue duty cycles 0 to 1,023
+// Output: none
+void BSP_RGB_Init(uint16_t red, uint16_t green, uint16_t blue);
+
+// ------------BSP_RGB_Set------------
+// Set the duty cycles of the RGB LED
+// Input: red, green, blue duty cycles 0 to 1,023
+// Output: none
+void BSP_RGB_Set(uint16_t red, uint16_t green, uint16_t blue);
+
+// ------------BSP_Buzzer_Init------------
+// Initialize the buzzer, the duty cycle is only recorded
+// Input: duty cycle 0 to 1,023
+// Output: none
+void BSP_Buzzer_Init(uint16_t duty);
+
+// ------------BSP_Buzzer_Set------------
+// Set the duty cycle of the buzzer
+// Input: duty cycle 0 to 1,023
+// Output: none
+void BSP_Buzzer_Set(uint16_t duty);
+
+// ------------BSP_Accelerometer_Init------------
+// Initialize the accelerometer, replayed from the trace stream "accel"
+// Input: none
+// Output: none
+void BSP_Accelerometer_Init(void);
+
+// ------------BSP_Accelerometer_Input------------
+// Read the accelerometer
+// Input: x, y, z are pointers to store the 10-bit results
+// Output: none
+void BSP_Accelerometer_Input(uint16_t *x, uint16_t *y, uint16_t *z);
+
+// ------------BSP_Microphone_Init------------
+// Initialize the microphone, replayed from the trace stream "mic"
+// Input: none
+// Output: none
+void BSP_Microphone_Init(void);
+
+// ------------BSP_Microphone_Input------------
+// Read the microphone
+// Input: mic is pointer to store the 10-bit result
+// Output: none
+void BSP_Microphone_Input(uint16_t *mic);
+
+// ------------BSP_LightSensor_Init------------
+// Initialize the light sensor, replayed from the trace stream "light"
+// Input: none
+// Output: none
+void BSP_LightSensor_Init(void);
+
+// ------------BSP_LightSensor_Input------------
+// Start a conversion and wait for it, 800 ms of target time
+// Input: none
+// Output: light intensity in units of lux*100
+uint32_t BSP_LightSensor_Input(void);
+
+// ------------BSP_LightSensor_Start------------
+// Start a light conversion
+// Input: none
+// Output: none
+void BSP_LightSensor_Start(void);
+
+// ------------BSP_LightSensor_End------------
+// Finish a light conversion started by BSP_LightSensor_Start
+// Input: light is pointer to store the lux*100 result
+// Output: 1 if the conversion is done and *light is valid
+//         0 if the conversion is not done yet
+int BSP_LightSensor_End(uint32_t *light);
+
+// ------------BSP_TempSensor_Init------------
+// Initialize the temperature sensor, replayed from the trace stream "temp"
+// Input: none
+// Output: none
+void BSP_TempSensor_Init(void);
+
+// ------------BSP_TempSensor_Input------------
+// Start a conversion and wait for it, 1 sec of target time
+// Input: sensorV is pointer to store the sensor voltage in 156.25 nV
+//        localT is pointer to store the local temperature in 0.00001 C
+// Output: none
+void BSP_TempSensor_Input(int32_t *sensorV, int32_t *localT);
+
+// ------------BSP_TempSensor_Start------------
+// Start a temperature conversion
+// Input: none
+// Output: none
+void BSP_TempSensor_Start(void);
+
+// ------------BSP_TempSensor_End------------
+// Finish a temperature conversion started by BSP_TempSensor_Start
+// Input: sensorV, localT as in BSP_TempSensor_Input
+// Output: 1 if the conversion is done and the results are valid
+//         0 if the conversion is not done yet
+int BSP_TempSensor_End(int32_t *sensorV, int32_t *localT);
+
+// ------------BSP_LCD_Init------------
+// Initialize the 128x128 LCD, the draw routines below only
+// count calls and the pixels each call would send over SPI
+// Input: none
+// Output: none
+void BSP_LCD_Init(void);
+
+uint16_t BSP_LCD_Color565(uint8_t r, uint8_t g, uint8_t b);
+uint16_t BSP_LCD_SwapColor(uint16_t x);
+void BSP_LCD_DrawPixel(int16_t x, int16_t y, uint16_t color);
+void BSP_LCD_DrawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
+void BSP_LCD_DrawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+void BSP_LCD_FillScreen(uint16_t color);
+void BSP_LCD_FillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+void BSP_LCD_DrawBitmap(int16_t x, int16_t y, const uint16_t *image, int16_t w, int16_t h);
+void BSP_LCD_DrawCharS(int16_t x, int16_t y, char c, int16_t textColor, int16_t bgColor, uint8_t size);
+void BSP_LCD_DrawChar(int16_t x, int16_t y, char c, int16_t textColor, int16_t bgColor, uint8_t size);
+uint32_t BSP_LCD_DrawString(uint16_t x, uint16_t y, char *pt, int16_t textColor);
+void BSP_LCD_SetCursor(uint32_t newX, uint32_t newY);
+void BSP_LCD_OutUDec(uint32_t n, int16_t textColor);
+void BSP_LCD_OutUDec4(uint32_t n, int16_t textColor);
+void BSP_LCD_OutUDec5(uint32_t n, int16_t textColor);
+void BSP_LCD_OutUFix2_1(uint32_t n, int16_t textColor);
+void BSP_LCD_OutUHex2(uint32_t n, int16_t textColor);
+void BSP_LCD_Drawaxes(uint16_t axisColor, uint16_t bgColor, char *xLabel,
+  char *yLabel1, uint16_t label1Color, char *yLabel2, uint16_t label2Color,
+  int32_t ymax, int32_t ymin);
+void BSP_LCD_PlotPoint(int32_t data1, uint16_t color1);
+void BSP_LCD_PlotIncrement(void);
+
+// ------------BSP_Clock_InitFastest------------
+// Nominal bus clock of the TM4C123 at full speed, 80 MHz.
+// SysTick reload values are converted to host time with it.
+// Input: none
+// Output: none
+void BSP_Clock_InitFastest(void);
+
+// ------------BSP_Clock_GetFreq------------
+// Return the nominal bus clock frequency
+// Input: none
+// Output: 80,000,000 Hz
+uint32_t BSP_Clock_GetFreq(void);
+
+// ------------BSP_PeriodicTask_Init------------
+// Run a user task periodically from the host timer source
+// HOST_TIMER_A (Timer2A on target)
+// Input: task is a pointer to a user function
+//        freq is number of interrupts per second 1 Hz to 10 kHz
+//        priority is a number 0 to 6
+// Output: none
+void BSP_PeriodicTask_Init(void(*task)(void), uint32_t freq, uint8_t priority);
+
+// ------------BSP_PeriodicTask_Stop------------
+// Deactivate the interrupt running a user task periodically.
+// Input: none
+// Output: none
+void BSP_PeriodicTask_Stop(void);
+
+// ------------BSP_PeriodicTask_InitB------------
+// Same as BSP_PeriodicTask_Init on source HOST_TIMER_B
+void BSP_PeriodicTask_InitB(void(*task)(void), uint32_t freq, uint8_t priority);
+void BSP_PeriodicTask_StopB(void);
+
+// ------------BSP_PeriodicTask_InitC------------
+// Same as BSP_PeriodicTask_Init on source HOST_TIMER_C
+void BSP_PeriodicTask_InitC(void(*task)(void), uint32_t freq, uint8_t priority);
+void BSP_PeriodicTask_StopC(void);
+
+// ------------BSP_Delay1ms------------
+// Busy wait, same as on target the thread keeps the processor
+// Input: number of 1 msec to wait
+// Output: none
+void BSP_Delay1ms(uint32_t n);
+
+// ------------BSP_Report------------
+// Print the sensor samples, LCD calls and pixels and the
+// TExaS task counts, per second of target time. Called at exit
+// once a sensor or the LCD has been initialized.
+// Input: none
+// Output: none
+void BSP_Report(void);
+
+#endif
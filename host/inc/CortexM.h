@@ -0,0 +1,173 @@
+/********************************************************************
+*	Filename:    CortexM.h
+*
+*	Description: Host stand-in for the course CortexM.h, used when the Lab
+*				 kernels are built for Linux with -DHOST_PORT (see
+*				 host/Makefile). PRIMASK is a flag, the NVIC is a set of
+*				 pending bits and the core registers the kernels touch are
+*				 plain variables. Interrupt sources are driven by POSIX
+*				 interval timers, see host/CortexM.c.
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#ifndef __CORTEXM_H
+#define __CORTEXM_H  1
+
+#include <stdint.h>
+
+// core registers written by the kernels, no side effects on the host
+// except INTCTRL PENDSTSET and PENDSVSET which pend SysTick and PendSV
+extern volatile uint32_t STCTRL;
+extern volatile uint32_t STRELOAD;
+extern volatile uint32_t STCURRENT;
+extern volatile uint32_t INTCTRL;
+extern volatile uint32_t SYSPRI1;
+extern volatile uint32_t SYSPRI2;
+extern volatile uint32_t SYSPRI3;
+
+// ******** DisableInterrupts ************
+// Set the emulated PRIMASK, interrupt sources only pend
+// Inputs:  none
+// Outputs: none
+void DisableInterrupts(void);
+
+// ******** EnableInterrupts ************
+// Clear the emulated PRIMASK and take pending interrupts
+// Inputs:  none
+// Outputs: none
+void EnableInterrupts(void);
+
+// ******** StartCritical ************
+// Save the emulated PRIMASK and disable interrupts
+// Inputs:  none
+// Outputs: previous PRIMASK, 1 if interrupts were disabled
+long StartCritical(void);
+
+// ******** EndCritical ************
+// Restore the emulated PRIMASK saved by StartCritical
+// Inputs:  previous PRIMASK
+// Outputs: none
+void EndCritical(long sr);
+
+// ******** WaitForInterrupt ************
+// Sleep until an interrupt source fires, returns straight away
+// if one is already pending
+// Inputs:  none
+// Outputs: none
+void WaitForInterrupt(void);
+
+//------------ host port hooks, see host/CortexM.c ------------
+// interrupt sources, the BSP timers use these numbers
+#define HOST_SYSTICK     0     // SysTick_Handler, started by StartOS
+#define HOST_TIMER_A     1     // BSP_PeriodicTask_Init
+#define HOST_TIMER_B     2     // BSP_PeriodicTask_InitB
+#define HOST_TIMER_C     3     // BSP_PeriodicTask_InitC
+#define HOST_BUTTONS     4     // button trace poll, see host/BSP.c
+#define HOST_GPIO_D      5     // GPIOPortD_Handler, falling edge of button 1
+#define HOST_PENDSV      6     // PendSV_Handler, pended through INTCTRL
+#define HOST_STOP        7     // end of a timed run, see host/BSP.c
+#define HOST_SOURCES     8     // room for GPIO and other BSP sources
+
+// ******** Host_InterruptInit ************
+// Attach a handler to an interrupt source
+// Inputs:  source number, 0 to HOST_SOURCES-1
+//          handler, run to completion when the source is taken
+//          priority, 0 highest to 7 lowest, as in the NVIC
+// Outputs: none
+void Host_InterruptInit(int source, void(*handler)(void), uint8_t priority);
+
+// ******** Host_InterruptPeriod ************
+// Fire an interrupt source periodically from a POSIX interval timer
+// The period is in target time, it is divided by Host_Speedup()
+// Inputs:  source number
+//          period in nsec, 0 stops the timer
+// Outputs: none
+void Host_InterruptPeriod(int source, uint64_t period);
+
+// ******** Host_Speedup ************
+// Ratio of target time to host time, from the HOST_SPEEDUP
+// environment variable, 1 runs in real time
+// Inputs:  none
+// Outputs: speedup, greater than 0
+double Host_Speedup(void);
+
+// ******** Host_SysTickControl ************
+// Start or stop the SysTick timer after a write to STCTRL, at the
+// period of STRELOAD while bit 0 is set. On the target the write
+// itself does it, the host timer is only started by StartOS.
+// Inputs:  none
+// Outputs: none
+void Host_SysTickControl(void);
+
+// ******** Host_InterruptTrigger ************
+// Pend an interrupt source, it is taken as soon as PRIMASK allows
+// Inputs:  source number
+// Outputs: none
+void Host_InterruptTrigger(int source);
+
+// ******** Host_CycleCount ************
+// Stand-in for the DWT cycle counter, target bus cycles from the
+// host monotonic clock and Host_Speedup(), wraps at 32 bits
+// Inputs:  none
+// Outputs: cycle count
+uint32_t Host_CycleCount(void);
+
+// ******** Host_TakePending ************
+// Run the pending interrupt handlers in priority order, nothing
+// is run while interrupts are disabled or inside a handler.
+// OS_Suspend calls this after writing INTCTRL since no NVIC
+// takes the SysTick or PendSV on the host.
+// Inputs:  none
+// Outputs: none
+void Host_TakePending(void);
+
+// ******** Host_ExceptionReturn ************
+// Leave handler mode with interrupts enabled, used by a thread
+// starting on a context created inside SysTick_Handler or StartOS
+// Inputs:  none
+// Outputs: none
+void Host_ExceptionReturn(void);
+
+// ******** Host_InitialStack ************
+// Create the host context a thread starts from, see host/osasm.c.
+// The returned pointer takes the place of the TCB stack pointer.
+// Inputs:  thread entry
+// Outputs: value for tcbs[i].sp
+int32_t *Host_InitialStack(void(*thread)(void));
+// ******** Host_FreeStack ************
+// Free a host context made by Host_InitialStack, it must not be
+// running and no switch may save into it any more
+// Inputs:  value from Host_InitialStack
+// Outputs: none
+void Host_FreeStack(int32_t *sp);
+
+// context switch counters kept by the host SysTick_Handler and
+// PendSV_Handler
+extern volatile uint32_t Host_SysTickCount;   // SysTick_Handler runs
+extern volatile uint32_t Host_PendSVCount;    // PendSV_Handler runs
+extern volatile uint32_t Host_SwitchCount;    // runs that changed RunPt
+
+// interrupts taken per source and time asleep in WaitForInterrupt,
+// kept by host/CortexM.c
+extern volatile uint32_t Host_InterruptCount[HOST_SOURCES];
+extern volatile uint64_t Host_SleepNs;
+
+// longest time in target nsec a timer signal of each source came after
+// its expiry, how late the host scheduled the process. A handler held
+// back by PRIMASK is not counted, that is the target's own latency.
+extern volatile uint32_t Host_SignalLateMaxNs[HOST_SOURCES];
+
+// ******** Host_MaskTiming ************
+// Time the sections run with interrupts disabled from thread level,
+// from DisableInterrupts or StartCritical to the matching enable.
+// Handlers are not timed. Off by default, it costs two clock reads
+// per section.
+// Inputs:  1 to clear the counters and start, 0 to stop and keep them
+// Outputs: none
+void Host_MaskTiming(int on);
+extern volatile uint32_t Host_MaskCount;      // timed sections
+extern volatile uint64_t Host_MaskNs;         // total time in them
+extern volatile uint32_t Host_MaskMaxNs;      // longest one
+
+#endif
@@ -0,0 +1,27 @@
+/********************************************************************
+*	Filename:    Profile.h
+*
+*	Description: Host stand-in for the course Profile.h. There are no
+*				 profiling pins on the host, toggles compile to nothing.
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#ifndef __PROFILE_H
+#define __PROFILE_H  1
+
+#define Profile_Toggle0()  ((void)0)
+#define Profile_Toggle1()  ((void)0)
+#define Profile_Toggle2()  ((void)0)
+#define Profile_Toggle3()  ((void)0)
+#define Profile_Toggle4()  ((void)0)
+#define Profile_Toggle5()  ((void)0)
+#define Profile_Toggle6()  ((void)0)
+
+// ------------Profile_Init------------
+// Nothing to initialize on the host
+// Input: none
+// Output: none
+#define Profile_Init()     ((void)0)
+
+#endif
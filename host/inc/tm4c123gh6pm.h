@@ -0,0 +1,37 @@
+/********************************************************************
+*	Filename:    tm4c123gh6pm.h
+*
+*	Description: Host stand-in for the TM4C123GH6PM register map, only
+*				 the registers the Lab kernels touch. Each register is a
+*				 plain variable defined in host/tm4c123gh6pm.c, writes
+*				 have no side effects.
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#ifndef __TM4C123GH6PM_H__
+#define __TM4C123GH6PM_H__
+
+#include <stdint.h>
+
+#define TM4C123_REGISTERS(REG) \
+	REG(SYSCTL_RCGCGPIO_R)     \
+	REG(GPIO_PORTD_DATA_R)     \
+	REG(GPIO_PORTD_DIR_R)      \
+	REG(GPIO_PORTD_IS_R)       \
+	REG(GPIO_PORTD_IBE_R)      \
+	REG(GPIO_PORTD_IEV_R)      \
+	REG(GPIO_PORTD_IM_R)       \
+	REG(GPIO_PORTD_RIS_R)      \
+	REG(GPIO_PORTD_ICR_R)      \
+	REG(GPIO_PORTD_AFSEL_R)    \
+	REG(GPIO_PORTD_PUR_R)      \
+	REG(GPIO_PORTD_DEN_R)      \
+	REG(GPIO_PORTD_AMSEL_R)    \
+	REG(NVIC_EN0_R)            \
+	REG(NVIC_PRI0_R)
+
+#define TM4C123_DECLARE(name) extern volatile uint32_t name;
+TM4C123_REGISTERS(TM4C123_DECLARE)
+
+#endif
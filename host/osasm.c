@@ -0,0 +1,103 @@
+/********************************************************************
+*	Filename:    osasm.c
+*
+*	Description: Host version of the Lab osasm.s, StartOS,
+*				 SysTick_Handler and PendSV_Handler switch threads with
+*				 swapcontext(). The TCB stack pointer of every Lab
+*				 kernel is the first TCB word, on the host it points to
+*				 the ucontext of the thread instead of a saved R4-R11
+*				 frame, so the same file serves Lab2, Lab3 and Lab4.
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <ucontext.h>
+#include "CortexM.h"
+#include "BSP.h"
+
+#define HOST_STACKSIZE   (64*1024)   // bytes of host stack per thread
+
+typedef struct {
+	ucontext_t context;
+	void (*thread)(void);
+} hostContext_t;
+
+extern void *RunPt;          // tcbType *, the first TCB member is sp
+void Scheduler(void);
+
+volatile uint32_t Host_SysTickCount;
+volatile uint32_t Host_PendSVCount;
+volatile uint32_t Host_SwitchCount;
+
+#define RUNCONTEXT()  (*(hostContext_t **)RunPt)
+
+// first code run by every thread, like the exception return
+// from StartOS or SysTick_Handler into the initial stack frame
+static void ThreadStart(void){
+	Host_ExceptionReturn();              // CPSIE I, BX LR
+	RUNCONTEXT()->thread();
+	fprintf(stderr, "osasm: thread returned\n");  // no LR to return to on target
+	abort();
+}
+
+int32_t *Host_InitialStack(void(*thread)(void)){
+	hostContext_t *host = malloc(sizeof(hostContext_t));
+	void *stack = malloc(HOST_STACKSIZE);
+	if ( (host == NULL) || (stack == NULL) ) {
+		fprintf(stderr, "osasm: out of memory\n");
+		exit(1);
+	}
+	getcontext(&host->context);
+	host->context.uc_stack.ss_sp = stack;
+	host->context.uc_stack.ss_size = HOST_STACKSIZE;
+	host->context.uc_link = NULL;
+	sigemptyset(&host->context.uc_sigmask);
+	makecontext(&host->context, ThreadStart, 0);
+	host->thread = thread;
+	return (int32_t *)host;
+}
+
+void Host_FreeStack(int32_t *sp){
+	hostContext_t *host = (hostContext_t *)sp;
+	free(host->context.uc_stack.ss_sp);
+	free(host);
+}
+
+// the switch of SysTick_Handler and PendSV_Handler, with interrupts
+// disabled
+static void Switch(void){
+	hostContext_t *old, *new;
+	old = RUNCONTEXT();
+	Scheduler();
+	new = RUNCONTEXT();
+	if ( new != old ) {
+		Host_SwitchCount++;
+		swapcontext(&old->context, &new->context);
+	}
+}
+
+void SysTick_Handler(void){
+	DisableInterrupts();                 // CPSID I
+	Host_SysTickCount++;
+	Switch();
+	EnableInterrupts();                  // CPSIE I, taken after return
+}
+
+void PendSV_Handler(void){
+	DisableInterrupts();                 // CPSID I
+	Host_PendSVCount++;
+	Switch();
+	EnableInterrupts();                  // CPSIE I, taken after return
+}
+
+void StartOS(void){
+	DisableInterrupts();                 // CPSID I
+	Host_InterruptInit(HOST_SYSTICK, &SysTick_Handler, SYSPRI3 >> 29);
+	Host_InterruptInit(HOST_PENDSV, &PendSV_Handler, (SYSPRI3 >> 21) & 7);
+	Host_SysTickControl();               // SysTick enabled by OS_Launch
+	setcontext(&RUNCONTEXT()->context);  // start first thread
+}
@@ -0,0 +1,13 @@
+/********************************************************************
+*	Filename:    tm4c123gh6pm.c
+*
+*	Description: Storage for the registers of the host tm4c123gh6pm.h.
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#include <stdint.h>
+#include "tm4c123gh6pm.h"
+
+#define TM4C123_DEFINE(name) volatile uint32_t name;
+TM4C123_REGISTERS(TM4C123_DEFINE)
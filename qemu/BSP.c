@@ -0,0 +1,20 @@
+/********************************************************************
+*	Filename:    BSP.c
+*
+*	Description: The clock functions of the course BSP for the QEMU
+*				 mps2-an386 build, see inc/BSP.h.
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#include <stdint.h>
+#include "BSP.h"
+
+#define CLOCK_FREQ       25000000    // mps2-an386 core and bus clock
+
+void BSP_Clock_InitFastest(void){
+}
+
+uint32_t BSP_Clock_GetFreq(void){
+	return CLOCK_FREQ;
+}
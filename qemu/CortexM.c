@@ -0,0 +1,103 @@
+/********************************************************************
+*	Filename:    CortexM.c
+*
+*	Description: Cortex-M core functions of the course CortexM.h for the
+*				 QEMU mps2-an386 build, and the port hooks: semihosting
+*				 output and exit, the cycle counter.
+*				 Semihosting is a BKPT 0xAB with the operation in R0 and
+*				 its argument in R1, QEMU runs it when started with
+*				 -semihosting-config enable=on. On a board without a
+*				 debugger attached the BKPT faults instead.
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#include <stdint.h>
+#include "CortexM.h"
+
+#define SYS_WRITE0       0x04        // print a null terminated string
+#define SYS_EXIT         0x18        // stop, R1 is the reason
+#define ADP_EXIT         0x20026     // ADP_Stopped_ApplicationExit, status 0
+#define ADP_ERROR        0x20023     // ADP_Stopped_RunTimeErrorUnknown, status 1
+
+#define DWT_CYCCNT       (*((volatile uint32_t *)0xE0001004))
+#define TIMER0_CTRL      (*((volatile uint32_t *)0x40000000))
+#define TIMER0_VALUE     (*((volatile uint32_t *)0x40000004))
+#define TIMER0_RELOAD    (*((volatile uint32_t *)0x40000008))
+#define DWT_PROBE        1000        // loops the DWT must count over
+
+static int UseTimer0;
+
+void DisableInterrupts(void){
+	__asm__ volatile ("cpsid i" : : : "memory");
+}
+
+void EnableInterrupts(void){
+	__asm__ volatile ("cpsie i" : : : "memory");
+}
+
+long StartCritical(void){
+	long sr;
+	__asm__ volatile ("mrs %0, primask\n\tcpsid i" : "=r" (sr) : : "memory");
+	return sr;
+}
+
+void EndCritical(long sr){
+	__asm__ volatile ("msr primask, %0" : : "r" (sr) : "memory");
+}
+
+void WaitForInterrupt(void){
+	__asm__ volatile ("wfi");
+}
+
+static int Semihost(int op, const void *arg){
+	register int r0 __asm__("r0") = op;
+	register const void *r1 __asm__("r1") = arg;
+	__asm__ volatile ("bkpt 0xAB" : "+r" (r0) : "r" (r1) : "memory");
+	return r0;
+}
+
+void Qemu_Write(const char *s){
+	Semihost(SYS_WRITE0, s);
+}
+
+void Qemu_WriteNumber(uint32_t n, uint32_t width){
+	char digits[12];
+	uint32_t i = sizeof(digits) - 1;
+	digits[i] = 0;
+	do {
+		digits[--i] = (char)('0' + n % 10);
+		n /= 10;
+	} while ( n != 0 );
+	while ( (i > 0) && (sizeof(digits) - 1 - i < width) ) {
+		digits[--i] = ' ';
+	}
+	Qemu_Write(&digits[i]);
+}
+
+void Qemu_Exit(int status){
+	for(;;){
+		Semihost(SYS_EXIT, (const void *)((status == 0) ? ADP_EXIT : ADP_ERROR));
+	}
+}
+
+const char *Qemu_CycleInit(void){
+	uint32_t start = DWT_CYCCNT;
+	volatile uint32_t i;
+	for ( i = 0; i < DWT_PROBE; i++ ) {
+	}
+	UseTimer0 = (DWT_CYCCNT == start);
+	if ( UseTimer0 ) {
+		TIMER0_CTRL = 0;
+		TIMER0_RELOAD = 0xFFFFFFFF;
+		TIMER0_VALUE = 0xFFFFFFFF;
+		TIMER0_CTRL = 0x00000001;    // enable, counts down at the bus clock
+	}
+	return UseTimer0 ? "TIMER0" : "DWT";
+}
+
+uint32_t Qemu_CycleCount(void){
+	if ( UseTimer0 )
+		return ~TIMER0_VALUE;        // counting up
+	return DWT_CYCCNT;
+}
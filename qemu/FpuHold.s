@@ -0,0 +1,51 @@
+@******************************************************************************
+@
+@ FpuHold.s - FPU registers held across preemption, for FpuSwitch.c.
+@
+@ Author: Abdulmaguid Eissa
+@
+@******************************************************************************
+
+	.text
+	.syntax unified
+	.thumb
+
+	.global Fpu_Hold
+	.type Fpu_Hold, %function
+
+@ ************************************************************************
+@ uint32_t Fpu_Hold(const uint32_t *pattern, uint32_t loops)
+@ Load S0-S31 from pattern[0-31] and FPSCR from pattern[32], spin for
+@ loops iterations, in which SysTick may switch to other threads, then
+@ compare every register with its pattern word.
+@ Returns the number of registers that changed, 0 to 33. S16-S31 and
+@ FPSCR of the caller are kept, as the AAPCS wants.
+
+Fpu_Hold:
+	push    {r4, r5, r6, lr}
+	vpush   {s16-s31}
+	vmrs    r4, fpscr          @ FPSCR of the caller
+	vldmia  r0, {s0-s31}
+	ldr     r5, [r0, #128]
+	vmsr    fpscr, r5
+1:	subs    r1, r1, #1         @ no FPU instruction in here
+	bne     1b
+	movs    r2, #0
+	.irp    n, 0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25,26,27,28,29,30,31
+	vmov    r3, s\n
+	ldr     r5, [r0, #4*\n]
+	cmp     r3, r5
+	it      ne
+	addne   r2, r2, #1
+	.endr
+	vmrs    r3, fpscr
+	ldr     r5, [r0, #128]
+	cmp     r3, r5
+	it      ne
+	addne   r2, r2, #1
+	vmsr    fpscr, r4
+	vpop    {s16-s31}
+	mov     r0, r2
+	pop     {r4, r5, r6, pc}
+
+	.end
@@ -0,0 +1,178 @@
+/********************************************************************
+*	Filename:    FpuSwitch.c
+*
+*	Description: FPU context of the Lab2 switch on a Cortex-M4F, built and
+*				 run by "make -C qemu run" on the QEMU mps2-an386 machine.
+*				 The Lab2 kernel is the target build, osasm.s converted
+*				 from Keil to GNU as. Four main threads, two float and two
+*				 integer ones, in this round robin order:
+*				 - Preempted: each float thread calls Fpu_Hold HOLDS
+*				   times, with its own pattern in S0-S31 and FPSCR while
+*				   SysTick switches every ms. The integer threads count
+*				   Others meanwhile, a hold in which Others moved was
+*				   switched out. Every register must come back, the
+*				   extended frame keeps S0-S15 and FPSCR, the switch
+*				   S16-S31.
+*				 - Timed: each thread gives the CPU away SWITCHES times
+*				   with OS_Suspend, the thread that runs next takes the
+*				   cycles from before the OS_Suspend to its own return
+*				   from it. The least of each of the four kinds, integer
+*				   or float thread out and in, is the switch cost, the
+*				   SysTick entry and exit, Scheduler and for a float
+*				   thread the lazy S0-S15 save and S16-S31.
+*				 The float threads used the FPU before the timed switches,
+*				 so EXC_RETURN bit 4 is clear for them there. Thread 2
+*				 prints the registers lost, the holds switched out, the
+*				 cost table and the stack high water, and stops QEMU with
+*				 exit status 0 if no register was lost and each float
+*				 thread was switched out in MIN_PREEMPTED holds.
+*				 FpuSwitchNoSave links the switch without the S16-S31
+*				 save, TARGET_FPU_VFP 0, it must lose registers.
+*				 Cycles come from the DWT, or from TIMER0 under QEMU,
+*				 which models neither the DWT nor instruction timing:
+*				 with -icount every instruction takes the same time, so
+*				 QEMU counts compare the paths, a board gives the cycles.
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#include <stdint.h>
+#include "BSP.h"
+#include "CortexM.h"
+#include "../Lab2/os.h"
+
+#define THREADFREQ       1000   // frequency in Hz of round robin scheduler
+#define HOLDS            100    // Fpu_Hold calls per float thread
+#define HOLD_LOOPS       100000 // spin of each, several time slices
+#define SWITCHES         1000   // timed OS_Suspend per thread
+#define MIN_PREEMPTED    50     // holds switched out, per float thread
+#define PATTERN_WORDS    33     // S0-S31, FPSCR
+#define INTEGER          0
+#define FLOAT            1
+#define PREEMPTED        0
+#define TIMED            1
+
+uint32_t Fpu_Hold(const uint32_t *pattern, uint32_t loops);   // FpuHold.s
+
+// FPSCR patterns, flags, rounding, flush to zero or default NaN and
+// cumulative exception bits
+const uint32_t Fpscr[2] = { 0x81C00011, 0x42400082 };
+const char *Kinds[2] = { "integer", "float  " };
+uint32_t Patterns[2][PATTERN_WORDS];
+volatile uint32_t Lost[2], Preempted[2];
+volatile uint32_t Others;       // loops of the integer threads
+volatile uint32_t Phase;
+volatile uint32_t HoldsDone, TimedDone;
+volatile uint32_t Stamp, LastKind;
+uint32_t Cost[2][2], Samples[2][2];   // [out][in]
+
+static void Timed(uint32_t kind){
+	uint32_t n, now, out, cost;
+	long sr;
+	while ( Phase != TIMED ) {
+	}
+	for ( n = 0; n < SWITCHES; n++ ) {
+		LastKind = kind;
+		Stamp = Qemu_CycleCount();
+		OS_Suspend();
+		now = Qemu_CycleCount();
+		out = LastKind;
+		cost = now - Stamp;
+		if ( cost < Cost[out][kind] )
+			Cost[out][kind] = cost;
+		Samples[out][kind]++;
+	}
+	sr = StartCritical();
+	TimedDone++;
+	EndCritical(sr);
+}
+
+static void Float(uint32_t i){
+	uint32_t h, others;
+	long sr;
+	for ( h = 0; h < HOLDS; h++ ) {
+		others = Others;
+		Lost[i] += Fpu_Hold(Patterns[i], HOLD_LOOPS);
+		if ( Others != others )
+			Preempted[i]++;
+	}
+	sr = StartCritical();
+	if ( ++HoldsDone == 2 )
+		Phase = TIMED;
+	EndCritical(sr);
+	Timed(FLOAT);
+	for(;;){
+		OS_Suspend();
+	}
+}
+void Float0(void){ Float(0); }
+void Float1(void){ Float(1); }
+
+static void Report(void){
+	uint32_t i, out, in;
+	int ok = 1;
+	for ( i = 0; i < 2; i++ ) {
+		Qemu_Write("float thread ");
+		Qemu_WriteNumber(i, 0);
+		Qemu_Write(": ");
+		Qemu_WriteNumber(Lost[i], 0);
+		Qemu_Write(" registers lost, ");
+		Qemu_WriteNumber(Preempted[i], 0);
+		Qemu_Write(" of ");
+		Qemu_WriteNumber(HOLDS, 0);
+		Qemu_Write(" holds switched out  ");
+		Qemu_Write((Lost[i] != 0) ? "LOST\n" : (Preempted[i] < MIN_PREEMPTED) ? "NOT SWITCHED\n" : "ok\n");
+		ok = ok && (Lost[i] == 0) && (Preempted[i] >= MIN_PREEMPTED);
+	}
+	Qemu_Write("out          in        cycles  samples\n");
+	for ( out = 0; out < 2; out++ ) {
+		for ( in = 0; in < 2; in++ ) {
+			Qemu_Write(Kinds[out]);
+			Qemu_Write("  ->  ");
+			Qemu_Write(Kinds[in]);
+			Qemu_WriteNumber(Cost[out][in], 9);
+			Qemu_WriteNumber(Samples[out][in], 9);
+			Qemu_Write("\n");
+		}
+	}
+	Qemu_Write("stack high water, words of ");
+	Qemu_WriteNumber(STACKSIZE, 0);
+	Qemu_Write(":");
+	for ( i = 0; i < NUMTHREADS; i++ ) {
+		Qemu_WriteNumber(OS_StackHighWater(i), 4);
+	}
+	Qemu_Write("\n");
+	Qemu_Exit(ok ? 0 : 1);
+}
+
+static void Integer(int reporter){
+	while ( Phase != TIMED ) {
+		Others++;
+	}
+	Timed(INTEGER);
+	for(;;){
+		if ( reporter && (TimedDone == NUMTHREADS) )
+			Report();
+		OS_Suspend();
+	}
+}
+void Integer0(void){ Integer(1); }
+void Integer1(void){ Integer(0); }
+
+int main(void){
+	uint32_t i, n;
+	for ( i = 0; i < 2; i++ ) {
+		for ( n = 0; n < 32; n++ ) {
+			Patterns[i][n] = ((i + 1) << 28) | (n << 20) | (0x5A5A5 ^ (n * 0x1111));
+		}
+		Patterns[i][32] = Fpscr[i];
+		Cost[INTEGER][i] = Cost[FLOAT][i] = 0xFFFFFFFF;
+	}
+	OS_Init();
+	Qemu_Write("Lab2 FPU switch, cycles from ");
+	Qemu_Write(Qemu_CycleInit());
+	Qemu_Write("\n");
+	OS_AddThreads(&Float0, &Float1, &Integer0, &Integer1);
+	OS_Launch(BSP_Clock_GetFreq()/THREADFREQ);
+	return 0;             // this never executes
+}
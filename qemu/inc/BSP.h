@@ -0,0 +1,28 @@
+/********************************************************************
+*	Filename:    BSP.h
+*
+*	Description: Stand-in for the course BSP.h on the QEMU mps2-an386
+*				 machine, only the clock the Lab kernels use. The
+*				 board has none of the BoosterPack parts.
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#ifndef __BSP_H
+#define __BSP_H  1
+
+#include <stdint.h>
+
+// ******** BSP_Clock_InitFastest ************
+// The mps2-an386 core clock is fixed at 25 MHz, nothing to set
+// Inputs:  none
+// Outputs: none
+void BSP_Clock_InitFastest(void);
+
+// ******** BSP_Clock_GetFreq ************
+// Core and bus clock frequency
+// Inputs:  none
+// Outputs: frequency in Hz, 25,000,000
+uint32_t BSP_Clock_GetFreq(void);
+
+#endif
@@ -0,0 +1,94 @@
+/********************************************************************
+*	Filename:    CortexM.h
+*
+*	Description: Stand-in for the course CortexM.h, used when a Lab kernel
+*				 is built for the QEMU mps2-an386 machine, a Cortex-M4F
+*				 (see qemu/Makefile). The kernel runs as on the target,
+*				 the core registers are the real ones. Output and exit
+*				 go through semihosting, see qemu/CortexM.c.
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#ifndef __CORTEXM_H
+#define __CORTEXM_H  1
+
+#include <stdint.h>
+
+// core registers the kernels use
+#define STCTRL      (*((volatile uint32_t *)0xE000E010))
+#define STRELOAD    (*((volatile uint32_t *)0xE000E014))
+#define STCURRENT   (*((volatile uint32_t *)0xE000E018))
+#define INTCTRL     (*((volatile uint32_t *)0xE000ED04))
+#define SYSPRI1     (*((volatile uint32_t *)0xE000ED18))
+#define SYSPRI2     (*((volatile uint32_t *)0xE000ED1C))
+#define SYSPRI3     (*((volatile uint32_t *)0xE000ED20))
+
+// ******** DisableInterrupts ************
+// Set PRIMASK, interrupts only pend
+// Inputs:  none
+// Outputs: none
+void DisableInterrupts(void);
+
+// ******** EnableInterrupts ************
+// Clear PRIMASK, pending interrupts are taken
+// Inputs:  none
+// Outputs: none
+void EnableInterrupts(void);
+
+// ******** StartCritical ************
+// Save PRIMASK and disable interrupts
+// Inputs:  none
+// Outputs: previous PRIMASK, 1 if interrupts were disabled
+long StartCritical(void);
+
+// ******** EndCritical ************
+// Restore the PRIMASK saved by StartCritical
+// Inputs:  previous PRIMASK
+// Outputs: none
+void EndCritical(long sr);
+
+// ******** WaitForInterrupt ************
+// Sleep the core until the next interrupt
+// Inputs:  none
+// Outputs: none
+void WaitForInterrupt(void);
+
+//------------ QEMU port hooks, see qemu/CortexM.c ------------
+// ******** Qemu_Write ************
+// Print a string on the QEMU console through semihosting
+// Inputs:  null terminated string
+// Outputs: none
+void Qemu_Write(const char *s);
+
+// ******** Qemu_WriteNumber ************
+// Print an unsigned number right aligned in width characters
+// Inputs:  number
+//          width, 0 for none
+// Outputs: none
+void Qemu_WriteNumber(uint32_t n, uint32_t width);
+
+// ******** Qemu_Exit ************
+// Stop QEMU through semihosting, with exit status 0 if status is
+// 0 and 1 otherwise
+// Inputs:  status, as for exit()
+// Outputs: none, never returns
+void Qemu_Exit(int status);
+
+// ******** Qemu_CycleInit ************
+// Pick the counter of Qemu_CycleCount, the DWT cycle counter if it
+// runs, OS_Init starts it. QEMU does not model the DWT, it reads as
+// 0 there and the CMSDK TIMER0 of the board counts instead, at the
+// 25 MHz bus clock.
+// Inputs:  none
+// Outputs: name of the counter, "DWT" or "TIMER0"
+const char *Qemu_CycleInit(void);
+
+// ******** Qemu_CycleCount ************
+// Free running count of bus cycles from the counter Qemu_CycleInit
+// picked, wraps at 32 bits
+// Inputs:  none
+// Outputs: cycle count
+uint32_t Qemu_CycleCount(void);
+
+#endif
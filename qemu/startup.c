@@ -0,0 +1,86 @@
+/********************************************************************
+*	Filename:    startup.c
+*
+*	Description: Vector table and reset handler of the QEMU mps2-an386
+*				 build, see mps2.ld. Reset copies .data, clears .bss and
+*				 calls main, which starts a Lab kernel. The FPU is on
+*				 from reset, the compiler may use it anywhere. A fault prints
+*				 the fault status registers and stops QEMU with exit
+*				 status 1, an FPU state the switch lost can show up as
+*				 one as well as a wrong register.
+*
+*	Author:      Abdulmaguid Eissa
+**********************************************************************/
+
+#include <stdint.h>
+#include "CortexM.h"
+
+#define CFSR             (*((volatile uint32_t *)0xE000ED28))
+#define HFSR             (*((volatile uint32_t *)0xE000ED2C))
+#define BFAR             (*((volatile uint32_t *)0xE000ED38))
+#define CPACR            (*((volatile uint32_t *)0xE000ED88))
+
+// from mps2.ld
+extern uint32_t __data_load[], __data_start[], __data_end[];
+extern uint32_t __bss_start[], __bss_end[], __stack_top[];
+
+int main(void);
+void SysTick_Handler(void);     // osasm.s of the kernel
+void Reset_Handler(void);
+void Fault_Handler(void);
+void Default_Handler(void);
+void PendSV_Handler(void) __attribute__((weak, alias("Default_Handler")));
+
+__attribute__((section(".vectors"), used))
+void (* const Vectors[16])(void) = {
+	(void (*)(void))__stack_top,  // initial MSP
+	Reset_Handler,
+	Fault_Handler,              // NMI
+	Fault_Handler,              // HardFault
+	Fault_Handler,              // MemManage
+	Fault_Handler,              // BusFault
+	Fault_Handler,              // UsageFault
+	0, 0, 0, 0,
+	Default_Handler,            // SVCall
+	Default_Handler,            // DebugMonitor
+	0,
+	PendSV_Handler,             // Lab3 and Lab4 switch here too
+	SysTick_Handler
+};
+
+void Reset_Handler(void){
+	uint32_t *src = __data_load, *dst;
+	CPACR |= 0x00F00000;        // FPU on before any C code, OS_Init sets it again
+	for ( dst = __data_start; dst < __data_end; dst++ ) {
+		*dst = *src++;
+	}
+	for ( dst = __bss_start; dst < __bss_end; dst++ ) {
+		*dst = 0;
+	}
+	main();
+	Qemu_Exit(1);
+}
+
+static void WriteHex(const char *name, uint32_t value){
+	char hex[11] = "0x";
+	int i;
+	for ( i = 0; i < 8; i++ ) {
+		hex[2 + i] = "0123456789ABCDEF"[(value >> (28 - 4*i)) & 0xF];
+	}
+	hex[10] = 0;
+	Qemu_Write(name);
+	Qemu_Write(hex);
+}
+
+void Fault_Handler(void){
+	WriteHex("fault, CFSR ", CFSR);
+	WriteHex(" HFSR ", HFSR);
+	WriteHex(" BFAR ", BFAR);
+	Qemu_Write("\n");
+	Qemu_Exit(1);
+}
+
+void Default_Handler(void){
+	Qemu_Write("unexpected exception\n");
+	Qemu_Exit(1);
+}